@@ -1,31 +1,76 @@
 #include "RemoveDuplicates.h"
-#include "log_duration.h"
-#include <iostream>
-#include <set>
-using namespace std::string_literals;
-
-void RemoveDuplicates(SearchServer& search_server) {
-    LOG_DURATION("REmove");
-    std::set<std::set<std::string_view>> word_matrix;
-    std::vector<int> ids;
-    ids.reserve(std::distance(search_server.begin(), search_server.end()));
-    size_t current_size = 0;
-
-    for (const int id : search_server) {
-        std::set<std::string_view> current_words;
-        for (auto [word, freq] : search_server.GetWordFrequencies(id)) {
-            current_words.insert(word);
-        }          
-        word_matrix.insert(current_words);
-        if (word_matrix.size() == current_size) {
-            ids.push_back(id);
-            std::cout << "Found duplicate document id "s << id << std::endl;
-        }
-        else {
-            ++current_size;
-        }     
+#include "hash_utils.h"
+#include <algorithm>
+#include <cstdint>
+#include <execution>
+#include <tuple>
+
+namespace {
+
+struct DocumentFingerprint {
+    uint64_t high = 0;
+    uint64_t low = 0;
+    int document_id = 0;
+
+    bool operator<(const DocumentFingerprint& other) const {
+        return std::tie(high, low, document_id) < std::tie(other.high, other.low, other.document_id);
+    }
+
+    bool SameHash(const DocumentFingerprint& other) const {
+        return high == other.high && low == other.low;
+    }
+};
+
+// Two independently seeded 64-bit hashes of the sorted term-id set give a 128-bit fingerprint
+DocumentFingerprint ComputeFingerprint(const std::pmr::vector<int>& term_ids, int document_id) {
+    DocumentFingerprint fingerprint;
+    fingerprint.high = 0x243f6a8885a308d3ull ^ term_ids.size();
+    fingerprint.low = 0x13198a2e03707344ull;
+    fingerprint.document_id = document_id;
+    for (const int term_id : term_ids) {
+        fingerprint.high = MixHash(fingerprint.high ^ static_cast<uint64_t>(term_id));
+        fingerprint.low = MixHash(fingerprint.low + static_cast<uint64_t>(term_id) * 0x9e3779b97f4a7c15ull);
     }
-    for (auto id_for_del: ids) {
-        search_server.RemoveDocument(id_for_del);
+    return fingerprint;
+}
+
+}
+
+std::vector<int> RemoveDuplicates(SearchServer& search_server) {
+    const std::vector<int> ids(search_server.begin(), search_server.end());
+
+    std::vector<DocumentFingerprint> fingerprints(ids.size());
+    std::transform(std::execution::par,
+        ids.begin(), ids.end(),
+        fingerprints.begin(),
+        [&search_server](int id) { return ComputeFingerprint(search_server.GetDocumentTermIds(id), id); });
+
+    // Equal fingerprints become neighbours, and inside a group the smallest id comes first
+    std::sort(std::execution::par, fingerprints.begin(), fingerprints.end());
+
+    std::vector<int> ids_for_del;
+    for (size_t group_begin = 0; group_begin < fingerprints.size(); ) {
+        size_t group_end = group_begin + 1;
+        while (group_end < fingerprints.size() && fingerprints[group_end].SameHash(fingerprints[group_begin])) {
+            ++group_end;
+        }
+        // Words are compared exactly only when fingerprints collide
+        std::vector<const std::pmr::vector<int>*> kept_term_sets;
+        for (size_t i = group_begin; i < group_end; ++i) {
+            const auto& term_ids = search_server.GetDocumentTermIds(fingerprints[i].document_id);
+            const bool is_duplicate = std::any_of(kept_term_sets.begin(), kept_term_sets.end(),
+                [&term_ids](const std::pmr::vector<int>* kept) { return *kept == term_ids; });
+            if (is_duplicate) {
+                ids_for_del.push_back(fingerprints[i].document_id);
+            }
+            else {
+                kept_term_sets.push_back(&term_ids);
+            }
+        }
+        group_begin = group_end;
     }
-}
\ No newline at end of file
+
+    std::sort(ids_for_del.begin(), ids_for_del.end());
+    search_server.RemoveDocuments(ids_for_del);
+    return ids_for_del;
+}
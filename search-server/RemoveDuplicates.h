@@ -1,3 +1,7 @@
 #pragma once
+#include <vector>
 #include "search_server.h"
-void RemoveDuplicates(SearchServer& search_server);
\ No newline at end of file
+
+// Removes documents whose set of words equals the set of an earlier document (the smallest id is kept).
+// Returns the removed ids in ascending order.
+std::vector<int> RemoveDuplicates(SearchServer& search_server);
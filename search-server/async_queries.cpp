@@ -0,0 +1,85 @@
+#include "async_queries.h"
+
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+using namespace std::string_literals;
+
+AsyncQueryRunner::AsyncQueryRunner(const SearchServer& search_server, size_t max_in_flight)
+    : search_server_(search_server)
+    , max_in_flight_(max_in_flight) {
+    if (max_in_flight == 0) {
+        throw std::invalid_argument("At least one query must be allowed in flight"s);
+    }
+}
+
+AsyncQueryRunner::~AsyncQueryRunner() {
+    std::unique_lock lock(idle_mutex_);
+    idle_.wait(lock, [this]() { return in_flight_.load() == 0; });
+}
+
+std::future<QueryResult> AsyncQueryRunner::FindTopDocuments(std::string raw_query, Clock::time_point deadline, DocumentStatus status) {
+    return FindTopDocuments(std::move(raw_query), std::make_shared<QueryDeadline>(deadline), status);
+}
+
+std::future<QueryResult> AsyncQueryRunner::FindTopDocuments(std::string raw_query, std::shared_ptr<QueryDeadline> deadline, DocumentStatus status) {
+    auto promise = std::make_shared<std::promise<QueryResult>>();
+    std::future<QueryResult> future = promise->get_future();
+    if (in_flight_.fetch_add(1) >= max_in_flight_) {
+        FinishQuery();
+        QueryResult rejected;
+        rejected.outcome = QueryOutcome::REJECTED;
+        promise->set_value(std::move(rejected));
+        return future;
+    }
+
+    search_server_.GetExecutor().Submit([this, promise, raw_query = std::move(raw_query), deadline, status]() {
+        QueryResult result;
+        std::exception_ptr error;
+        try {
+            result = Evaluate(raw_query, *deadline, status);
+        }
+        catch (...) {
+            error = std::current_exception();
+        }
+        // The slot is free before the future is ready, so a caller woken by it may query again at once.
+        // The runner may be gone after FinishQuery, the promise is owned by the task.
+        FinishQuery();
+        if (error) {
+            promise->set_exception(error);
+        }
+        else {
+            promise->set_value(std::move(result));
+        }
+    });
+    return future;
+}
+
+std::future<QueryResult> AsyncQueryRunner::FindTopDocuments(std::string raw_query, Clock::duration timeout, DocumentStatus status) {
+    return FindTopDocuments(std::move(raw_query), Clock::now() + timeout, status);
+}
+
+size_t AsyncQueryRunner::GetInFlightCount() const {
+    return in_flight_.load();
+}
+
+size_t AsyncQueryRunner::GetMaxInFlight() const {
+    return max_in_flight_;
+}
+
+QueryResult AsyncQueryRunner::Evaluate(const std::string& raw_query, const QueryDeadline& deadline, DocumentStatus status) const {
+    if (search_server_.GetParallelismMode() == ParallelismMode::INTER_QUERY) {
+        return search_server_.FindTopDocumentsUntil(deadline, std::execution::seq, raw_query, status);
+    }
+    return search_server_.FindTopDocumentsUntil(deadline, std::execution::par, raw_query, status);
+}
+
+void AsyncQueryRunner::FinishQuery() {
+    // Decremented under the mutex, so the destructor cannot return while the last query still notifies
+    std::lock_guard lock(idle_mutex_);
+    if (in_flight_.fetch_sub(1) == 1) {
+        idle_.notify_all();
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "search_server.h"
+
+// Runs queries of a SearchServer on its executor without blocking the caller. Every query has
+// a deadline, after which it returns what it has scored so far. At most max_in_flight queries are
+// queued or running: a query above the limit is not evaluated, its future is ready at once with
+// QueryOutcome::REJECTED. The server must outlive the runner; the destructor waits for all queries.
+class AsyncQueryRunner {
+public:
+    using Clock = QueryDeadline::Clock;
+
+    AsyncQueryRunner(const SearchServer& search_server, size_t max_in_flight);
+    ~AsyncQueryRunner();
+
+    AsyncQueryRunner(const AsyncQueryRunner&) = delete;
+    AsyncQueryRunner& operator=(const AsyncQueryRunner&) = delete;
+
+    // An invalid query sets the exception of the future
+    std::future<QueryResult> FindTopDocuments(std::string raw_query, Clock::time_point deadline, DocumentStatus status = DocumentStatus::ACTUAL);
+    std::future<QueryResult> FindTopDocuments(std::string raw_query, Clock::duration timeout, DocumentStatus status = DocumentStatus::ACTUAL);
+    // The caller keeps the deadline and may Cancel it, e.g. when its client has gone away;
+    // the query then stops at its next check and returns QueryOutcome::PARTIAL
+    std::future<QueryResult> FindTopDocuments(std::string raw_query, std::shared_ptr<QueryDeadline> deadline, DocumentStatus status = DocumentStatus::ACTUAL);
+
+    size_t GetInFlightCount() const;
+    size_t GetMaxInFlight() const;
+
+private:
+    const SearchServer& search_server_;
+    const size_t max_in_flight_;
+    std::atomic<size_t> in_flight_{ 0 };
+    std::mutex idle_mutex_;
+    std::condition_variable idle_;
+
+    QueryResult Evaluate(const std::string& raw_query, const QueryDeadline& deadline, DocumentStatus status) const;
+    void FinishQuery();
+};
@@ -0,0 +1,303 @@
+#include "search_server.h"
+#include "generators.h"
+#include "process_queries.h"
+#include "RemoveDuplicates.h"
+
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <execution>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Benchmark suite for SearchServer. Every result is printed as one JSON object per line:
+//   benchmark --documents=10000 --vocabulary=1000 --query-words=10 --minus-prob=0.1 --status-mix=8,1,1,0 --threads=4
+//             --allocation=default|pooled|monotonic
+struct BenchmarkOptions {
+    int documents = 10000;
+    int vocabulary = 1000;
+    int max_word_length = 10;
+    int document_words = 70;
+    int queries = 1000;
+    int query_words = 10;
+    double minus_prob = 0.1;
+    // Weights of ACTUAL, IRRELEVANT, BANNED and REMOVED documents
+    array<double, 4> status_mix = { 1.0, 0.0, 0.0, 0.0 };
+    int threads = max(1u, thread::hardware_concurrency());
+    int seed = 42;
+    string filter;
+    // Memory resource of the benchmarked indexes
+    string allocation = "default"s;
+};
+
+struct Corpus {
+    vector<string> dictionary;
+    vector<string> documents;
+    vector<DocumentStatus> statuses;
+    vector<string> queries;
+};
+
+array<double, 4> ParseStatusMix(const string& text) {
+    array<double, 4> mix = {};
+    size_t position = 0;
+    for (double& weight : mix) {
+        const size_t comma = text.find(',', position);
+        weight = stod(text.substr(position, comma - position));
+        if (comma == string::npos) {
+            break;
+        }
+        position = comma + 1;
+    }
+    return mix;
+}
+
+BenchmarkOptions ParseOptions(int argc, char* argv[]) {
+    BenchmarkOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const string argument = argv[i];
+        const size_t equal = argument.find('=');
+        if (argument.rfind("--"s, 0) != 0 || equal == string::npos) {
+            throw invalid_argument("Expected --name=value, got "s + argument);
+        }
+        const string name = argument.substr(2, equal - 2);
+        const string value = argument.substr(equal + 1);
+        if (name == "documents"s) {
+            options.documents = stoi(value);
+        }
+        else if (name == "vocabulary"s) {
+            options.vocabulary = stoi(value);
+        }
+        else if (name == "max-word-length"s) {
+            options.max_word_length = stoi(value);
+        }
+        else if (name == "document-words"s) {
+            options.document_words = stoi(value);
+        }
+        else if (name == "queries"s) {
+            options.queries = stoi(value);
+        }
+        else if (name == "query-words"s) {
+            options.query_words = stoi(value);
+        }
+        else if (name == "minus-prob"s) {
+            options.minus_prob = stod(value);
+        }
+        else if (name == "status-mix"s) {
+            options.status_mix = ParseStatusMix(value);
+        }
+        else if (name == "threads"s) {
+            options.threads = max(1, stoi(value));
+        }
+        else if (name == "seed"s) {
+            options.seed = stoi(value);
+        }
+        else if (name == "filter"s) {
+            options.filter = value;
+        }
+        else if (name == "allocation"s) {
+            if (value != "default"s && value != "pooled"s && value != "monotonic"s) {
+                throw invalid_argument("Unknown allocation "s + value);
+            }
+            options.allocation = value;
+        }
+        else {
+            throw invalid_argument("Unknown option "s + name);
+        }
+    }
+    return options;
+}
+
+Corpus GenerateCorpus(const BenchmarkOptions& options) {
+    mt19937 generator(options.seed);
+    Corpus corpus;
+    corpus.dictionary = GenerateDictionary(generator, options.vocabulary, options.max_word_length);
+    corpus.documents = GenerateQueries(generator, corpus.dictionary, options.documents, options.document_words);
+    discrete_distribution<int> status_distribution(options.status_mix.begin(), options.status_mix.end());
+    for (int i = 0; i < options.documents; ++i) {
+        corpus.statuses.push_back(static_cast<DocumentStatus>(status_distribution(generator)));
+    }
+    corpus.queries = GenerateQueries(generator, corpus.dictionary, options.queries, options.query_words, options.minus_prob);
+    return corpus;
+}
+
+IndexMemoryOptions GetIndexMemoryOptions(const BenchmarkOptions& options) {
+    IndexMemoryOptions memory;
+    if (options.allocation == "pooled"s) {
+        memory.allocation = IndexAllocation::POOLED;
+    }
+    else if (options.allocation == "monotonic"s) {
+        memory.allocation = IndexAllocation::MONOTONIC;
+    }
+    return memory;
+}
+
+void FillServer(SearchServer& search_server, const Corpus& corpus, int id_offset = 0) {
+    for (size_t i = 0; i < corpus.documents.size(); ++i) {
+        search_server.AddDocument(id_offset + static_cast<int>(i), corpus.documents[i], corpus.statuses[i], { 1, 2, 3 });
+    }
+}
+
+class BenchmarkRunner {
+public:
+    explicit BenchmarkRunner(const BenchmarkOptions& options)
+        : options_(options) {
+    }
+
+    // Runs body once and prints its timing; body returns a checksum that keeps the work observable
+    void Run(const string& name, size_t operations, const function<double()>& body) const {
+        if (!options_.filter.empty() && name.find(options_.filter) == string::npos) {
+            return;
+        }
+        const auto start = chrono::steady_clock::now();
+        const double checksum = body();
+        const auto total_ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        cout << "{\"benchmark\":\""s << name << "\""s
+            << ",\"documents\":"s << options_.documents
+            << ",\"vocabulary\":"s << options_.vocabulary
+            << ",\"document_words\":"s << options_.document_words
+            << ",\"queries\":"s << options_.queries
+            << ",\"query_words\":"s << options_.query_words
+            << ",\"minus_prob\":"s << options_.minus_prob
+            << ",\"status_mix\":["s << options_.status_mix[0] << ","s << options_.status_mix[1] << ","s
+            << options_.status_mix[2] << ","s << options_.status_mix[3] << "]"s
+            << ",\"threads\":"s << options_.threads
+            << ",\"allocation\":\""s << options_.allocation << "\""s
+            << ",\"operations\":"s << operations
+            << ",\"total_ns\":"s << total_ns
+            << ",\"ns_per_op\":"s << (operations ? total_ns / static_cast<long long>(operations) : 0)
+            << ",\"checksum\":"s << checksum
+            << "}"s << endl;
+    }
+
+private:
+    const BenchmarkOptions& options_;
+};
+
+template <typename ExecutionPolicy>
+double FindAll(const SearchServer& search_server, const vector<string>& queries, ExecutionPolicy policy) {
+    double total_relevance = 0;
+    for (const string_view query : queries) {
+        for (const auto& document : search_server.FindTopDocuments(policy, query)) {
+            total_relevance += document.relevance;
+        }
+    }
+    return total_relevance;
+}
+
+// Splits the queries between the given number of threads, each query runs sequentially
+double FindAllInThreads(const SearchServer& search_server, const vector<string>& queries, int thread_count) {
+    vector<double> relevance(thread_count);
+    vector<thread> threads;
+    for (int t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&, t]() {
+            for (size_t i = t; i < queries.size(); i += thread_count) {
+                for (const auto& document : search_server.FindTopDocuments(queries[i])) {
+                    relevance[t] += document.relevance;
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    double total_relevance = 0;
+    for (const double value : relevance) {
+        total_relevance += value;
+    }
+    return total_relevance;
+}
+
+template <typename ExecutionPolicy>
+double MatchAll(const SearchServer& search_server, const vector<string>& queries, int document_count, ExecutionPolicy policy) {
+    double matched_words = 0;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const auto [words, status] = search_server.MatchDocument(policy, queries[i], static_cast<int>(i % document_count));
+        matched_words += words.size();
+    }
+    return matched_words;
+}
+
+template <typename ExecutionPolicy>
+double RemoveHalf(SearchServer& search_server, int document_count, ExecutionPolicy policy) {
+    for (int id = 0; id < document_count; id += 2) {
+        search_server.RemoveDocument(policy, id);
+    }
+    return search_server.GetDocumentCount();
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        const BenchmarkOptions options = ParseOptions(argc, argv);
+        const Corpus corpus = GenerateCorpus(options);
+        const BenchmarkRunner runner(options);
+        const int stop_word_count = min<int>(3, corpus.dictionary.size());
+        const vector<string> stop_words(corpus.dictionary.begin(), corpus.dictionary.begin() + stop_word_count);
+        const IndexMemoryOptions memory = GetIndexMemoryOptions(options);
+
+        SearchServer search_server(stop_words, memory);
+        runner.Run("add_document"s, corpus.documents.size(), [&]() {
+            FillServer(search_server, corpus);
+            return static_cast<double>(search_server.GetDocumentCount());
+        });
+
+        runner.Run("find_top_documents_seq"s, corpus.queries.size(), [&]() { return FindAll(search_server, corpus.queries, execution::seq); });
+        runner.Run("find_top_documents_par"s, corpus.queries.size(), [&]() { return FindAll(search_server, corpus.queries, execution::par); });
+        runner.Run("find_top_documents_threads"s, corpus.queries.size(), [&]() { return FindAllInThreads(search_server, corpus.queries, options.threads); });
+        runner.Run("process_queries"s, corpus.queries.size(), [&]() {
+            double total_relevance = 0;
+            for (const auto& documents : ProcessQueries(search_server, corpus.queries)) {
+                for (const auto& document : documents) {
+                    total_relevance += document.relevance;
+                }
+            }
+            return total_relevance;
+        });
+
+        runner.Run("match_document_seq"s, corpus.queries.size(), [&]() { return MatchAll(search_server, corpus.queries, options.documents, execution::seq); });
+        runner.Run("match_document_par"s, corpus.queries.size(), [&]() { return MatchAll(search_server, corpus.queries, options.documents, execution::par); });
+        runner.Run("match_documents_batch"s, corpus.queries.size(), [&]() {
+            // One page of 100 results per query
+            vector<int> ids;
+            for (int id = 0; id < min(100, options.documents); ++id) {
+                ids.push_back(id);
+            }
+            double matched_words = 0;
+            for (const string& query : corpus.queries) {
+                for (const auto& [words, status] : search_server.MatchDocuments(query, ids)) {
+                    matched_words += words.size();
+                }
+            }
+            return matched_words;
+        });
+
+        {
+            SearchServer removal_server(stop_words, memory);
+            FillServer(removal_server, corpus);
+            runner.Run("remove_document_seq"s, (corpus.documents.size() + 1) / 2, [&]() { return RemoveHalf(removal_server, options.documents, execution::seq); });
+        }
+        {
+            SearchServer removal_server(stop_words, memory);
+            FillServer(removal_server, corpus);
+            runner.Run("remove_document_par"s, (corpus.documents.size() + 1) / 2, [&]() { return RemoveHalf(removal_server, options.documents, execution::par); });
+        }
+        {
+            // Every document is added twice, so half of the corpus is removed
+            SearchServer duplicates_server(stop_words, memory);
+            FillServer(duplicates_server, corpus);
+            FillServer(duplicates_server, corpus, options.documents);
+            runner.Run("remove_duplicates"s, duplicates_server.GetDocumentCount(), [&]() { return static_cast<double>(RemoveDuplicates(duplicates_server).size()); });
+        }
+    }
+    catch (const exception& e) {
+        cerr << "Benchmark error: "s << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -1,20 +1,35 @@
 #pragma once
 
-struct Document {
-    int id;
-    double relevance;
+#include <string_view>
+
+// A search result of a BasicSearchServer, with the id and score types of its IndexTraits
+template <typename Id, typename Score>
+struct BasicDocument {
+    Id id;
+    Score relevance;
     int rating;
 
-    Document(int id_input = 0, double relevance_input = 0.0, int rating_input = 0)
+    BasicDocument(Id id_input = 0, Score relevance_input = 0, int rating_input = 0)
         : id(id_input)
         , relevance(relevance_input)
         , rating(rating_input)
     {}
 };
 
+using Document = BasicDocument<int, double>;
+
 enum class DocumentStatus {
     ACTUAL,
     IRRELEVANT,
     BANNED,
     REMOVED,
-};
\ No newline at end of file
+};
+
+// A document as it was added: enough to add it to another index with the same ranking.
+// Only the average of the ratings is kept.
+struct StoredDocument {
+    int id = 0;
+    std::string_view text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    int rating = 0;
+};
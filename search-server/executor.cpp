@@ -0,0 +1,166 @@
+#include "executor.h"
+
+#include <algorithm>
+#include <exception>
+
+namespace {
+
+// Set on worker threads only
+thread_local const WorkStealingExecutor* current_executor = nullptr;
+thread_local size_t current_worker = 0;
+
+}
+
+WorkStealingExecutor::WorkStealingExecutor(size_t thread_count) {
+    thread_count = std::max<size_t>(1, thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        queues_.push_back(std::make_unique<TaskQueue>());
+    }
+    for (size_t i = 0; i < thread_count; ++i) {
+        threads_.emplace_back([this, i]() { RunWorker(i); });
+    }
+}
+
+WorkStealingExecutor::~WorkStealingExecutor() {
+    {
+        std::lock_guard lock(sleep_mutex_);
+        stopping_ = true;
+    }
+    wake_up_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+size_t WorkStealingExecutor::GetThreadCount() const {
+    return threads_.size();
+}
+
+// A parallel loop shared by its caller and its helper tasks. Helpers keep it alive, so a helper
+// that starts after the loop has finished finds no chunk and returns.
+struct WorkStealingExecutor::LoopState {
+    const std::function<void(size_t, size_t)>* function = nullptr;
+    size_t begin = 0;
+    size_t count = 0;
+    size_t chunk_count = 0;
+    std::atomic<size_t> next_chunk{ 0 };
+    std::atomic<size_t> finished_chunks{ 0 };
+    std::mutex error_mutex;
+    std::exception_ptr error;
+};
+
+void WorkStealingExecutor::Submit(std::function<void()> task) {
+    Enqueue(injected_tasks_, std::move(task));
+}
+
+void WorkStealingExecutor::Enqueue(TaskQueue& queue, std::function<void()> task) {
+    // Counted before it is visible, so a thief never takes the count below zero
+    pending_task_count_.fetch_add(1);
+    {
+        std::lock_guard lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    {
+        // Taking the mutex orders the increment before the check of a worker going to sleep
+        std::lock_guard lock(sleep_mutex_);
+    }
+    wake_up_.notify_one();
+}
+
+WorkStealingExecutor& WorkStealingExecutor::GetDefault() {
+    static WorkStealingExecutor executor;
+    return executor;
+}
+
+void WorkStealingExecutor::RunRanges(size_t begin, size_t end, size_t grain_size, const std::function<void(size_t, size_t)>& function) {
+    if (begin >= end) {
+        return;
+    }
+    const size_t count = end - begin;
+    grain_size = std::max<size_t>(1, grain_size);
+    // A few chunks per thread even out chunks of different cost
+    const size_t chunk_count = std::min((count + grain_size - 1) / grain_size, GetThreadCount() * 4);
+    if (chunk_count <= 1) {
+        function(begin, end);
+        return;
+    }
+
+    const auto loop = std::make_shared<LoopState>();
+    loop->function = &function;
+    loop->begin = begin;
+    loop->count = count;
+    loop->chunk_count = chunk_count;
+    // A worker keeps its helpers in its own deque, where the data of the loop is still hot in its cache
+    TaskQueue& queue = current_executor == this ? *queues_[current_worker] : injected_tasks_;
+    for (size_t helper = 1; helper < chunk_count; ++helper) {
+        Enqueue(queue, [loop]() { RunChunks(*loop); });
+    }
+    // The caller never waits for a helper to be scheduled: it runs every chunk nobody has started
+    RunChunks(*loop);
+    while (loop->finished_chunks.load(std::memory_order_acquire) < chunk_count) {
+        if (!TryRunTask(true)) {
+            std::this_thread::yield();
+        }
+    }
+    if (loop->error) {
+        std::rethrow_exception(loop->error);
+    }
+}
+
+void WorkStealingExecutor::RunChunks(LoopState& loop) {
+    for (size_t chunk = loop.next_chunk.fetch_add(1); chunk < loop.chunk_count; chunk = loop.next_chunk.fetch_add(1)) {
+        try {
+            (*loop.function)(loop.begin + loop.count * chunk / loop.chunk_count, loop.begin + loop.count * (chunk + 1) / loop.chunk_count);
+        }
+        catch (...) {
+            std::lock_guard lock(loop.error_mutex);
+            if (!loop.error) {
+                loop.error = std::current_exception();
+            }
+        }
+        loop.finished_chunks.fetch_add(1, std::memory_order_release);
+    }
+}
+
+bool WorkStealingExecutor::TryRunTask(bool loop_helpers_only) {
+    const bool is_worker = current_executor == this;
+    const size_t first = is_worker ? current_worker : 0;
+    const size_t queue_count = loop_helpers_only ? queues_.size() : queues_.size() + 1;
+    for (size_t i = 0; i < queue_count; ++i) {
+        TaskQueue& queue = i < queues_.size() ? *queues_[(first + i) % queues_.size()] : injected_tasks_;
+        std::function<void()> task;
+        {
+            std::lock_guard lock(queue.mutex);
+            if (queue.tasks.empty()) {
+                continue;
+            }
+            if (is_worker && i == 0) {
+                task = std::move(queue.tasks.back());
+                queue.tasks.pop_back();
+            }
+            else {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+            }
+        }
+        pending_task_count_.fetch_sub(1);
+        task();
+        return true;
+    }
+    return false;
+}
+
+void WorkStealingExecutor::RunWorker(size_t index) {
+    current_executor = this;
+    current_worker = index;
+    while (true) {
+        if (TryRunTask(false)) {
+            continue;
+        }
+        std::unique_lock lock(sleep_mutex_);
+        wake_up_.wait(lock, [this]() { return stopping_ || pending_task_count_.load() > 0; });
+        if (stopping_ && pending_task_count_.load() == 0) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// How SearchServer spends the threads of its executor
+enum class ParallelismMode {
+    // Batches run queries in parallel, one query never takes more than one thread
+    INTER_QUERY,
+    // Every parallel query is split between the threads, batches run one query after another
+    INTRA_QUERY,
+    // Batches run queries in parallel, a parallel query is split only when it touches many postings
+    ADAPTIVE,
+};
+
+// Fixed pool of worker threads, each with its own task deque. A worker runs its newest task first
+// and steals the oldest task of another worker when its own deque is empty. Tasks submitted from
+// outside the pool wait in a shared queue and run oldest first, so a stream of new requests never
+// starves the ones submitted before them. A thread waiting for a parallel loop runs the chunks of
+// parallel loops instead of blocking, so nested loops keep the number of busy threads at the size
+// of the pool. It never starts a submitted task while it waits: the caller of the loop may hold
+// a lock that the task takes.
+class WorkStealingExecutor {
+public:
+    explicit WorkStealingExecutor(size_t thread_count = std::thread::hardware_concurrency());
+    ~WorkStealingExecutor();
+
+    WorkStealingExecutor(const WorkStealingExecutor&) = delete;
+    WorkStealingExecutor& operator=(const WorkStealingExecutor&) = delete;
+
+    size_t GetThreadCount() const;
+
+    // Runs task on a worker thread, oldest submitted first. The task must not throw.
+    void Submit(std::function<void()> task);
+
+    // Calls function(i) for every i in [begin, end). The range is split into chunks of at least
+    // grain_size indexes, the calling thread runs chunks too. The first exception thrown by
+    // function is rethrown once all chunks are done.
+    template <typename Function>
+    void ParallelFor(size_t begin, size_t end, size_t grain_size, Function function);
+
+    // Process-wide pool with a thread per core, for servers that have no executor of their own
+    static WorkStealingExecutor& GetDefault();
+
+private:
+    struct TaskQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    // Parallel loop helpers of every worker
+    std::vector<std::unique_ptr<TaskQueue>> queues_;
+    // Tasks given to Submit and loop helpers of threads outside the pool
+    TaskQueue injected_tasks_;
+    std::vector<std::thread> threads_;
+    std::atomic<size_t> pending_task_count_{ 0 };
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_up_;
+    bool stopping_ = false;
+
+    struct LoopState;
+
+    void Enqueue(TaskQueue& queue, std::function<void()> task);
+    void RunRanges(size_t begin, size_t end, size_t grain_size, const std::function<void(size_t, size_t)>& function);
+    // Runs chunks of the loop until none is left to start
+    static void RunChunks(LoopState& loop);
+    // Runs one pending task: the own deque of a worker, the deques of the others and, unless
+    // only loop helpers may run, the injected tasks; false if there was none
+    bool TryRunTask(bool loop_helpers_only);
+    void RunWorker(size_t index);
+};
+
+template <typename Function>
+void WorkStealingExecutor::ParallelFor(size_t begin, size_t end, size_t grain_size, Function function) {
+    RunRanges(begin, end, grain_size, [&function](size_t range_begin, size_t range_end) {
+        for (size_t i = range_begin; i < range_end; ++i) {
+            function(i);
+        }
+    });
+}
@@ -0,0 +1,85 @@
+#include "fuzzy_index.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std::string_literals;
+
+int ComputeEditDistance(std::string_view lhs, std::string_view rhs, int max_distance) {
+    if (lhs.size() > rhs.size()) {
+        std::swap(lhs, rhs);
+    }
+    const int limit = max_distance + 1;
+    if (static_cast<int>(rhs.size() - lhs.size()) > max_distance) {
+        return limit;
+    }
+    // Only cells with |i - j| <= max_distance can stay within max_distance, so each row computes
+    // that band and caps the rest at limit. The rows are reused across the candidates of a query.
+    thread_local std::vector<int> previous;
+    thread_local std::vector<int> current;
+    previous.resize(lhs.size() + 1);
+    current.resize(lhs.size() + 1);
+    for (size_t i = 0; i <= lhs.size(); ++i) {
+        previous[i] = std::min(static_cast<int>(i), limit);
+    }
+    const size_t band = static_cast<size_t>(max_distance);
+    for (size_t j = 1; j <= rhs.size(); ++j) {
+        const size_t first = j > band ? j - band : 1;
+        const size_t last = std::min(lhs.size(), j + band);
+        current[first - 1] = first == 1 ? std::min(static_cast<int>(j), limit) : limit;
+        int row_minimum = current[first - 1];
+        for (size_t i = first; i <= last; ++i) {
+            const int substitution = previous[i - 1] + (lhs[i - 1] == rhs[j - 1] ? 0 : 1);
+            current[i] = std::min({ previous[i] + 1, current[i - 1] + 1, substitution, limit });
+            row_minimum = std::min(row_minimum, current[i]);
+        }
+        // The next row reads one cell past the band
+        if (last < lhs.size()) {
+            current[last + 1] = limit;
+        }
+        // Distances never decrease down the table
+        if (row_minimum > max_distance) {
+            return limit;
+        }
+        std::swap(previous, current);
+    }
+    return previous[lhs.size()];
+}
+
+SymmetricDeleteIndex::SymmetricDeleteIndex(int max_distance)
+    : max_distance_(max_distance) {
+    if (max_distance < 1 || max_distance > 2) {
+        throw std::invalid_argument("Fuzzy edit distance must be 1 or 2"s);
+    }
+}
+
+void SymmetricDeleteIndex::Add(std::string_view word, int term_id) {
+    for (const uint64_t hash : GetVariantHashes(word)) {
+        variants_[hash].push_back(term_id);
+        ++entry_count_;
+    }
+}
+
+std::vector<uint64_t> SymmetricDeleteIndex::GetVariantHashes(std::string_view word) const {
+    std::unordered_set<std::string> variants{ std::string(word) };
+    std::vector<std::string> level{ std::string(word) };
+    for (int distance = 1; distance <= max_distance_; ++distance) {
+        std::vector<std::string> next_level;
+        for (const std::string& variant : level) {
+            for (size_t i = 0; i < variant.size(); ++i) {
+                std::string deleted = variant.substr(0, i) + variant.substr(i + 1);
+                if (variants.insert(deleted).second) {
+                    next_level.push_back(std::move(deleted));
+                }
+            }
+        }
+        level = std::move(next_level);
+    }
+
+    std::vector<uint64_t> hashes;
+    hashes.reserve(variants.size());
+    for (const std::string& variant : variants) {
+        hashes.push_back(HashString(variant));
+    }
+    return hashes;
+}
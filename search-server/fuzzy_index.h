@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "hash_utils.h"
+
+struct FuzzyOptions {
+    // 1 or 2
+    int max_distance = 1;
+    // Term frequencies of a word found at edit distance d are multiplied by weight_per_edit^d
+    double weight_per_edit = 0.5;
+    // By default only query words missing from the index are expanded
+    bool expand_indexed_words = false;
+};
+
+// Levenshtein distance, or max_distance + 1 if the words are farther apart than max_distance
+int ComputeEditDistance(std::string_view lhs, std::string_view rhs, int max_distance);
+
+// Symmetric delete index: every word is stored under all its variants with up to max_distance
+// characters deleted. Two words within edit distance d share a variant with at most d deletions
+// from each, so a lookup generates the deletions of the query word and probes a hash table,
+// without comparing against the whole vocabulary. Candidates must be verified with ComputeEditDistance.
+class SymmetricDeleteIndex {
+public:
+    explicit SymmetricDeleteIndex(int max_distance = 1);
+
+    void Add(std::string_view word, int term_id);
+
+    // Calls callback(term_id) for every term sharing a deletion variant with word. A term may be reported
+    // more than once, and hash collisions may report terms that are not close at all.
+    template <typename Callback>
+    void ForEachCandidate(std::string_view word, Callback callback) const;
+
+    int GetMaxDistance() const {
+        return max_distance_;
+    }
+
+    size_t GetVariantCount() const {
+        return variants_.size();
+    }
+
+    size_t GetEntryCount() const {
+        return entry_count_;
+    }
+
+private:
+    int max_distance_;
+    // Variants are keyed by their hash only, which saves storing the strings
+    std::unordered_map<uint64_t, std::vector<int>> variants_;
+    size_t entry_count_ = 0;
+
+    // Hashes of word itself and of all its distinct variants with up to max_distance deletions
+    std::vector<uint64_t> GetVariantHashes(std::string_view word) const;
+};
+
+template <typename Callback>
+void SymmetricDeleteIndex::ForEachCandidate(std::string_view word, Callback callback) const {
+    for (const uint64_t hash : GetVariantHashes(word)) {
+        const auto it = variants_.find(hash);
+        if (it == variants_.end()) {
+            continue;
+        }
+        for (const int term_id : it->second) {
+            callback(term_id);
+        }
+    }
+}
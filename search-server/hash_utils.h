@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+// FNV-1a string hash, usable at compile time
+constexpr uint64_t HashString(std::string_view str, uint64_t seed = 14695981039346656037ull) {
+    uint64_t hash = seed;
+    for (const char c : str) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// splitmix64 finalizer: spreads the bits of an integer key over the whole 64-bit range
+constexpr uint64_t MixHash(uint64_t value) {
+    value += 0x9e3779b97f4a7c15ull;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+    return value ^ (value >> 31);
+}
\ No newline at end of file
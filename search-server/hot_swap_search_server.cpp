@@ -0,0 +1,142 @@
+#include "hot_swap_search_server.h"
+
+#include <exception>
+#include <utility>
+
+#include "RemoveDuplicates.h"
+
+using namespace std::string_literals;
+
+HotSwapSearchServer::Reader::Reader(std::shared_ptr<const Generation> generation)
+    : generation_(std::move(generation))
+    , lock_(generation_->mutex) {
+}
+
+HotSwapSearchServer::HotSwapSearchServer(const std::string& stop_words, Configuration configure)
+    : configure_(std::move(configure))
+    , active_(MakeGeneration(SearchServer(stop_words).GetStopWords())) {
+}
+
+HotSwapSearchServer::~HotSwapSearchServer() {
+    if (rebuild_thread_.joinable()) {
+        rebuild_thread_.join();
+    }
+}
+
+HotSwapSearchServer::Reader HotSwapSearchServer::Read() const {
+    return Reader(std::atomic_load(&active_));
+}
+
+std::vector<Document> HotSwapSearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status) const {
+    return Read()->FindTopDocuments(raw_query, status);
+}
+
+int HotSwapSearchServer::GetDocumentCount() const {
+    return Read()->GetDocumentCount();
+}
+
+void HotSwapSearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    std::lock_guard write_lock(write_mutex_);
+    {
+        const std::shared_ptr<Generation> active = std::atomic_load(&active_);
+        std::unique_lock lock(active->mutex);
+        active->server.AddDocument(document_id, document, status, ratings);
+    }
+    if (is_rebuilding_) {
+        journal_.push_back({ true, document_id, std::string(document), status, ratings });
+    }
+}
+
+void HotSwapSearchServer::RemoveDocument(int document_id) {
+    std::lock_guard write_lock(write_mutex_);
+    {
+        const std::shared_ptr<Generation> active = std::atomic_load(&active_);
+        std::unique_lock lock(active->mutex);
+        active->server.RemoveDocument(document_id);
+    }
+    if (is_rebuilding_) {
+        journal_.push_back({ false, document_id, std::string(), DocumentStatus::ACTUAL, {} });
+    }
+}
+
+std::future<std::vector<int>> HotSwapSearchServer::Rebuild(RebuildOptions options) {
+    std::vector<std::string> stop_words;
+    std::vector<JournalEntry> documents;
+    {
+        // Taking the copy and starting the journal under one lock, no write falls in between
+        std::lock_guard write_lock(write_mutex_);
+        if (is_rebuilding_) {
+            throw std::logic_error("Rebuild is already running"s);
+        }
+        const Reader reader = Read();
+        stop_words = options.stop_words ? SearchServer(*options.stop_words).GetStopWords() : reader->GetStopWords();
+        documents.reserve(reader->GetDocumentCount());
+        for (const int document_id : *reader) {
+            const StoredDocument document = reader->GetStoredDocument(document_id);
+            documents.push_back({ true, document_id, std::string(document.text), document.status, { document.rating } });
+        }
+        is_rebuilding_ = true;
+    }
+    if (rebuild_thread_.joinable()) {
+        rebuild_thread_.join();
+    }
+
+    std::promise<std::vector<int>> promise;
+    std::future<std::vector<int>> result = promise.get_future();
+    rebuild_thread_ = std::thread([this, options = std::move(options), stop_words = std::move(stop_words),
+                                   documents = std::move(documents), promise = std::move(promise)]() mutable {
+        try {
+            promise.set_value(RunRebuild(options, stop_words, documents));
+        }
+        catch (...) {
+            {
+                std::lock_guard write_lock(write_mutex_);
+                is_rebuilding_ = false;
+                journal_.clear();
+            }
+            promise.set_exception(std::current_exception());
+        }
+    });
+    return result;
+}
+
+uint64_t HotSwapSearchServer::GetGeneration() const {
+    return generation_count_.load();
+}
+
+std::shared_ptr<HotSwapSearchServer::Generation> HotSwapSearchServer::MakeGeneration(const std::vector<std::string>& stop_words) const {
+    auto generation = std::make_shared<Generation>(stop_words);
+    if (configure_) {
+        configure_(generation->server);
+    }
+    return generation;
+}
+
+std::vector<int> HotSwapSearchServer::RunRebuild(const RebuildOptions& options, const std::vector<std::string>& stop_words,
+                                                 const std::vector<JournalEntry>& documents) {
+    const std::shared_ptr<Generation> generation = MakeGeneration(stop_words);
+    SearchServer& server = generation->server;
+    for (const JournalEntry& document : documents) {
+        server.AddDocument(document.document_id, document.text, document.status, document.ratings);
+    }
+    std::vector<int> removed_ids;
+    if (options.remove_duplicates) {
+        removed_ids = RemoveDuplicates(server);
+    }
+
+    // Nobody else sees the new index yet, writes wait only for the replay of the journal
+    std::lock_guard write_lock(write_mutex_);
+    for (const JournalEntry& entry : journal_) {
+        if (entry.is_add) {
+            server.AddDocument(entry.document_id, entry.text, entry.status, entry.ratings);
+        }
+        else {
+            server.RemoveDocument(entry.document_id);
+        }
+    }
+    journal_.clear();
+    is_rebuilding_ = false;
+    std::atomic_store(&active_, generation);
+    generation_count_.fetch_add(1);
+    return removed_ids;
+}
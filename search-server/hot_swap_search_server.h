@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "search_server.h"
+
+struct RebuildOptions {
+    // Stop words of the new index, the current ones if not set
+    std::optional<std::string> stop_words;
+    // Runs RemoveDuplicates on the new index before it is swapped in
+    bool remove_duplicates = false;
+};
+
+// Holds the active SearchServer through a shared_ptr and replaces it with an index rebuilt in the
+// background: compacted (removed documents leave their text and words behind in SearchServer),
+// deduplicated or with other stop words. Writes made during a rebuild go to the active index
+// and are replayed on the new one right before the swap. Readers keep the index they started
+// with, an old index is freed when its last reader leaves.
+class HotSwapSearchServer {
+    struct Generation;
+
+public:
+    // Settings the index does not carry over to its replacement: positional index, fuzzy mode, parallelism
+    using Configuration = std::function<void(SearchServer&)>;
+
+    // Lock of one index: while it is held the index neither changes nor gets freed
+    class Reader {
+    public:
+        const SearchServer& operator*() const {
+            return generation_->server;
+        }
+        const SearchServer* operator->() const {
+            return &generation_->server;
+        }
+
+    private:
+        friend class HotSwapSearchServer;
+        std::shared_ptr<const Generation> generation_;
+        std::shared_lock<std::shared_mutex> lock_;
+
+        explicit Reader(std::shared_ptr<const Generation> generation);
+    };
+
+    explicit HotSwapSearchServer(const std::string& stop_words = std::string(), Configuration configure = Configuration());
+    ~HotSwapSearchServer();
+
+    HotSwapSearchServer(const HotSwapSearchServer&) = delete;
+    HotSwapSearchServer& operator=(const HotSwapSearchServer&) = delete;
+
+    Reader Read() const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL) const;
+    int GetDocumentCount() const;
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+
+    // Starts building a new index from the documents of the active one. The future becomes ready
+    // once the new index is active and holds the ids RemoveDuplicates removed. Only one rebuild
+    // runs at a time, a second call throws std::logic_error. Invalid stop words throw right away.
+    std::future<std::vector<int>> Rebuild(RebuildOptions options = RebuildOptions());
+    // Number of swaps so far
+    uint64_t GetGeneration() const;
+
+private:
+    struct Generation {
+        explicit Generation(const std::vector<std::string>& stop_words)
+            : server(stop_words) {
+        }
+
+        SearchServer server;
+        mutable std::shared_mutex mutex;
+    };
+
+    struct JournalEntry {
+        bool is_add;
+        int document_id;
+        std::string text;
+        DocumentStatus status;
+        std::vector<int> ratings;
+    };
+
+    const Configuration configure_;
+    // Read and replaced with std::atomic_load and std::atomic_store
+    std::shared_ptr<Generation> active_;
+    std::atomic<uint64_t> generation_count_{ 0 };
+
+    // Serializes writers with each other and with the swap
+    std::mutex write_mutex_;
+    bool is_rebuilding_ = false;
+    std::vector<JournalEntry> journal_;
+    std::thread rebuild_thread_;
+
+    std::shared_ptr<Generation> MakeGeneration(const std::vector<std::string>& stop_words) const;
+    // Documents are added to the new index as ADD entries
+    std::vector<int> RunRebuild(const RebuildOptions& options, const std::vector<std::string>& stop_words,
+                                const std::vector<JournalEntry>& documents);
+};
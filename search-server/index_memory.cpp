@@ -0,0 +1,25 @@
+#include "index_memory.h"
+
+void* SynchronizedMonotonicResource::do_allocate(size_t bytes, size_t alignment) {
+    std::lock_guard guard(mutex_);
+    return resource_.allocate(bytes, alignment);
+}
+
+void SynchronizedMonotonicResource::do_deallocate(void* /*pointer*/, size_t /*bytes*/, size_t /*alignment*/) {
+    // Monotonic memory is released with the resource
+}
+
+bool SynchronizedMonotonicResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
+
+std::unique_ptr<std::pmr::memory_resource> MakeIndexMemoryResource(const IndexMemoryOptions& options) {
+    switch (options.allocation) {
+    case IndexAllocation::POOLED:
+        return std::make_unique<std::pmr::synchronized_pool_resource>();
+    case IndexAllocation::MONOTONIC:
+        return std::make_unique<SynchronizedMonotonicResource>(options.initial_arena_size);
+    default:
+        return nullptr;
+    }
+}
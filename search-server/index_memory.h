@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+
+// Where a SearchServer allocates its index: the posting lists, the forward index, the document
+// table and the texts. The resource is chosen at construction and lives as long as the server.
+enum class IndexAllocation {
+    // Global operator new, as without memory resources
+    DEFAULT,
+    // Pools of blocks per node size, for an index updated a document at a time.
+    // Freed nodes go back to their pool instead of to malloc, so threads contend less and memory
+    // does not fragment.
+    POOLED,
+    // Bump allocation from growing chunks, nothing is freed before the server is destroyed.
+    // The fastest way to build an index in bulk that is then mostly queried.
+    MONOTONIC,
+};
+
+struct IndexMemoryOptions {
+    IndexAllocation allocation = IndexAllocation::DEFAULT;
+    // First chunk of a MONOTONIC arena, later chunks grow geometrically
+    size_t initial_arena_size = 1 << 20;
+};
+
+// A monotonic_buffer_resource behind a mutex: parallel removals allocate from the index on several threads
+class SynchronizedMonotonicResource : public std::pmr::memory_resource {
+public:
+    explicit SynchronizedMonotonicResource(size_t initial_size)
+        : resource_(initial_size) {
+    }
+
+private:
+    std::mutex mutex_;
+    std::pmr::monotonic_buffer_resource resource_;
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+};
+
+// Null for DEFAULT, where the index uses std::pmr::new_delete_resource()
+std::unique_ptr<std::pmr::memory_resource> MakeIndexMemoryResource(const IndexMemoryOptions& options);
+
+// Scratch memory of one query or one AddDocument call. Containers built on it are bump-allocated
+// from an inline buffer, spill to the heap only when it is full, and are all freed at once when
+// the arena goes out of scope. Not thread-safe: every thread needs its own arena.
+class ScratchArena {
+public:
+    static constexpr size_t INLINE_SIZE = 16 * 1024;
+
+    ScratchArena()
+        : resource_(buffer_, INLINE_SIZE) {
+    }
+
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+
+    std::pmr::memory_resource* Get() {
+        return &resource_;
+    }
+
+private:
+    alignas(std::max_align_t) std::byte buffer_[INLINE_SIZE];
+    std::pmr::monotonic_buffer_resource resource_;
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// Term frequency of a word met occurrences times in a document of length words
+inline double ComputeTermFreq(uint32_t occurrences, uint32_t length) {
+    return static_cast<double>(occurrences) / length;
+}
+
+// Compile-time types of a BasicSearchServer: document ids, term frequencies reported by
+// GetWordFrequencies and relevance accumulators. The index keeps occurrence counts in the postings
+// and term ids per document, so these types decide the size of the query scratch maps and results.
+// MakeTermFreq turns the occurrences of a word in a document of length words into a TermFreq.
+// The member functions are compiled in search_server.cpp: a custom traits type links once it is
+// added to the explicit instantiations at the end of that file and declared extern template in
+// search_server.h next to the shipped ones.
+
+// The original layout: int ids, double frequencies and scores
+struct DefaultIndexTraits {
+    using DocumentId = int;
+    using TermFreq = double;
+    using Score = double;
+
+    static constexpr size_t MAX_RESULT_DOCUMENT_COUNT = 5;
+    // Relevances closer than EPS rank equally
+    static constexpr double EPS = 1e-6;
+
+    static TermFreq MakeTermFreq(uint32_t occurrences, uint32_t length) {
+        return ComputeTermFreq(occurrences, length);
+    }
+};
+
+// Single precision frequencies and scores. Relevance keeps about 7 significant digits,
+// so EPS is coarser than the default one.
+struct CompactIndexTraits {
+    using DocumentId = int;
+    using TermFreq = float;
+    using Score = float;
+
+    static constexpr size_t MAX_RESULT_DOCUMENT_COUNT = 5;
+    static constexpr double EPS = 1e-5;
+
+    static TermFreq MakeTermFreq(uint32_t occurrences, uint32_t length) {
+        return static_cast<float>(occurrences) / length;
+    }
+};
+
+// Word frequencies are raw occurrence counts, saturated at 65535; the share of a word
+// is the count over the document length. Scores stay in double.
+struct QuantizedIndexTraits {
+    using DocumentId = int;
+    using TermFreq = uint16_t;
+    using Score = double;
+
+    static constexpr size_t MAX_RESULT_DOCUMENT_COUNT = 5;
+    static constexpr double EPS = 1e-6;
+
+    static TermFreq MakeTermFreq(uint32_t occurrences, uint32_t /*length*/) {
+        return static_cast<uint16_t>(occurrences < UINT16_MAX ? occurrences : UINT16_MAX);
+    }
+};
+
+// Collections of at most 32767 documents: int16_t ids halve the id keys of the document maps
+// and of the query scratch maps. Frequencies and scores as in CompactIndexTraits.
+struct NarrowIndexTraits {
+    using DocumentId = int16_t;
+    using TermFreq = float;
+    using Score = float;
+
+    static constexpr size_t MAX_RESULT_DOCUMENT_COUNT = 5;
+    static constexpr double EPS = 1e-5;
+
+    static TermFreq MakeTermFreq(uint32_t occurrences, uint32_t length) {
+        return static_cast<float>(occurrences) / length;
+    }
+};
+
+// Postings and the term id arrays store ids as int
+template <typename Traits>
+constexpr bool IsValidIndexTraits() {
+    using Id = typename Traits::DocumentId;
+    return std::is_integral_v<Id> && std::is_signed_v<Id> && sizeof(Id) <= sizeof(int)
+        && std::is_arithmetic_v<typename Traits::TermFreq> && std::is_floating_point_v<typename Traits::Score>;
+}
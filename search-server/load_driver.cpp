@@ -0,0 +1,250 @@
+#include "search_server.h"
+#include "metrics.h"
+#include "workload.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Closed-loop load driver: every thread issues its next request as soon as the previous one
+// returns, the kind of request is drawn from the configured mix. Prints one JSON line per
+// operation kind and a total line:
+//   load_driver --threads=8 --seconds=10 --mix=90,5,3,2 --documents=10000 --vocabulary=10000
+enum class Operation {
+    FIND,
+    MATCH,
+    ADD,
+    REMOVE,
+    COUNT,
+};
+
+const size_t OPERATION_COUNT = static_cast<size_t>(Operation::COUNT);
+const array<const char*, OPERATION_COUNT> OPERATION_NAMES = { "find_top_documents", "match_document", "add_document", "remove_document" };
+
+struct DriverOptions {
+    WorkloadOptions workload;
+    int threads = max(1u, thread::hardware_concurrency());
+    double seconds = 5;
+    // Weights of FindTopDocuments, MatchDocument, AddDocument and RemoveDocument requests
+    array<double, OPERATION_COUNT> mix = { 90, 5, 3, 2 };
+};
+
+array<double, OPERATION_COUNT> ParseMix(const string& text) {
+    array<double, OPERATION_COUNT> mix = {};
+    size_t position = 0;
+    for (double& weight : mix) {
+        const size_t comma = text.find(',', position);
+        weight = stod(text.substr(position, comma - position));
+        if (comma == string::npos) {
+            break;
+        }
+        position = comma + 1;
+    }
+    return mix;
+}
+
+DriverOptions ParseOptions(int argc, char* argv[]) {
+    DriverOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const string argument = argv[i];
+        const size_t equal = argument.find('=');
+        if (argument.rfind("--"s, 0) != 0 || equal == string::npos) {
+            throw invalid_argument("Expected --name=value, got "s + argument);
+        }
+        const string name = argument.substr(2, equal - 2);
+        const string value = argument.substr(equal + 1);
+        if (name == "threads"s) {
+            options.threads = max(1, stoi(value));
+        }
+        else if (name == "seconds"s) {
+            options.seconds = stod(value);
+        }
+        else if (name == "mix"s) {
+            options.mix = ParseMix(value);
+        }
+        else if (name == "vocabulary"s) {
+            options.workload.vocabulary = stoi(value);
+        }
+        else if (name == "max-word-length"s) {
+            options.workload.max_word_length = stoi(value);
+        }
+        else if (name == "word-exponent"s) {
+            options.workload.word_exponent = stod(value);
+        }
+        else if (name == "documents"s) {
+            options.workload.documents = stoi(value);
+        }
+        else if (name == "max-document-words"s) {
+            options.workload.max_document_words = stoi(value);
+        }
+        else if (name == "document-length-exponent"s) {
+            options.workload.document_length_exponent = stod(value);
+        }
+        else if (name == "queries"s) {
+            options.workload.queries = stoi(value);
+        }
+        else if (name == "minus-prob"s) {
+            options.workload.minus_prob = stod(value);
+        }
+        else if (name == "seed"s) {
+            options.workload.seed = stoi(value);
+        }
+        else {
+            throw invalid_argument("Unknown option "s + name);
+        }
+    }
+    return options;
+}
+
+// SearchServer is not safe for concurrent writes: readers share the lock, writers take it exclusively.
+// live_ids is guarded by the same lock, so readers can pick an existing document.
+class LoadDriver {
+public:
+    LoadDriver(const DriverOptions& options, const Workload& workload)
+        : options_(options)
+        , workload_(workload)
+        , search_server_("and in on the"s)
+        , next_id_(static_cast<int>(workload.documents.size())) {
+        for (size_t i = 0; i < workload_.documents.size(); ++i) {
+            search_server_.AddDocument(static_cast<int>(i), workload_.documents[i], DocumentStatus::ACTUAL, { 1 });
+            live_ids_.push_back(static_cast<int>(i));
+        }
+    }
+
+    void Run() {
+        const auto deadline = chrono::steady_clock::now() + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(options_.seconds));
+        const auto start = chrono::steady_clock::now();
+        vector<thread> threads;
+        for (int t = 0; t < options_.threads; ++t) {
+            threads.emplace_back([this, t, deadline]() {
+                RunThread(options_.workload.seed + t + 1, deadline);
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        elapsed_seconds_ = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+
+    void PrintReport(ostream& output) const {
+        uint64_t total = 0;
+        for (size_t i = 0; i < OPERATION_COUNT; ++i) {
+            const HdrHistogram& latency = latency_ns_[i];
+            total += latency.GetCount();
+            output << "{\"operation\":\""s << OPERATION_NAMES[i] << "\""s
+                << ",\"threads\":"s << options_.threads
+                << ",\"operations\":"s << latency.GetCount()
+                << ",\"errors\":"s << errors_[i].load()
+                << ",\"throughput_ops\":"s << latency.GetCount() / elapsed_seconds_
+                << ",\"mean_ns\":"s << (latency.GetCount() ? latency.GetSum() / latency.GetCount() : 0)
+                << ",\"p50_ns\":"s << latency.GetValueAtQuantile(0.5)
+                << ",\"p99_ns\":"s << latency.GetValueAtQuantile(0.99)
+                << ",\"p999_ns\":"s << latency.GetValueAtQuantile(0.999)
+                << "}"s << endl;
+        }
+        output << "{\"operation\":\"total\",\"threads\":"s << options_.threads
+            << ",\"operations\":"s << total
+            << ",\"seconds\":"s << elapsed_seconds_
+            << ",\"throughput_ops\":"s << total / elapsed_seconds_
+            << ",\"documents\":"s << search_server_.GetDocumentCount()
+            << "}"s << endl;
+    }
+
+private:
+    const DriverOptions& options_;
+    const Workload& workload_;
+    SearchServer search_server_;
+    mutable shared_mutex mutex_;
+    vector<int> live_ids_;
+    atomic<int> next_id_;
+    array<HdrHistogram, OPERATION_COUNT> latency_ns_;
+    array<atomic<uint64_t>, OPERATION_COUNT> errors_ = {};
+    double elapsed_seconds_ = 0;
+
+    void RunThread(int seed, chrono::steady_clock::time_point deadline) {
+        mt19937 generator(seed);
+        discrete_distribution<int> operations(options_.mix.begin(), options_.mix.end());
+        double checksum = 0;
+        while (chrono::steady_clock::now() < deadline) {
+            const auto operation = static_cast<Operation>(operations(generator));
+            const auto start = chrono::steady_clock::now();
+            try {
+                checksum += Execute(operation, generator);
+            }
+            catch (const exception&) {
+                errors_[static_cast<size_t>(operation)].fetch_add(1, memory_order_relaxed);
+            }
+            latency_ns_[static_cast<size_t>(operation)].Record(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
+        }
+        // Keeps the results observable for the optimizer
+        if (checksum < 0) {
+            cerr << checksum << endl;
+        }
+    }
+
+    double Execute(Operation operation, mt19937& generator) {
+        switch (operation) {
+        case Operation::FIND: {
+            const string& query = workload_.queries[uniform_int_distribution<size_t>(0, workload_.queries.size() - 1)(generator)];
+            shared_lock lock(mutex_);
+            return static_cast<double>(search_server_.FindTopDocuments(query).size());
+        }
+        case Operation::MATCH: {
+            const string& query = workload_.queries[uniform_int_distribution<size_t>(0, workload_.queries.size() - 1)(generator)];
+            shared_lock lock(mutex_);
+            if (live_ids_.empty()) {
+                return 0;
+            }
+            const int id = live_ids_[uniform_int_distribution<size_t>(0, live_ids_.size() - 1)(generator)];
+            return static_cast<double>(get<0>(search_server_.MatchDocument(query, id)).size());
+        }
+        case Operation::ADD: {
+            const string& text = workload_.documents[uniform_int_distribution<size_t>(0, workload_.documents.size() - 1)(generator)];
+            const int id = next_id_.fetch_add(1, memory_order_relaxed);
+            unique_lock lock(mutex_);
+            search_server_.AddDocument(id, text, DocumentStatus::ACTUAL, { 1 });
+            live_ids_.push_back(id);
+            return 1;
+        }
+        case Operation::REMOVE: {
+            unique_lock lock(mutex_);
+            if (live_ids_.empty()) {
+                return 0;
+            }
+            const size_t index = uniform_int_distribution<size_t>(0, live_ids_.size() - 1)(generator);
+            search_server_.RemoveDocument(live_ids_[index]);
+            live_ids_[index] = live_ids_.back();
+            live_ids_.pop_back();
+            return 1;
+        }
+        default:
+            return 0;
+        }
+    }
+};
+
+int main(int argc, char* argv[]) {
+    try {
+        const DriverOptions options = ParseOptions(argc, argv);
+        const Workload workload = GenerateWorkload(options.workload);
+        LoadDriver driver(options, workload);
+        driver.Run();
+        driver.PrintReport(cout);
+    }
+    catch (const exception& e) {
+        cerr << "Load driver error: "s << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,27 @@
+#include "memory_usage.h"
+
+using namespace std::string_literals;
+
+size_t MemoryUsage::GetTotalBytes() const {
+    size_t total = 0;
+    for (const auto& structure : structures) {
+        total += structure.GetTotalBytes();
+    }
+    return total;
+}
+
+double MemoryUsage::GetBytesPerDocument() const {
+    return document_count == 0 ? 0.0 : static_cast<double>(GetTotalBytes()) / document_count;
+}
+
+std::ostream& operator<<(std::ostream& output, const MemoryUsage& usage) {
+    for (const auto& structure : usage.structures) {
+        output << structure.name << ": "s
+            << structure.GetTotalBytes() << " bytes ("s
+            << structure.overhead_bytes << " overhead), "s
+            << structure.node_count << " nodes"s << std::endl;
+    }
+    output << "total: "s << usage.GetTotalBytes() << " bytes, "s
+        << usage.GetBytesPerDocument() << " bytes per document"s << std::endl;
+    return output;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Estimates of what the standard containers of libstdc++ allocate on a 64-bit glibc system.
+// They are computed from element counts only, so a breakdown costs O(1) per structure.
+
+// Bytes glibc malloc really takes for a request: an 8 byte header, 16 byte alignment, 32 bytes at least
+constexpr size_t GetMallocChunkSize(size_t requested) {
+    if (requested == 0) {
+        return 0;
+    }
+    const size_t chunk = (requested + 8 + 15) / 16 * 16;
+    return chunk < 32 ? 32 : chunk;
+}
+
+// std::map and std::set node: color, parent, left and right pointers followed by the value
+template <typename Value>
+constexpr size_t GetTreeNodeSize() {
+    return 4 * sizeof(void*) + sizeof(Value);
+}
+
+// std::list node: two pointers followed by the value
+template <typename Value>
+constexpr size_t GetListNodeSize() {
+    return 2 * sizeof(void*) + sizeof(Value);
+}
+
+// std::unordered_map node: next pointer, the value and the cached hash
+template <typename Value>
+constexpr size_t GetHashNodeSize() {
+    return sizeof(void*) + sizeof(Value) + sizeof(size_t);
+}
+
+// Heap bytes of a string that does not fit into the small string buffer
+template <typename String>
+size_t GetStringHeapSize(const String& text) {
+    return text.capacity() > 15 ? text.capacity() + 1 : 0;
+}
+
+struct StructureMemoryUsage {
+    std::string_view name;
+    size_t node_count = 0;
+    // Bytes the container asked for
+    size_t payload_bytes = 0;
+    // Malloc headers and alignment padding on top of the payload
+    size_t overhead_bytes = 0;
+
+    size_t GetTotalBytes() const {
+        return payload_bytes + overhead_bytes;
+    }
+
+    // Accounts count allocations of the given size each
+    void AddAllocations(size_t count, size_t size) {
+        payload_bytes += count * size;
+        overhead_bytes += count * (GetMallocChunkSize(size) - size);
+    }
+
+    void RemoveAllocations(size_t count, size_t size) {
+        payload_bytes -= count * size;
+        overhead_bytes -= count * (GetMallocChunkSize(size) - size);
+    }
+
+    // Accounts the bytes of another structure, leaves node_count alone
+    void AddBytes(const StructureMemoryUsage& other) {
+        payload_bytes += other.payload_bytes;
+        overhead_bytes += other.overhead_bytes;
+    }
+
+    void RemoveBytes(const StructureMemoryUsage& other) {
+        payload_bytes -= other.payload_bytes;
+        overhead_bytes -= other.overhead_bytes;
+    }
+};
+
+struct MemoryUsage {
+    std::vector<StructureMemoryUsage> structures;
+    size_t document_count = 0;
+
+    size_t GetTotalBytes() const;
+    double GetBytesPerDocument() const;
+};
+
+std::ostream& operator<<(std::ostream& output, const MemoryUsage& usage);
@@ -0,0 +1,187 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+
+using namespace std::string_literals;
+
+namespace {
+
+thread_local std::array<MetricsScope*, static_cast<size_t>(MetricsEntryPoint::COUNT)> active_scopes = {};
+
+void WriteSummary(std::ostream& output, const std::string& name, std::string_view entry, const HdrHistogram& histogram, double scale) {
+    for (const double quantile : { 0.5, 0.9, 0.99, 0.999 }) {
+        output << name << "{entry=\""s << entry << "\",quantile=\""s << quantile << "\"} "s
+            << histogram.GetValueAtQuantile(quantile) * scale << '\n';
+    }
+    output << name << "_sum{entry=\""s << entry << "\"} "s << histogram.GetSum() * scale << '\n';
+    output << name << "_count{entry=\""s << entry << "\"} "s << histogram.GetCount() << '\n';
+}
+
+}
+
+std::string_view GetMetricsEntryPointName(MetricsEntryPoint entry_point) {
+    switch (entry_point) {
+    case MetricsEntryPoint::ADD_DOCUMENT:
+        return "add_document";
+    case MetricsEntryPoint::REMOVE_DOCUMENT:
+        return "remove_document";
+    case MetricsEntryPoint::FIND_TOP_DOCUMENTS_SEQ:
+        return "find_top_documents_seq";
+    case MetricsEntryPoint::FIND_TOP_DOCUMENTS_PAR:
+        return "find_top_documents_par";
+    case MetricsEntryPoint::MATCH_DOCUMENT:
+        return "match_document";
+    case MetricsEntryPoint::MATCH_DOCUMENTS:
+        return "match_documents";
+    case MetricsEntryPoint::PROCESS_QUERIES:
+        return "process_queries";
+    default:
+        return "unknown";
+    }
+}
+
+void HdrHistogram::Record(uint64_t value) {
+    counts_[GetBucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t HdrHistogram::GetCount() const {
+    return count_.load(std::memory_order_relaxed);
+}
+
+uint64_t HdrHistogram::GetSum() const {
+    return sum_.load(std::memory_order_relaxed);
+}
+
+uint64_t HdrHistogram::GetValueAtQuantile(double quantile) const {
+    const uint64_t count = GetCount();
+    if (count == 0) {
+        return 0;
+    }
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(quantile * count + 0.5));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; ++i) {
+        seen += counts_[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            return GetBucketUpperBound(i);
+        }
+    }
+    return GetBucketUpperBound(BUCKET_COUNT - 1);
+}
+
+void HdrHistogram::Reset() {
+    for (auto& bucket_count : counts_) {
+        bucket_count.store(0, std::memory_order_relaxed);
+    }
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+}
+
+size_t HdrHistogram::GetBucketIndex(uint64_t value) {
+    if (value < SUB_BUCKET_COUNT) {
+        return value;
+    }
+    const int exponent = 63 - __builtin_clzll(value);
+    const size_t sub_bucket = (value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKET_COUNT - 1);
+    return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT + sub_bucket;
+}
+
+uint64_t HdrHistogram::GetBucketUpperBound(size_t index) {
+    if (index < SUB_BUCKET_COUNT) {
+        return index;
+    }
+    const int exponent = static_cast<int>(index / SUB_BUCKET_COUNT) + SUB_BUCKET_BITS - 1;
+    const uint64_t sub_bucket = index % SUB_BUCKET_COUNT;
+    const uint64_t lower_bound = (SUB_BUCKET_COUNT + sub_bucket) << (exponent - SUB_BUCKET_BITS);
+    return lower_bound + (uint64_t(1) << (exponent - SUB_BUCKET_BITS)) - 1;
+}
+
+void SearchServerMetrics::WriteSnapshot(std::ostream& output) const {
+    const auto write_counter = [this, &output](const std::string& name, std::atomic<uint64_t> EntryPointMetrics::* counter) {
+        output << "# TYPE "s << name << " counter\n"s;
+        for (size_t i = 0; i < entry_points_.size(); ++i) {
+            output << name << "{entry=\""s << GetMetricsEntryPointName(static_cast<MetricsEntryPoint>(i)) << "\"} "s
+                << (entry_points_[i].*counter).load(std::memory_order_relaxed) << '\n';
+        }
+    };
+    write_counter("search_server_calls_total"s, &EntryPointMetrics::calls);
+    write_counter("search_server_errors_total"s, &EntryPointMetrics::errors);
+    write_counter("search_server_documents_scored_total"s, &EntryPointMetrics::documents_scored);
+    write_counter("search_server_postings_touched_total"s, &EntryPointMetrics::postings_touched);
+
+    output << "# TYPE search_server_latency_seconds summary\n"s;
+    for (size_t i = 0; i < entry_points_.size(); ++i) {
+        WriteSummary(output, "search_server_latency_seconds"s, GetMetricsEntryPointName(static_cast<MetricsEntryPoint>(i)), entry_points_[i].latency_ns, 1e-9);
+    }
+    output << "# TYPE search_server_postings_per_call summary\n"s;
+    for (size_t i = 0; i < entry_points_.size(); ++i) {
+        WriteSummary(output, "search_server_postings_per_call"s, GetMetricsEntryPointName(static_cast<MetricsEntryPoint>(i)), entry_points_[i].postings_per_call, 1.0);
+    }
+    output.flush();
+}
+
+bool SearchServerMetrics::WriteSnapshotToFile(const std::string& path) const {
+    const std::string temporary_path = path + ".tmp"s;
+    {
+        std::ofstream output(temporary_path);
+        if (!output) {
+            return false;
+        }
+        WriteSnapshot(output);
+        if (!output) {
+            return false;
+        }
+    }
+    return std::rename(temporary_path.c_str(), path.c_str()) == 0;
+}
+
+void SearchServerMetrics::Reset() {
+    for (auto& metrics : entry_points_) {
+        metrics.latency_ns.Reset();
+        metrics.postings_per_call.Reset();
+        metrics.calls.store(0, std::memory_order_relaxed);
+        metrics.errors.store(0, std::memory_order_relaxed);
+        metrics.documents_scored.store(0, std::memory_order_relaxed);
+        metrics.postings_touched.store(0, std::memory_order_relaxed);
+    }
+}
+
+SearchServerMetrics& GetSearchServerMetrics() {
+    static SearchServerMetrics metrics;
+    return metrics;
+}
+
+MetricsScope::MetricsScope(MetricsEntryPoint entry_point)
+    : entry_point_(entry_point)
+    , target_(active_scopes[static_cast<size_t>(entry_point)] ? active_scopes[static_cast<size_t>(entry_point)] : this)
+    , uncaught_exceptions_(std::uncaught_exceptions())
+{
+    if (target_ == this) {
+        active_scopes[static_cast<size_t>(entry_point_)] = this;
+    }
+}
+
+MetricsScope::~MetricsScope() {
+    if (target_ != this) {
+        return;
+    }
+    active_scopes[static_cast<size_t>(entry_point_)] = nullptr;
+
+    EntryPointMetrics& metrics = GetSearchServerMetrics().Get(entry_point_);
+    metrics.latency_ns.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start_time_).count());
+    metrics.calls.fetch_add(1, std::memory_order_relaxed);
+    if (std::uncaught_exceptions() > uncaught_exceptions_) {
+        metrics.errors.fetch_add(1, std::memory_order_relaxed);
+    }
+    metrics.documents_scored.fetch_add(documents_scored_, std::memory_order_relaxed);
+    metrics.postings_touched.fetch_add(postings_touched_, std::memory_order_relaxed);
+    metrics.postings_per_call.Record(postings_touched_);
+}
+
+MetricsScope* MetricsScope::GetActive(MetricsEntryPoint entry_point) {
+    return active_scopes[static_cast<size_t>(entry_point)];
+}
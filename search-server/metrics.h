@@ -0,0 +1,113 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+enum class MetricsEntryPoint {
+    ADD_DOCUMENT,
+    REMOVE_DOCUMENT,
+    FIND_TOP_DOCUMENTS_SEQ,
+    FIND_TOP_DOCUMENTS_PAR,
+    MATCH_DOCUMENT,
+    MATCH_DOCUMENTS,
+    PROCESS_QUERIES,
+    COUNT,
+};
+
+std::string_view GetMetricsEntryPointName(MetricsEntryPoint entry_point);
+
+// HDR-style histogram: values are grouped by power of two, and every power of two is split
+// into 16 linear sub-buckets, which keeps the relative error of any quantile under 1/16.
+// Recording is a few relaxed atomic increments.
+class HdrHistogram {
+public:
+    void Record(uint64_t value);
+
+    uint64_t GetCount() const;
+    uint64_t GetSum() const;
+    // Upper bound of the bucket holding the given quantile (0 <= quantile <= 1)
+    uint64_t GetValueAtQuantile(double quantile) const;
+    void Reset();
+
+private:
+    static const int SUB_BUCKET_BITS = 4;
+    static const size_t SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+    static const size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> counts_ = {};
+    std::atomic<uint64_t> count_{ 0 };
+    std::atomic<uint64_t> sum_{ 0 };
+
+    static size_t GetBucketIndex(uint64_t value);
+    static uint64_t GetBucketUpperBound(size_t index);
+};
+
+struct EntryPointMetrics {
+    HdrHistogram latency_ns;
+    HdrHistogram postings_per_call;
+    std::atomic<uint64_t> calls{ 0 };
+    std::atomic<uint64_t> errors{ 0 };
+    std::atomic<uint64_t> documents_scored{ 0 };
+    std::atomic<uint64_t> postings_touched{ 0 };
+};
+
+// Process-wide metrics of SearchServer entry points
+class SearchServerMetrics {
+public:
+    EntryPointMetrics& Get(MetricsEntryPoint entry_point) {
+        return entry_points_[static_cast<size_t>(entry_point)];
+    }
+
+    const EntryPointMetrics& Get(MetricsEntryPoint entry_point) const {
+        return entry_points_[static_cast<size_t>(entry_point)];
+    }
+
+    // Prometheus text exposition format
+    void WriteSnapshot(std::ostream& output) const;
+    // Writes the snapshot into a temporary file and renames it, so a scraper never reads a partial file
+    bool WriteSnapshotToFile(const std::string& path) const;
+    void Reset();
+
+private:
+    std::array<EntryPointMetrics, static_cast<size_t>(MetricsEntryPoint::COUNT)> entry_points_;
+};
+
+SearchServerMetrics& GetSearchServerMetrics();
+
+// Measures one call of an entry point. A call that leaves through an exception is counted as an error.
+// Scopes nested into a scope of the same entry point on the same thread (overloads delegating
+// to each other) are not counted twice, their counts go to the outermost scope.
+class MetricsScope {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit MetricsScope(MetricsEntryPoint entry_point);
+    ~MetricsScope();
+
+    MetricsScope(const MetricsScope&) = delete;
+    MetricsScope& operator=(const MetricsScope&) = delete;
+
+    // The outermost scope of the entry point open on the current thread, nullptr if there is none
+    static MetricsScope* GetActive(MetricsEntryPoint entry_point);
+
+    void AddDocumentsScored(uint64_t count) {
+        target_->documents_scored_ += count;
+    }
+
+    void AddPostingsTouched(uint64_t count) {
+        target_->postings_touched_ += count;
+    }
+
+private:
+    const MetricsEntryPoint entry_point_;
+    MetricsScope* const target_;
+    const int uncaught_exceptions_;
+    uint64_t documents_scored_ = 0;
+    uint64_t postings_touched_ = 0;
+    const Clock::time_point start_time_ = Clock::now();
+};
@@ -0,0 +1,197 @@
+#include "near_duplicates.h"
+#include "hash_utils.h"
+
+#include <algorithm>
+#include <execution>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+using namespace std::string_literals;
+
+NearDuplicateDetector::NearDuplicateDetector(NearDuplicateOptions options)
+    : options_(options)
+{
+    if (options_.band_count <= 0 || options_.rows_per_band <= 0) {
+        throw std::invalid_argument("MinHash signature must have at least one band and one row"s);
+    }
+    if (options_.jaccard_threshold < 0.0 || options_.jaccard_threshold > 1.0) {
+        throw std::invalid_argument("Jaccard threshold must be in [0, 1]"s);
+    }
+    const int signature_size = options_.band_count * options_.rows_per_band;
+    seeds_.reserve(signature_size);
+    for (int i = 0; i < signature_size; ++i) {
+        seeds_.push_back(MixHash(0x5851f42d4c957f2dull + i));
+    }
+    band_buckets_.resize(options_.band_count);
+}
+
+void NearDuplicateDetector::Update(const SearchServer& search_server) {
+    // Both id sequences are sorted, so one merge pass finds removed and new documents
+    std::vector<int> removed_ids;
+    std::vector<int> new_ids;
+    auto known = signatures_.begin();
+    for (const int document_id : search_server) {
+        while (known != signatures_.end() && known->first < document_id) {
+            removed_ids.push_back((known++)->first);
+        }
+        if (known != signatures_.end() && known->first == document_id) {
+            ++known;
+        }
+        else if (!search_server.GetDocumentTermIds(document_id).empty()) {
+            new_ids.push_back(document_id);
+        }
+    }
+    for (; known != signatures_.end(); ++known) {
+        removed_ids.push_back(known->first);
+    }
+    for (const int document_id : removed_ids) {
+        RemoveDocument(document_id);
+    }
+
+    std::vector<Signature> new_signatures(new_ids.size());
+    std::transform(std::execution::par,
+        new_ids.begin(), new_ids.end(),
+        new_signatures.begin(),
+        [this, &search_server](int document_id) { return ComputeSignature(search_server.GetWordFrequencies(document_id)); });
+
+    for (size_t i = 0; i < new_ids.size(); ++i) {
+        InsertSignature(new_ids[i], std::move(new_signatures[i]));
+    }
+}
+
+void NearDuplicateDetector::AddDocument(int document_id, const SearchServer::WordFrequencies& word_freqs) {
+    if (word_freqs.empty()) {
+        return;
+    }
+    RemoveDocument(document_id);
+    InsertSignature(document_id, ComputeSignature(word_freqs));
+}
+
+void NearDuplicateDetector::RemoveDocument(int document_id) {
+    const auto it = signatures_.find(document_id);
+    if (it == signatures_.end()) {
+        return;
+    }
+    for (int band = 0; band < options_.band_count; ++band) {
+        auto bucket = band_buckets_[band].find(ComputeBandKey(it->second, band));
+        auto& ids = bucket->second;
+        ids.erase(std::find(ids.begin(), ids.end(), document_id));
+        if (ids.empty()) {
+            band_buckets_[band].erase(bucket);
+        }
+    }
+    signatures_.erase(it);
+}
+
+std::vector<std::vector<int>> NearDuplicateDetector::FindClusters() const {
+    std::vector<const std::vector<int>*> buckets;
+    for (const auto& band : band_buckets_) {
+        for (const auto& [_, ids] : band) {
+            if (ids.size() > 1) {
+                buckets.push_back(&ids);
+            }
+        }
+    }
+
+    // Candidate pairs from every bucket are verified against the full signatures in parallel
+    std::vector<std::vector<std::pair<int, int>>> similar_pairs(buckets.size());
+    std::transform(std::execution::par,
+        buckets.begin(), buckets.end(),
+        similar_pairs.begin(),
+        [this](const std::vector<int>* ids) {
+            std::vector<std::pair<int, int>> pairs;
+            for (size_t i = 0; i < ids->size(); ++i) {
+                const Signature& lhs = signatures_.at((*ids)[i]);
+                for (size_t j = i + 1; j < ids->size(); ++j) {
+                    if (CompareSignatures(lhs, signatures_.at((*ids)[j])) >= options_.jaccard_threshold) {
+                        pairs.emplace_back((*ids)[i], (*ids)[j]);
+                    }
+                }
+            }
+            return pairs;
+        });
+
+    std::map<int, int> parent;
+    const auto find_root = [&parent](int id) {
+        int root = id;
+        while (parent.at(root) != root) {
+            root = parent.at(root);
+        }
+        while (parent.at(id) != root) {
+            id = std::exchange(parent.at(id), root);
+        }
+        return root;
+    };
+    for (const auto& pairs : similar_pairs) {
+        for (const auto& [lhs, rhs] : pairs) {
+            parent.emplace(lhs, lhs);
+            parent.emplace(rhs, rhs);
+            const int lhs_root = find_root(lhs);
+            const int rhs_root = find_root(rhs);
+            if (lhs_root != rhs_root) {
+                parent[std::max(lhs_root, rhs_root)] = std::min(lhs_root, rhs_root);
+            }
+        }
+    }
+
+    std::map<int, std::vector<int>> clusters;
+    for (const auto& [id, _] : parent) {
+        clusters[find_root(id)].push_back(id);
+    }
+
+    std::vector<std::vector<int>> result;
+    result.reserve(clusters.size());
+    for (auto& [_, ids] : clusters) {
+        result.push_back(std::move(ids));
+    }
+    return result;
+}
+
+double NearDuplicateDetector::EstimateSimilarity(int lhs_document_id, int rhs_document_id) const {
+    const auto lhs = signatures_.find(lhs_document_id);
+    const auto rhs = signatures_.find(rhs_document_id);
+    if (lhs == signatures_.end() || rhs == signatures_.end()) {
+        return 0.0;
+    }
+    return CompareSignatures(lhs->second, rhs->second);
+}
+
+int NearDuplicateDetector::GetDocumentCount() const {
+    return signatures_.size();
+}
+
+NearDuplicateDetector::Signature NearDuplicateDetector::ComputeSignature(const SearchServer::WordFrequencies& word_freqs) const {
+    Signature signature(seeds_.size(), std::numeric_limits<uint64_t>::max());
+    for (const auto& [word, _] : word_freqs) {
+        const uint64_t word_hash = HashString(word);
+        for (size_t i = 0; i < seeds_.size(); ++i) {
+            signature[i] = std::min(signature[i], MixHash(word_hash ^ seeds_[i]));
+        }
+    }
+    return signature;
+}
+
+uint64_t NearDuplicateDetector::ComputeBandKey(const Signature& signature, int band) const {
+    uint64_t key = MixHash(band);
+    for (int row = 0; row < options_.rows_per_band; ++row) {
+        key = MixHash(key ^ signature[band * options_.rows_per_band + row]);
+    }
+    return key;
+}
+
+void NearDuplicateDetector::InsertSignature(int document_id, Signature signature) {
+    for (int band = 0; band < options_.band_count; ++band) {
+        band_buckets_[band][ComputeBandKey(signature, band)].push_back(document_id);
+    }
+    signatures_[document_id] = std::move(signature);
+}
+
+double NearDuplicateDetector::CompareSignatures(const Signature& lhs, const Signature& rhs) {
+    size_t equal_count = 0;
+    for (size_t i = 0; i < lhs.size(); ++i) {
+        equal_count += lhs[i] == rhs[i];
+    }
+    return equal_count * 1.0 / lhs.size();
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "search_server.h"
+
+struct NearDuplicateOptions {
+    // Signature length is band_count * rows_per_band MinHash values.
+    // More rows per band make a bucket collision require a higher similarity.
+    int band_count = 16;
+    int rows_per_band = 4;
+    double jaccard_threshold = 0.8;
+};
+
+// Near-duplicate detection with MinHash signatures of document word sets and LSH banding.
+// Signatures are kept between calls, so the detector can follow a growing index incrementally.
+class NearDuplicateDetector {
+public:
+    explicit NearDuplicateDetector(NearDuplicateOptions options = NearDuplicateOptions());
+
+    // Computes signatures of documents added to the server since the last call (in parallel)
+    // and forgets documents that were removed from it
+    void Update(const SearchServer& search_server);
+
+    void AddDocument(int document_id, const SearchServer::WordFrequencies& word_freqs);
+    void RemoveDocument(int document_id);
+
+    // Groups of documents whose estimated Jaccard similarity reaches the threshold.
+    // Every group is sorted by id and contains at least two documents.
+    std::vector<std::vector<int>> FindClusters() const;
+
+    double EstimateSimilarity(int lhs_document_id, int rhs_document_id) const;
+    int GetDocumentCount() const;
+
+private:
+    using Signature = std::vector<uint64_t>;
+
+    NearDuplicateOptions options_;
+    std::vector<uint64_t> seeds_;
+    std::map<int, Signature> signatures_;
+    std::vector<std::unordered_map<uint64_t, std::vector<int>>> band_buckets_;
+
+    Signature ComputeSignature(const SearchServer::WordFrequencies& word_freqs) const;
+    uint64_t ComputeBandKey(const Signature& signature, int band) const;
+    void InsertSignature(int document_id, Signature signature);
+    static double CompareSignatures(const Signature& lhs, const Signature& rhs);
+};
@@ -0,0 +1,284 @@
+#include "metrics.h"
+#include "query_client.h"
+#include "query_server.h"
+#include "search_server.h"
+#include "workload.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Closed-loop load over TCP: every connection keeps --pipeline requests in flight and sends the
+// next one as soon as a response arrives. The kind of request is drawn from the configured mix,
+// the latency is measured from sending a request to receiving its response:
+//   net_load_client --host=127.0.0.1 --port=7700 --connections=16 --pipeline=4 --seconds=10
+// With --port=0 the client starts a server in process on the generated corpus first.
+enum class Operation {
+    FIND,
+    MATCH,
+    ADD,
+    REMOVE,
+    COUNT,
+};
+
+const size_t OPERATION_COUNT = static_cast<size_t>(Operation::COUNT);
+const array<const char*, OPERATION_COUNT> OPERATION_NAMES = { "find_top_documents", "match_document", "add_document", "remove_document" };
+
+struct ClientOptions {
+    WorkloadOptions workload;
+    string host = "127.0.0.1"s;
+    int port = 0;
+    int connections = 4;
+    int pipeline = 4;
+    size_t io_threads = 2;
+    double seconds = 5;
+    // Weights of FindTopDocuments, MatchDocument, AddDocument and RemoveDocument requests
+    array<double, OPERATION_COUNT> mix = { 90, 5, 3, 2 };
+};
+
+array<double, OPERATION_COUNT> ParseMix(const string& text) {
+    array<double, OPERATION_COUNT> mix = {};
+    size_t position = 0;
+    for (double& weight : mix) {
+        const size_t comma = text.find(',', position);
+        weight = stod(text.substr(position, comma - position));
+        if (comma == string::npos) {
+            break;
+        }
+        position = comma + 1;
+    }
+    return mix;
+}
+
+ClientOptions ParseOptions(int argc, char* argv[]) {
+    ClientOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const string argument = argv[i];
+        const size_t equal = argument.find('=');
+        if (argument.rfind("--"s, 0) != 0 || equal == string::npos) {
+            throw invalid_argument("Expected --name=value, got "s + argument);
+        }
+        const string name = argument.substr(2, equal - 2);
+        const string value = argument.substr(equal + 1);
+        if (name == "host"s) {
+            options.host = value;
+        }
+        else if (name == "port"s) {
+            options.port = stoi(value);
+        }
+        else if (name == "connections"s) {
+            options.connections = max(1, stoi(value));
+        }
+        else if (name == "pipeline"s) {
+            options.pipeline = max(1, stoi(value));
+        }
+        else if (name == "io-threads"s) {
+            options.io_threads = max(1, stoi(value));
+        }
+        else if (name == "seconds"s) {
+            options.seconds = stod(value);
+        }
+        else if (name == "mix"s) {
+            options.mix = ParseMix(value);
+        }
+        else if (name == "vocabulary"s) {
+            options.workload.vocabulary = stoi(value);
+        }
+        else if (name == "word-exponent"s) {
+            options.workload.word_exponent = stod(value);
+        }
+        else if (name == "documents"s) {
+            options.workload.documents = stoi(value);
+        }
+        else if (name == "max-document-words"s) {
+            options.workload.max_document_words = stoi(value);
+        }
+        else if (name == "queries"s) {
+            options.workload.queries = stoi(value);
+        }
+        else if (name == "minus-prob"s) {
+            options.workload.minus_prob = stod(value);
+        }
+        else if (name == "seed"s) {
+            options.workload.seed = stoi(value);
+        }
+        else {
+            throw invalid_argument("Unknown option "s + name);
+        }
+    }
+    return options;
+}
+
+// Documents of the remote index are not known here: MatchDocument and RemoveDocument pick ids of
+// the generated corpus and count an error when the document is gone, as the server reports it.
+class NetLoadClient {
+public:
+    NetLoadClient(const ClientOptions& options, const Workload& workload, uint16_t port)
+        : options_(options)
+        , workload_(workload)
+        , port_(port)
+        , next_id_(static_cast<int>(workload.documents.size())) {
+    }
+
+    void Run() {
+        const auto deadline = chrono::steady_clock::now() + chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(options_.seconds));
+        const auto start = chrono::steady_clock::now();
+        vector<thread> threads;
+        for (int c = 0; c < options_.connections; ++c) {
+            threads.emplace_back([this, c, deadline]() {
+                try {
+                    RunConnection(options_.workload.seed + c + 1, deadline);
+                }
+                catch (const exception& e) {
+                    cerr << "Connection error: "s << e.what() << endl;
+                    connection_errors_.fetch_add(1);
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        elapsed_seconds_ = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+
+    void PrintReport(ostream& output) const {
+        uint64_t total = 0;
+        for (size_t i = 0; i < OPERATION_COUNT; ++i) {
+            const HdrHistogram& latency = latency_ns_[i];
+            total += latency.GetCount();
+            output << "{\"operation\":\""s << OPERATION_NAMES[i] << "\""s
+                << ",\"connections\":"s << options_.connections
+                << ",\"pipeline\":"s << options_.pipeline
+                << ",\"operations\":"s << latency.GetCount()
+                << ",\"errors\":"s << errors_[i].load()
+                << ",\"throughput_ops\":"s << latency.GetCount() / elapsed_seconds_
+                << ",\"mean_ns\":"s << (latency.GetCount() ? latency.GetSum() / latency.GetCount() : 0)
+                << ",\"p50_ns\":"s << latency.GetValueAtQuantile(0.5)
+                << ",\"p99_ns\":"s << latency.GetValueAtQuantile(0.99)
+                << ",\"p999_ns\":"s << latency.GetValueAtQuantile(0.999)
+                << "}"s << endl;
+        }
+        output << "{\"operation\":\"total\",\"connections\":"s << options_.connections
+            << ",\"pipeline\":"s << options_.pipeline
+            << ",\"operations\":"s << total
+            << ",\"seconds\":"s << elapsed_seconds_
+            << ",\"throughput_ops\":"s << total / elapsed_seconds_
+            << "}"s << endl;
+    }
+
+    bool HasConnectionErrors() const {
+        return connection_errors_.load() > 0;
+    }
+
+private:
+    struct PendingRequest {
+        uint32_t request_id;
+        Operation operation;
+        chrono::steady_clock::time_point start;
+    };
+
+    const ClientOptions& options_;
+    const Workload& workload_;
+    const uint16_t port_;
+    atomic<int> next_id_;
+    array<HdrHistogram, OPERATION_COUNT> latency_ns_;
+    array<atomic<uint64_t>, OPERATION_COUNT> errors_ = {};
+    atomic<int> connection_errors_{ 0 };
+    double elapsed_seconds_ = 0;
+
+    void RunConnection(int seed, chrono::steady_clock::time_point deadline) {
+        QueryClient client(options_.host, port_);
+        mt19937 generator(seed);
+        discrete_distribution<int> operations(options_.mix.begin(), options_.mix.end());
+        vector<PendingRequest> pending;
+        while (true) {
+            const bool is_running = chrono::steady_clock::now() < deadline;
+            if (is_running) {
+                while (pending.size() < static_cast<size_t>(options_.pipeline)) {
+                    const auto operation = static_cast<Operation>(operations(generator));
+                    const uint32_t request_id = Send(client, operation, generator);
+                    pending.push_back({ request_id, operation, chrono::steady_clock::now() });
+                }
+            }
+            else if (pending.empty()) {
+                return;
+            }
+            const QueryResponse response = client.ReceiveResponse();
+            const auto now = chrono::steady_clock::now();
+            const auto request = find_if(pending.begin(), pending.end(), [&response](const PendingRequest& pending_request) {
+                return pending_request.request_id == response.request_id;
+            });
+            const size_t operation = static_cast<size_t>(request->operation);
+            if (response.status == ResponseStatus::ERROR) {
+                errors_[operation].fetch_add(1, memory_order_relaxed);
+            }
+            latency_ns_[operation].Record(chrono::duration_cast<chrono::nanoseconds>(now - request->start).count());
+            *request = pending.back();
+            pending.pop_back();
+        }
+    }
+
+    uint32_t Send(QueryClient& client, Operation operation, mt19937& generator) {
+        const auto random_index = [&generator](size_t size) {
+            return uniform_int_distribution<size_t>(0, size - 1)(generator);
+        };
+        switch (operation) {
+        case Operation::MATCH:
+            return client.SendMatchDocument(workload_.queries[random_index(workload_.queries.size())],
+                static_cast<int>(random_index(workload_.documents.size())));
+        case Operation::ADD:
+            return client.SendAddDocument(next_id_.fetch_add(1, memory_order_relaxed),
+                workload_.documents[random_index(workload_.documents.size())], DocumentStatus::ACTUAL, { 1 });
+        case Operation::REMOVE:
+            return client.SendRemoveDocument(static_cast<int>(random_index(workload_.documents.size())));
+        default:
+            return client.SendFindTopDocuments(workload_.queries[random_index(workload_.queries.size())]);
+        }
+    }
+};
+
+int main(int argc, char* argv[]) {
+    try {
+        const ClientOptions options = ParseOptions(argc, argv);
+        const Workload workload = GenerateWorkload(options.workload);
+
+        unique_ptr<SearchServer> search_server;
+        unique_ptr<QueryServer> server;
+        uint16_t port = static_cast<uint16_t>(options.port);
+        if (port == 0) {
+            search_server = make_unique<SearchServer>("and in on the"s);
+            for (size_t i = 0; i < workload.documents.size(); ++i) {
+                search_server->AddDocument(static_cast<int>(i), workload.documents[i], DocumentStatus::ACTUAL, { 1 });
+            }
+            QueryServerOptions server_options;
+            server_options.address = options.host;
+            server_options.io_thread_count = options.io_threads;
+            server = make_unique<QueryServer>(*search_server, server_options);
+            server->Start();
+            port = server->GetPort();
+        }
+
+        NetLoadClient client(options, workload, port);
+        client.Run();
+        client.PrintReport(cout);
+        if (client.HasConnectionErrors()) {
+            return EXIT_FAILURE;
+        }
+    }
+    catch (const exception& e) {
+        cerr << "Net load client error: "s << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
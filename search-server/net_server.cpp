@@ -0,0 +1,171 @@
+#include "query_server.h"
+#include "replication.h"
+#include "search_server.h"
+#include "workload.h"
+
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+
+// Serves a SearchServer over TCP until SIGINT or SIGTERM:
+//   net_server --address=0.0.0.0 --port=7700 --io-threads=2 --threads=8 --documents=10000
+// With --documents the index starts with a generated Zipf corpus, otherwise it is empty.
+// Replicas: a leader ships its writes to followers, which serve reads of their own copy:
+//   net_server --role=leader --port=7700 --replication-port=7701 --documents=10000
+//   net_server --role=follower --port=7710 --leader=127.0.0.1:7701
+enum class ServerRole {
+    STANDALONE,
+    LEADER,
+    FOLLOWER,
+};
+
+struct NetServerOptions {
+    QueryServerOptions server;
+    ServerRole role = ServerRole::STANDALONE;
+    ReplicationOptions replication;
+    string leader_host = "127.0.0.1"s;
+    uint16_t leader_port = 7701;
+    WorkloadOptions workload;
+    // 0 keeps the default executor
+    size_t threads = 0;
+    string stop_words = "and in on the"s;
+};
+
+NetServerOptions ParseOptions(int argc, char* argv[]) {
+    NetServerOptions options;
+    options.server.port = 7700;
+    options.workload.documents = 0;
+    options.replication.port = 7701;
+    for (int i = 1; i < argc; ++i) {
+        const string argument = argv[i];
+        const size_t equal = argument.find('=');
+        if (argument.rfind("--"s, 0) != 0 || equal == string::npos) {
+            throw invalid_argument("Expected --name=value, got "s + argument);
+        }
+        const string name = argument.substr(2, equal - 2);
+        const string value = argument.substr(equal + 1);
+        if (name == "address"s) {
+            options.server.address = value;
+        }
+        else if (name == "port"s) {
+            options.server.port = static_cast<uint16_t>(stoi(value));
+        }
+        else if (name == "io-threads"s) {
+            options.server.io_thread_count = max(1, stoi(value));
+        }
+        else if (name == "threads"s) {
+            options.threads = max(0, stoi(value));
+        }
+        else if (name == "role"s) {
+            if (value == "standalone"s) {
+                options.role = ServerRole::STANDALONE;
+            }
+            else if (value == "leader"s) {
+                options.role = ServerRole::LEADER;
+            }
+            else if (value == "follower"s) {
+                options.role = ServerRole::FOLLOWER;
+            }
+            else {
+                throw invalid_argument("Unknown role "s + value);
+            }
+        }
+        else if (name == "replication-port"s) {
+            options.replication.port = static_cast<uint16_t>(stoi(value));
+        }
+        else if (name == "max-log-size"s) {
+            options.replication.max_log_size = stoul(value);
+        }
+        else if (name == "leader"s) {
+            const size_t colon = value.rfind(':');
+            if (colon == string::npos) {
+                throw invalid_argument("Expected --leader=host:port, got "s + value);
+            }
+            options.leader_host = value.substr(0, colon);
+            options.leader_port = static_cast<uint16_t>(stoi(value.substr(colon + 1)));
+        }
+        else if (name == "stop-words"s) {
+            options.stop_words = value;
+        }
+        else if (name == "documents"s) {
+            options.workload.documents = stoi(value);
+        }
+        else if (name == "vocabulary"s) {
+            options.workload.vocabulary = stoi(value);
+        }
+        else if (name == "max-document-words"s) {
+            options.workload.max_document_words = stoi(value);
+        }
+        else if (name == "seed"s) {
+            options.workload.seed = stoi(value);
+        }
+        else {
+            throw invalid_argument("Unknown option "s + name);
+        }
+    }
+    options.replication.address = options.server.address;
+    return options;
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        const NetServerOptions options = ParseOptions(argc, argv);
+        // Signals are taken by sigwait, blocked before any thread starts
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+        SearchServer search_server(options.stop_words);
+        if (options.threads > 0) {
+            search_server.SetParallelism(options.threads);
+        }
+        ReplicationLeader leader(search_server, options.replication);
+        ReplicationFollower follower(search_server, options.leader_host, options.leader_port);
+        // A follower receives the corpus from its leader
+        if (options.workload.documents > 0 && options.role != ServerRole::FOLLOWER) {
+            const Workload workload = GenerateWorkload(options.workload);
+            for (size_t i = 0; i < workload.documents.size(); ++i) {
+                if (options.role == ServerRole::LEADER) {
+                    leader.AddDocument(static_cast<int>(i), workload.documents[i], DocumentStatus::ACTUAL, { 1 });
+                }
+                else {
+                    search_server.AddDocument(static_cast<int>(i), workload.documents[i], DocumentStatus::ACTUAL, { 1 });
+                }
+            }
+        }
+
+        unique_ptr<QueryServer> server;
+        if (options.role == ServerRole::LEADER) {
+            leader.Start();
+            cout << "Replicating on "s << options.replication.address << ":"s << leader.GetPort() << endl;
+            server = make_unique<QueryServer>(leader, options.server);
+        }
+        else if (options.role == ServerRole::FOLLOWER) {
+            follower.Start();
+            server = make_unique<QueryServer>(follower, options.server);
+        }
+        else {
+            server = make_unique<QueryServer>(search_server, options.server);
+        }
+        server->Start();
+        cout << "Listening on "s << options.server.address << ":"s << server->GetPort()
+            << ", documents: "s << search_server.GetDocumentCount() << endl;
+        int signal = 0;
+        sigwait(&signals, &signal);
+        server->Stop();
+        follower.Stop();
+        leader.Stop();
+    }
+    catch (const exception& e) {
+        cerr << "Net server error: "s << e.what() << endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,54 @@
+#include "positional_index.h"
+
+#include <algorithm>
+
+DocumentPositions::DocumentPositions(const std::vector<std::vector<uint32_t>>& term_positions) {
+    offsets_.reserve(term_positions.size() + 1);
+    for (const auto& positions : term_positions) {
+        offsets_.push_back(static_cast<uint32_t>(data_.size()));
+        uint32_t previous = 0;
+        for (const uint32_t position : positions) {
+            AppendVarint(data_, position - previous);
+            previous = position;
+        }
+    }
+    offsets_.push_back(static_cast<uint32_t>(data_.size()));
+    data_.shrink_to_fit();
+}
+
+void DocumentPositions::Decode(size_t term_index, std::vector<uint32_t>& positions) const {
+    positions.clear();
+    const uint8_t* input = data_.data() + offsets_[term_index];
+    const uint8_t* const end = data_.data() + offsets_[term_index + 1];
+    uint32_t position = 0;
+    while (input < end) {
+        position += ReadVarint(input);
+        positions.push_back(position);
+    }
+}
+
+bool ContainsPhrase(const std::vector<std::vector<uint32_t>>& word_positions) {
+    if (word_positions.empty()) {
+        return true;
+    }
+    size_t shortest = 0;
+    for (size_t i = 1; i < word_positions.size(); ++i) {
+        if (word_positions[i].size() < word_positions[shortest].size()) {
+            shortest = i;
+        }
+    }
+    for (const uint32_t anchor : word_positions[shortest]) {
+        if (anchor < shortest) {
+            continue;
+        }
+        const uint32_t start = anchor - static_cast<uint32_t>(shortest);
+        bool matched = true;
+        for (size_t i = 0; i < word_positions.size() && matched; ++i) {
+            matched = std::binary_search(word_positions[i].begin(), word_positions[i].end(), start + static_cast<uint32_t>(i));
+        }
+        if (matched) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "varint.h"
+
+// Word positions of one document for the positional index. Positions count the words
+// of the document without stop words. Every list is stored as varint-encoded gaps
+// in one shared buffer; list i belongs to the i-th term id of the document.
+class DocumentPositions {
+public:
+    DocumentPositions() = default;
+    // term_positions[i] holds the ascending positions of the i-th term
+    explicit DocumentPositions(const std::vector<std::vector<uint32_t>>& term_positions);
+
+    // Replaces the content of positions with the list of the given term
+    void Decode(size_t term_index, std::vector<uint32_t>& positions) const;
+
+    bool IsEmpty() const {
+        return offsets_.empty();
+    }
+
+    size_t GetEncodedSize() const {
+        return data_.size();
+    }
+
+    const std::vector<uint32_t>& GetOffsets() const {
+        return offsets_;
+    }
+
+    const std::vector<uint8_t>& GetData() const {
+        return data_;
+    }
+
+private:
+    // offsets_[i] is the start of list i in data_, the last element is the end of data_
+    std::vector<uint32_t> offsets_;
+    std::vector<uint8_t> data_;
+};
+
+// True if the lists contain positions p, p + 1, ..., p + n - 1, the k-th one in the k-th list.
+// Lists are intersected starting from the shortest one.
+bool ContainsPhrase(const std::vector<std::vector<uint32_t>>& word_positions);
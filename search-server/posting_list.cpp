@@ -0,0 +1,237 @@
+#include "posting_list.h"
+
+#include <array>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define POSTING_LIST_SSSE3
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Writes count values, count is padded with zeros to a multiple of four
+void AppendGroupVarint(std::pmr::vector<uint8_t>& output, const uint32_t* values, size_t count) {
+    for (size_t group = 0; group < count; group += 4) {
+        const size_t control_index = output.size();
+        output.push_back(0);
+        uint8_t control = 0;
+        for (size_t i = 0; i < 4; ++i) {
+            const uint32_t value = group + i < count ? values[group + i] : 0;
+            const int length = value < (1u << 8) ? 1 : value < (1u << 16) ? 2 : value < (1u << 24) ? 3 : 4;
+            control |= static_cast<uint8_t>((length - 1) << (2 * i));
+            for (int byte = 0; byte < length; ++byte) {
+                output.push_back(static_cast<uint8_t>(value >> (8 * byte)));
+            }
+        }
+        output[control_index] = control;
+    }
+}
+
+const uint8_t* DecodeGroupScalar(const uint8_t* input, uint32_t* output) {
+    const uint8_t control = *input++;
+    for (int i = 0; i < 4; ++i) {
+        const int length = ((control >> (2 * i)) & 3) + 1;
+        uint32_t value = 0;
+        for (int byte = 0; byte < length; ++byte) {
+            value |= static_cast<uint32_t>(input[byte]) << (8 * byte);
+        }
+        output[i] = value;
+        input += length;
+    }
+    return input;
+}
+
+#ifdef POSTING_LIST_SSSE3
+
+// For every control byte: the shuffle that spreads the value bytes into four 32-bit lanes
+// and the byte length of the group without the control byte
+struct GroupVarintTables {
+    std::array<std::array<uint8_t, 16>, 256> shuffles;
+    std::array<uint8_t, 256> lengths;
+
+    GroupVarintTables() {
+        for (int control = 0; control < 256; ++control) {
+            uint8_t source = 0;
+            for (int i = 0; i < 4; ++i) {
+                const int length = ((control >> (2 * i)) & 3) + 1;
+                for (int byte = 0; byte < 4; ++byte) {
+                    // A set high bit makes the shuffle write a zero
+                    shuffles[control][4 * i + byte] = byte < length ? source++ : 0x80;
+                }
+            }
+            lengths[control] = source;
+        }
+    }
+};
+
+const GroupVarintTables& GetGroupVarintTables() {
+    static const GroupVarintTables tables;
+    return tables;
+}
+
+// Decodes group_count groups; a group is loaded with one 16 byte read while that stays inside the buffer
+__attribute__((target("ssse3")))
+const uint8_t* DecodeGroupsSsse3(const uint8_t* input, const uint8_t* buffer_end, size_t group_count, uint32_t* output) {
+    const GroupVarintTables& tables = GetGroupVarintTables();
+    size_t group = 0;
+    for (; group < group_count && input + 17 <= buffer_end; ++group) {
+        const uint8_t control = *input;
+        const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + 1));
+        const __m128i shuffle = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tables.shuffles[control].data()));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + 4 * group), _mm_shuffle_epi8(data, shuffle));
+        input += 1 + tables.lengths[control];
+    }
+    for (; group < group_count; ++group) {
+        input = DecodeGroupScalar(input, output + 4 * group);
+    }
+    return input;
+}
+
+bool HasSsse3() {
+    static const bool has_ssse3 = __builtin_cpu_supports("ssse3");
+    return has_ssse3;
+}
+
+#endif
+
+const uint8_t* DecodeGroups(const uint8_t* input, const uint8_t* buffer_end, size_t group_count, uint32_t* output) {
+#ifdef POSTING_LIST_SSSE3
+    if (HasSsse3()) {
+        return DecodeGroupsSsse3(input, buffer_end, group_count, output);
+    }
+#endif
+    for (size_t group = 0; group < group_count; ++group) {
+        input = DecodeGroupScalar(input, output + 4 * group);
+    }
+    return input;
+}
+
+void AddVectorAllocation(StructureMemoryUsage& usage, size_t bytes) {
+    if (bytes > 0) {
+        usage.AddAllocations(1, bytes);
+    }
+}
+
+}
+
+void PostingList::Add(int document_id, uint32_t occurrences) {
+    if (pending_.empty() || pending_.back().first < document_id) {
+        pending_.emplace_back(document_id, occurrences);
+    }
+    else {
+        const auto it = std::lower_bound(pending_.begin(), pending_.end(), document_id,
+            [](const std::pair<int, uint32_t>& posting, int id) { return posting.first < id; });
+        pending_.emplace(it, document_id, occurrences);
+    }
+    ++size_;
+
+    // Ids usually come in ascending order, then a full block is just appended
+    if (pending_.size() >= BLOCK_SIZE && (blocks_.empty() || pending_.front().first > blocks_.back().last_id)) {
+        AppendBlock(pending_.data(), BLOCK_SIZE);
+        pending_.erase(pending_.begin(), pending_.begin() + BLOCK_SIZE);
+    }
+    else if (pending_.size() + erased_.size() > GetAsideLimit()) {
+        Rebuild();
+    }
+}
+
+bool PostingList::Erase(int document_id) {
+    const auto pending_it = std::lower_bound(pending_.begin(), pending_.end(), document_id,
+        [](const std::pair<int, uint32_t>& posting, int id) { return posting.first < id; });
+    if (pending_it != pending_.end() && pending_it->first == document_id) {
+        pending_.erase(pending_it);
+        --size_;
+        return true;
+    }
+
+    const size_t block_index = std::lower_bound(blocks_.begin(), blocks_.end(), document_id,
+        [](const SkipEntry& block, int id) { return block.last_id < id; }) - blocks_.begin();
+    if (block_index == blocks_.size() || blocks_[block_index].first_id > document_id) {
+        return false;
+    }
+    int ids[BLOCK_SIZE + 3];
+    uint32_t occurrences[BLOCK_SIZE + 3];
+    const size_t count = DecodeBlock(block_index, ids, occurrences);
+    if (!std::binary_search(ids, ids + count, document_id)) {
+        return false;
+    }
+    const auto erased_it = std::lower_bound(erased_.begin(), erased_.end(), document_id);
+    if (erased_it != erased_.end() && *erased_it == document_id) {
+        return false;
+    }
+    erased_.insert(erased_it, document_id);
+    --size_;
+
+    if (pending_.size() + erased_.size() > GetAsideLimit()) {
+        Rebuild();
+    }
+    return true;
+}
+
+StructureMemoryUsage PostingList::GetHeapUsage() const {
+    StructureMemoryUsage usage;
+    usage.node_count = size_;
+    AddVectorAllocation(usage, blocks_.capacity() * sizeof(SkipEntry));
+    AddVectorAllocation(usage, data_.capacity());
+    AddVectorAllocation(usage, pending_.capacity() * sizeof(std::pair<int, uint32_t>));
+    AddVectorAllocation(usage, erased_.capacity() * sizeof(int));
+    return usage;
+}
+
+size_t PostingList::DecodeBlock(size_t block_index, int* ids, uint32_t* occurrences) const {
+    const SkipEntry& block = blocks_[block_index];
+    const size_t group_count = (block.count + 3) / 4;
+    const uint8_t* const buffer_end = data_.data() + data_.size();
+    const uint8_t* input = data_.data() + block.offset;
+
+    uint32_t* const deltas = reinterpret_cast<uint32_t*>(ids);
+    input = DecodeGroups(input, buffer_end, group_count, deltas);
+    DecodeGroups(input, buffer_end, group_count, occurrences);
+
+    uint32_t id = static_cast<uint32_t>(block.first_id);
+    for (size_t i = 0; i < block.count; ++i) {
+        id += deltas[i];
+        ids[i] = static_cast<int>(id);
+    }
+    return block.count;
+}
+
+void PostingList::AppendBlock(const std::pair<int, uint32_t>* postings, size_t count) {
+    uint32_t deltas[BLOCK_SIZE];
+    uint32_t occurrences[BLOCK_SIZE];
+    int previous = postings[0].first;
+    for (size_t i = 0; i < count; ++i) {
+        deltas[i] = static_cast<uint32_t>(postings[i].first - previous);
+        occurrences[i] = postings[i].second;
+        previous = postings[i].first;
+    }
+
+    blocks_.push_back({ postings[0].first, postings[count - 1].first, static_cast<uint32_t>(data_.size()), static_cast<uint32_t>(count) });
+    AppendGroupVarint(data_, deltas, count);
+    AppendGroupVarint(data_, occurrences, count);
+}
+
+void PostingList::Rebuild() {
+    std::vector<std::pair<int, uint32_t>> postings;
+    postings.reserve(size_);
+    ForEach([&postings](int document_id, uint32_t occurrences) {
+        postings.emplace_back(document_id, occurrences);
+        return true;
+    });
+
+    blocks_.clear();
+    data_.clear();
+    pending_.clear();
+    erased_.clear();
+    for (size_t begin = 0; begin < postings.size(); begin += BLOCK_SIZE) {
+        AppendBlock(postings.data() + begin, std::min(BLOCK_SIZE, postings.size() - begin));
+    }
+    blocks_.shrink_to_fit();
+    data_.shrink_to_fit();
+    pending_.shrink_to_fit();
+    erased_.shrink_to_fit();
+}
+
+size_t PostingList::GetAsideLimit() const {
+    return std::max(BLOCK_SIZE, size_ / 8);
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+#include "memory_usage.h"
+
+// Postings of one word: document ids in ascending order, each with the number of occurrences
+// of the word in the document. Postings are kept in blocks of BLOCK_SIZE: ids as deltas, both
+// deltas and occurrences in group varint (a control byte with the byte lengths of four values,
+// then the values), decoded with SSSE3 shuffles where the processor has them. A skip entry per
+// block holds its first and last id, so a range scan decodes only the blocks it needs.
+// Postings added out of order and erased ones are kept aside until the blocks are rebuilt.
+// A posting takes about 2-3 bytes instead of a 48 byte map node. Buffers come from the memory
+// resource of the allocator, which a std::pmr container of lists passes on to its elements.
+class PostingList {
+public:
+    static constexpr size_t BLOCK_SIZE = 128;
+
+    using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+    PostingList() = default;
+    explicit PostingList(const allocator_type& allocator)
+        : blocks_(allocator)
+        , data_(allocator)
+        , pending_(allocator)
+        , erased_(allocator) {
+    }
+    PostingList(const PostingList& other, const allocator_type& allocator)
+        : blocks_(other.blocks_, allocator)
+        , data_(other.data_, allocator)
+        , pending_(other.pending_, allocator)
+        , erased_(other.erased_, allocator)
+        , size_(other.size_) {
+    }
+    PostingList(PostingList&& other, const allocator_type& allocator)
+        : blocks_(std::move(other.blocks_), allocator)
+        , data_(std::move(other.data_), allocator)
+        , pending_(std::move(other.pending_), allocator)
+        , erased_(std::move(other.erased_), allocator)
+        , size_(other.size_) {
+    }
+    PostingList(const PostingList&) = default;
+    PostingList(PostingList&&) = default;
+    PostingList& operator=(const PostingList&) = default;
+    PostingList& operator=(PostingList&&) = default;
+
+    // The id must not be in the list, occurrences must be positive
+    void Add(int document_id, uint32_t occurrences);
+    // False if the id is not in the list
+    bool Erase(int document_id);
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    // Calls function(document_id, occurrences) in ascending id order while it returns true.
+    // Returns false if the function stopped the scan.
+    template <typename Function>
+    bool ForEach(Function function) const {
+        return ForEachInRange(INT_MIN, INT_MAX, function);
+    }
+
+    // Same for the ids in [lower_id, upper_id], skipping the blocks outside
+    template <typename Function>
+    bool ForEachInRange(int lower_id, int upper_id, Function function) const;
+
+    // Allocations of the list, for SearchServer::GetMemoryUsage
+    StructureMemoryUsage GetHeapUsage() const;
+
+private:
+    struct SkipEntry {
+        int first_id;
+        int last_id;
+        uint32_t offset;
+        uint32_t count;
+    };
+
+    std::pmr::vector<SkipEntry> blocks_;
+    std::pmr::vector<uint8_t> data_;
+    // Not yet in a block, sorted by id
+    std::pmr::vector<std::pair<int, uint32_t>> pending_;
+    // Sorted ids erased from the blocks
+    std::pmr::vector<int> erased_;
+    size_t size_ = 0;
+
+    // Decodes a block into BLOCK_SIZE + 3 ids and occurrences, returns the posting count
+    size_t DecodeBlock(size_t block_index, int* ids, uint32_t* occurrences) const;
+    void AppendBlock(const std::pair<int, uint32_t>* postings, size_t count);
+    // Encodes all postings into fresh blocks
+    void Rebuild();
+    size_t GetAsideLimit() const;
+};
+
+template <typename Function>
+bool PostingList::ForEachInRange(int lower_id, int upper_id, Function function) const {
+    auto pending_it = std::lower_bound(pending_.begin(), pending_.end(), lower_id,
+        [](const std::pair<int, uint32_t>& posting, int id) { return posting.first < id; });
+    auto erased_it = std::lower_bound(erased_.begin(), erased_.end(), lower_id);
+    size_t block_index = std::lower_bound(blocks_.begin(), blocks_.end(), lower_id,
+        [](const SkipEntry& block, int id) { return block.last_id < id; }) - blocks_.begin();
+
+    int ids[BLOCK_SIZE + 3];
+    uint32_t occurrences[BLOCK_SIZE + 3];
+    for (; block_index < blocks_.size() && blocks_[block_index].first_id <= upper_id; ++block_index) {
+        const size_t count = DecodeBlock(block_index, ids, occurrences);
+        for (size_t i = 0; i < count && ids[i] <= upper_id; ++i) {
+            if (ids[i] < lower_id) {
+                continue;
+            }
+            for (; pending_it != pending_.end() && pending_it->first < ids[i]; ++pending_it) {
+                if (!function(pending_it->first, pending_it->second)) {
+                    return false;
+                }
+            }
+            while (erased_it != erased_.end() && *erased_it < ids[i]) {
+                ++erased_it;
+            }
+            if (erased_it != erased_.end() && *erased_it == ids[i]) {
+                continue;
+            }
+            if (!function(ids[i], occurrences[i])) {
+                return false;
+            }
+        }
+    }
+    for (; pending_it != pending_.end() && pending_it->first <= upper_id; ++pending_it) {
+        if (!function(pending_it->first, pending_it->second)) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -1,28 +1,70 @@
 #include "process_queries.h"
 
+namespace {
+
+std::vector<Document> FindTopDocuments(const SearchServer& search_server, const std::string_view query, QueryContext& query_context) {
+    search_server.PrepareQuery(query, query_context);
+    if (search_server.GetParallelismMode() == ParallelismMode::INTER_QUERY) {
+        return search_server.FindTopDocuments(query_context);
+    }
+    // The parallel path splits only the queries the mode allows to
+    return search_server.FindTopDocuments(std::execution::par, query_context);
+}
+
+// Each worker thread reuses its own parsed query buffers, so a batch does not allocate per query
+std::vector<Document> FindTopDocumentsReusingContext(const SearchServer& search_server, const std::string_view query) {
+    thread_local QueryContext query_context;
+    thread_local bool is_context_in_use = false;
+    if (is_context_in_use) {
+        // A thread waiting for the chunks of a split query runs other queries of the batch meanwhile
+        QueryContext nested_query_context;
+        return FindTopDocuments(search_server, query, nested_query_context);
+    }
+    is_context_in_use = true;
+    try {
+        auto documents = FindTopDocuments(search_server, query, query_context);
+        is_context_in_use = false;
+        return documents;
+    }
+    catch (...) {
+        is_context_in_use = false;
+        throw;
+    }
+}
+
+// Runs every query of the batch, in parallel unless the server splits each query instead
+void RunQueries(const SearchServer& search_server, const std::vector<std::string>& queries, std::vector<std::vector<Document>>& output) {
+    if (search_server.GetParallelismMode() == ParallelismMode::INTRA_QUERY) {
+        for (size_t i = 0; i < queries.size(); ++i) {
+            output[i] = FindTopDocumentsReusingContext(search_server, queries[i]);
+        }
+        return;
+    }
+    search_server.GetExecutor().ParallelFor(0, queries.size(), 1,
+        [&](size_t i) { output[i] = FindTopDocumentsReusingContext(search_server, queries[i]); });
+}
+
+}
+
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
-    const std::vector<std::string_view> queries) {
+    const std::vector<std::string>& queries) {
+    MetricsScope metrics(MetricsEntryPoint::PROCESS_QUERIES);
 
     std::vector <std::vector<Document>> output(queries.size(), std::vector<Document>());
 
-    std::transform(std::execution::par, queries.begin(), queries.end(),
-        output.begin(),
-        [&search_server](const auto query)
-        { return search_server.FindTopDocuments(query); });
+    RunQueries(search_server, queries, output);
     return output;
 }
 
 std::vector<Document> ProcessQueriesJoined(
     const SearchServer& search_server,
-    const std::vector<std::string_view>& queries) {
+    const std::vector<std::string>& queries) {
+    MetricsScope metrics(MetricsEntryPoint::PROCESS_QUERIES);
     std::vector <std::vector<Document>> input(queries.size(), std::vector<Document>());
     std::vector<Document> output;
 
-    std::transform(std::execution::par, queries.begin(), queries.end(),
-        input.begin(),
-        [&search_server](const auto query)
-        { return search_server.FindTopDocuments(query); });
+    RunQueries(search_server, queries, input);
 
     for (size_t i = 0; i < input.size(); ++i) {
         for (size_t j = 0; j < input[i].size(); ++j) {
@@ -0,0 +1,206 @@
+#include "query_client.h"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+#include <system_error>
+
+using namespace std::string_literals;
+
+namespace {
+
+std::system_error MakeSystemError(const std::string& what) {
+    return std::system_error(errno, std::generic_category(), what);
+}
+
+}
+
+QueryClient::QueryClient(const std::string& host, uint16_t port) {
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0 || addresses == nullptr) {
+        throw std::invalid_argument("Unknown host "s + host);
+    }
+    fd_ = socket(addresses->ai_family, addresses->ai_socktype | SOCK_CLOEXEC, addresses->ai_protocol);
+    if (fd_ < 0 || connect(fd_, addresses->ai_addr, addresses->ai_addrlen) < 0) {
+        const auto error = MakeSystemError("connect "s + host + ":"s + std::to_string(port));
+        freeaddrinfo(addresses);
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+        throw error;
+    }
+    freeaddrinfo(addresses);
+    const int enable = 1;
+    setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+}
+
+QueryClient::~QueryClient() {
+    close(fd_);
+}
+
+uint32_t QueryClient::SendFindTopDocuments(std::string_view raw_query, DocumentStatus status) {
+    const uint32_t request_id = next_request_id_++;
+    const size_t frame_begin = BeginRequest(RequestType::FIND_TOP_DOCUMENTS, request_id);
+    WireWriter writer(output_);
+    writer.WriteU8(static_cast<uint8_t>(status));
+    writer.WriteString(raw_query);
+    return FinishRequest(frame_begin, RequestType::FIND_TOP_DOCUMENTS, request_id);
+}
+
+uint32_t QueryClient::SendMatchDocument(std::string_view raw_query, int document_id) {
+    const uint32_t request_id = next_request_id_++;
+    const size_t frame_begin = BeginRequest(RequestType::MATCH_DOCUMENT, request_id);
+    WireWriter writer(output_);
+    writer.WriteI32(document_id);
+    writer.WriteString(raw_query);
+    return FinishRequest(frame_begin, RequestType::MATCH_DOCUMENT, request_id);
+}
+
+uint32_t QueryClient::SendAddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    const uint32_t request_id = next_request_id_++;
+    const size_t frame_begin = BeginRequest(RequestType::ADD_DOCUMENT, request_id);
+    WireWriter writer(output_);
+    writer.WriteI32(document_id);
+    writer.WriteU8(static_cast<uint8_t>(status));
+    writer.WriteU32(static_cast<uint32_t>(ratings.size()));
+    for (const int rating : ratings) {
+        writer.WriteI32(rating);
+    }
+    writer.WriteString(document);
+    return FinishRequest(frame_begin, RequestType::ADD_DOCUMENT, request_id);
+}
+
+uint32_t QueryClient::SendRemoveDocument(int document_id) {
+    const uint32_t request_id = next_request_id_++;
+    const size_t frame_begin = BeginRequest(RequestType::REMOVE_DOCUMENT, request_id);
+    WireWriter writer(output_);
+    writer.WriteI32(document_id);
+    return FinishRequest(frame_begin, RequestType::REMOVE_DOCUMENT, request_id);
+}
+
+void QueryClient::Flush() {
+    size_t position = 0;
+    while (position < output_.size()) {
+        const ssize_t size = send(fd_, output_.data() + position, output_.size() - position, MSG_NOSIGNAL);
+        if (size < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw MakeSystemError("send"s);
+        }
+        position += size;
+    }
+    output_.clear();
+}
+
+void QueryClient::FinishSending() {
+    Flush();
+    if (shutdown(fd_, SHUT_WR) < 0) {
+        throw MakeSystemError("shutdown"s);
+    }
+}
+
+QueryResponse QueryClient::ReceiveResponse() {
+    Flush();
+    size_t frame_size = 0;
+    while ((frame_size = GetFrameSize(input_)) == 0) {
+        char buffer[64 * 1024];
+        const ssize_t size = recv(fd_, buffer, sizeof(buffer), 0);
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (size <= 0) {
+            throw size == 0 ? std::runtime_error("Connection closed by server"s) : MakeSystemError("recv"s);
+        }
+        input_.append(buffer, size);
+    }
+
+    WireReader reader(std::string_view(input_).substr(FRAME_HEADER_SIZE, frame_size - FRAME_HEADER_SIZE));
+    QueryResponse response;
+    response.request_id = reader.ReadU32();
+    response.status = static_cast<ResponseStatus>(reader.ReadU8());
+    const auto pending = std::find_if(pending_.begin(), pending_.end(), [&response](const auto& request) {
+        return request.first == response.request_id;
+    });
+    if (pending == pending_.end()) {
+        throw std::runtime_error("Response to unknown request "s + std::to_string(response.request_id));
+    }
+    const RequestType type = pending->second;
+    pending_.erase(pending);
+
+    if (response.status == ResponseStatus::ERROR) {
+        response.error = reader.ReadString();
+    }
+    else if (type == RequestType::FIND_TOP_DOCUMENTS) {
+        response.documents.resize(reader.ReadCount(sizeof(int32_t) + sizeof(double) + sizeof(int32_t)));
+        for (Document& document : response.documents) {
+            document.id = reader.ReadI32();
+            document.relevance = reader.ReadF64();
+            document.rating = reader.ReadI32();
+        }
+    }
+    else if (type == RequestType::MATCH_DOCUMENT) {
+        response.document_status = reader.ReadDocumentStatus();
+        response.words.resize(reader.ReadCount(sizeof(uint32_t)));
+        for (std::string& word : response.words) {
+            word = reader.ReadString();
+        }
+    }
+    input_.erase(0, frame_size);
+    return response;
+}
+
+std::vector<Document> QueryClient::FindTopDocuments(std::string_view raw_query, DocumentStatus status) {
+    return WaitResponse(SendFindTopDocuments(raw_query, status)).documents;
+}
+
+std::tuple<std::vector<std::string>, DocumentStatus> QueryClient::MatchDocument(std::string_view raw_query, int document_id) {
+    QueryResponse response = WaitResponse(SendMatchDocument(raw_query, document_id));
+    return { std::move(response.words), response.document_status };
+}
+
+void QueryClient::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    WaitResponse(SendAddDocument(document_id, document, status, ratings));
+}
+
+void QueryClient::RemoveDocument(int document_id) {
+    WaitResponse(SendRemoveDocument(document_id));
+}
+
+size_t QueryClient::BeginRequest(RequestType type, uint32_t request_id) {
+    const size_t frame_begin = BeginFrame(output_);
+    WireWriter writer(output_);
+    writer.WriteU32(request_id);
+    writer.WriteU8(static_cast<uint8_t>(type));
+    return frame_begin;
+}
+
+uint32_t QueryClient::FinishRequest(size_t frame_begin, RequestType type, uint32_t request_id) {
+    EndFrame(output_, frame_begin);
+    pending_.emplace_back(request_id, type);
+    return request_id;
+}
+
+QueryResponse QueryClient::WaitResponse(uint32_t request_id) {
+    if (pending_.size() != 1) {
+        throw std::logic_error("Blocking calls need a connection without pipelined requests"s);
+    }
+    QueryResponse response = ReceiveResponse();
+    if (response.request_id != request_id) {
+        throw std::runtime_error("Unexpected response "s + std::to_string(response.request_id));
+    }
+    if (response.status == ResponseStatus::ERROR) {
+        throw std::runtime_error(response.error);
+    }
+    return response;
+}
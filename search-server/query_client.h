@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "document.h"
+#include "wire_protocol.h"
+
+// Response of QueryServer as received by QueryClient. Only the fields of the request type are set.
+struct QueryResponse {
+    uint32_t request_id = 0;
+    ResponseStatus status = ResponseStatus::OK;
+    std::string error;
+    std::vector<Document> documents;
+    std::vector<std::string> words;
+    DocumentStatus document_status = DocumentStatus::ACTUAL;
+};
+
+// Blocking TCP client of QueryServer. Send* calls only queue a request and return its id, so
+// several requests may be in flight on one connection; ReceiveResponse returns them as they come.
+// The plain calls send one request and wait for its response, an ERROR response throws
+// std::runtime_error. Socket errors throw std::system_error.
+class QueryClient {
+public:
+    QueryClient(const std::string& host, uint16_t port);
+    ~QueryClient();
+
+    QueryClient(const QueryClient&) = delete;
+    QueryClient& operator=(const QueryClient&) = delete;
+
+    uint32_t SendFindTopDocuments(std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL);
+    uint32_t SendMatchDocument(std::string_view raw_query, int document_id);
+    uint32_t SendAddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    uint32_t SendRemoveDocument(int document_id);
+    // Writes the queued requests to the socket, ReceiveResponse does it as well
+    void Flush();
+    // Writes the queued requests and shuts down the sending side, the responses still arrive
+    void FinishSending();
+    // Waits for the next response to any pending request
+    QueryResponse ReceiveResponse();
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL);
+    std::tuple<std::vector<std::string>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id);
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+
+private:
+    int fd_ = -1;
+    uint32_t next_request_id_ = 0;
+    std::string output_;
+    std::string input_;
+    // Requests waiting for a response with their types, in the order they were sent
+    std::vector<std::pair<uint32_t, RequestType>> pending_;
+
+    size_t BeginRequest(RequestType type, uint32_t request_id);
+    uint32_t FinishRequest(size_t frame_begin, RequestType type, uint32_t request_id);
+    QueryResponse WaitResponse(uint32_t request_id);
+};
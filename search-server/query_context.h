@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string_view>
+
+#include "small_vector.h"
+
+const size_t QUERY_INLINE_WORD_COUNT = 32;
+const size_t QUERY_INLINE_PHRASE_COUNT = 4;
+
+// Parsed query that can be prepared once with SearchServer::PrepareQuery and reused
+// by FindTopDocuments, MatchDocument and batch calls.
+// Words are views into the raw query text, so the text must outlive the context.
+// Typical queries fit into the inline buffers and are parsed without heap allocation.
+// Prefix words (foo* in the query) are stored without the asterisk.
+// Quoted phrases keep their words in query order: phrase i is the next phrase_sizes[i] words
+// of phrase_words. Phrase words are plus words as well.
+struct QueryContext {
+    SmallVector<std::string_view, QUERY_INLINE_WORD_COUNT> plus_words;
+    SmallVector<std::string_view, QUERY_INLINE_WORD_COUNT> minus_words;
+    SmallVector<std::string_view, QUERY_INLINE_PHRASE_COUNT> prefix_words;
+    SmallVector<std::string_view, QUERY_INLINE_WORD_COUNT> phrase_words;
+    SmallVector<size_t, QUERY_INLINE_PHRASE_COUNT> phrase_sizes;
+
+    void Clear() {
+        plus_words.clear();
+        minus_words.clear();
+        prefix_words.clear();
+        phrase_words.clear();
+        phrase_sizes.clear();
+    }
+};
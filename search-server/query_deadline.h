@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+#include "document.h"
+
+// Point in time after which a query stops scoring. The query then returns the best documents
+// scored so far, so the check is cheap enough to run every few thousand postings.
+class QueryDeadline {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Never expires
+    QueryDeadline() = default;
+    explicit QueryDeadline(Clock::time_point time)
+        : time_(time) {
+    }
+
+    bool IsExpired() const {
+        if (expired_.load(std::memory_order_relaxed)) {
+            return true;
+        }
+        if (time_ != Clock::time_point::max() && Clock::now() >= time_) {
+            expired_.store(true, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    // Expires the deadline at once, e.g. when the client is gone
+    void Cancel() {
+        expired_.store(true, std::memory_order_relaxed);
+    }
+
+    // True if some check has seen the deadline expired
+    bool WasExpired() const {
+        return expired_.load(std::memory_order_relaxed);
+    }
+
+private:
+    Clock::time_point time_ = Clock::time_point::max();
+    mutable std::atomic<bool> expired_{ false };
+};
+
+// Postings scored between two checks of a deadline
+const size_t DEADLINE_CHECK_INTERVAL = 1024;
+
+enum class QueryOutcome {
+    COMPLETE,
+    // The deadline passed, documents are the best of those scored in time
+    PARTIAL,
+    // Admission control turned the query away, nothing was evaluated
+    REJECTED,
+};
+
+struct QueryResult {
+    std::vector<Document> documents;
+    QueryOutcome outcome = QueryOutcome::COMPLETE;
+};
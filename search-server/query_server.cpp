@@ -0,0 +1,514 @@
+#include "query_server.h"
+#include "replication.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <exception>
+#include <system_error>
+#include <tuple>
+
+using namespace std::string_literals;
+
+namespace {
+
+const int MAX_EPOLL_EVENTS = 64;
+const size_t READ_CHUNK_SIZE = 64 * 1024;
+
+std::system_error MakeSystemError(const std::string& what) {
+    return std::system_error(errno, std::generic_category(), what);
+}
+
+}
+
+struct QueryServer::Connection {
+    int fd = -1;
+    int epoll_fd = -1;
+    IoThread* io_thread = nullptr;
+    // Touched by the I/O thread only
+    std::string input;
+    // Responses are appended by executor threads, the fields below are guarded by the mutex
+    std::mutex output_mutex;
+    std::string output;
+    bool is_closed = false;
+    bool is_waiting_writable = false;
+    // The peer sends no more requests, set by the I/O thread
+    bool is_read_closed = false;
+    size_t requests_in_flight = 0;
+
+    uint32_t GetEvents() const {
+        const uint32_t read_events = EPOLLIN | EPOLLRDHUP;
+        const uint32_t write_events = EPOLLOUT;
+        return (is_read_closed ? 0 : read_events) | (is_waiting_writable ? write_events : 0);
+    }
+
+    // Every request of a half-closed connection is answered and written
+    bool IsDone() const {
+        return is_read_closed && requests_in_flight == 0 && output.empty();
+    }
+};
+
+// Announces a write for its lifetime, queries arriving meanwhile wait in LockForReading
+class QueryServer::WriteScope {
+public:
+    explicit WriteScope(QueryServer& server)
+        : server_(server) {
+        std::lock_guard lock(server_.writers_mutex_);
+        ++server_.pending_writes_;
+    }
+
+    ~WriteScope() {
+        std::lock_guard lock(server_.writers_mutex_);
+        if (--server_.pending_writes_ == 0) {
+            server_.writers_done_.notify_all();
+        }
+    }
+
+    WriteScope(const WriteScope&) = delete;
+    WriteScope& operator=(const WriteScope&) = delete;
+
+private:
+    QueryServer& server_;
+};
+
+QueryServer::QueryServer(SearchServer& search_server, const QueryServerOptions& options)
+    : search_server_(search_server)
+    , options_(options)
+    , index_mutex_(own_index_mutex_) {
+}
+
+QueryServer::QueryServer(ReplicationLeader& leader, const QueryServerOptions& options)
+    : search_server_(leader.GetSearchServer())
+    , options_(options)
+    , index_mutex_(leader.GetIndexMutex())
+    , leader_(&leader) {
+}
+
+QueryServer::QueryServer(ReplicationFollower& follower, const QueryServerOptions& options)
+    : search_server_(follower.GetSearchServer())
+    , options_(options)
+    , index_mutex_(follower.GetIndexMutex())
+    , is_read_only_(true) {
+}
+
+QueryServer::~QueryServer() {
+    Stop();
+}
+
+void QueryServer::Start() {
+    if (listen_fd_ >= 0) {
+        return;
+    }
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+        throw MakeSystemError("socket"s);
+    }
+    const int enable = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(options_.port);
+    if (inet_pton(AF_INET, options_.address.c_str(), &address.sin_addr) != 1) {
+        Stop();
+        throw std::invalid_argument("Invalid address "s + options_.address);
+    }
+    if (bind(listen_fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0 || listen(listen_fd_, SOMAXCONN) < 0) {
+        const auto error = MakeSystemError("bind "s + options_.address);
+        Stop();
+        throw error;
+    }
+    socklen_t address_size = sizeof(address);
+    getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&address), &address_size);
+    port_ = ntohs(address.sin_port);
+
+    stop_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    for (size_t i = 0; i < std::max<size_t>(1, options_.io_thread_count); ++i) {
+        auto io_thread = std::make_unique<IoThread>();
+        io_thread->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = stop_fd_;
+        epoll_ctl(io_thread->epoll_fd, EPOLL_CTL_ADD, stop_fd_, &event);
+        io_threads_.push_back(std::move(io_thread));
+    }
+    // The first I/O thread also accepts connections
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = listen_fd_;
+    epoll_ctl(io_threads_.front()->epoll_fd, EPOLL_CTL_ADD, listen_fd_, &event);
+    for (auto& io_thread : io_threads_) {
+        io_thread->thread = std::thread([this, &io_thread = *io_thread]() { RunIoThread(io_thread); });
+    }
+}
+
+void QueryServer::Stop() {
+    if (stop_fd_ >= 0) {
+        const uint64_t one = 1;
+        [[maybe_unused]] const auto written = write(stop_fd_, &one, sizeof(one));
+    }
+    for (auto& io_thread : io_threads_) {
+        if (io_thread->thread.joinable()) {
+            io_thread->thread.join();
+        }
+    }
+    {
+        // Executor tasks refer to the server
+        std::unique_lock lock(requests_mutex_);
+        requests_done_.wait(lock, [this]() { return requests_in_flight_ == 0; });
+    }
+    for (auto& io_thread : io_threads_) {
+        std::vector<std::shared_ptr<Connection>> connections;
+        for (const auto& [_, connection] : io_thread->connections) {
+            connections.push_back(connection);
+        }
+        for (const auto& connection : connections) {
+            Close(connection);
+        }
+        close(io_thread->epoll_fd);
+    }
+    io_threads_.clear();
+    if (listen_fd_ >= 0) {
+        close(listen_fd_);
+        listen_fd_ = -1;
+    }
+    if (stop_fd_ >= 0) {
+        close(stop_fd_);
+        stop_fd_ = -1;
+    }
+}
+
+uint16_t QueryServer::GetPort() const {
+    return port_;
+}
+
+void QueryServer::RunIoThread(IoThread& io_thread) {
+    epoll_event events[MAX_EPOLL_EVENTS];
+    while (true) {
+        const int event_count = epoll_wait(io_thread.epoll_fd, events, MAX_EPOLL_EVENTS, -1);
+        if (event_count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        for (int i = 0; i < event_count; ++i) {
+            const int fd = events[i].data.fd;
+            if (fd == stop_fd_) {
+                return;
+            }
+            if (fd == listen_fd_) {
+                AcceptConnections();
+                continue;
+            }
+            std::shared_ptr<Connection> connection;
+            {
+                std::lock_guard lock(io_thread.connections_mutex);
+                const auto it = io_thread.connections.find(fd);
+                if (it == io_thread.connections.end()) {
+                    continue;
+                }
+                connection = it->second;
+            }
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                Close(connection);
+                continue;
+            }
+            if (events[i].events & EPOLLOUT) {
+                Flush(connection);
+            }
+            // Only this thread sets is_read_closed
+            if ((events[i].events & (EPOLLIN | EPOLLRDHUP)) && !connection->is_read_closed) {
+                ReadRequests(connection);
+            }
+        }
+    }
+}
+
+void QueryServer::AcceptConnections() {
+    while (true) {
+        const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        const int enable = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+        IoThread& io_thread = *io_threads_[next_io_thread_.fetch_add(1) % io_threads_.size()];
+        auto connection = std::make_shared<Connection>();
+        connection->fd = fd;
+        connection->epoll_fd = io_thread.epoll_fd;
+        connection->io_thread = &io_thread;
+        {
+            std::lock_guard lock(io_thread.connections_mutex);
+            io_thread.connections[fd] = connection;
+        }
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.fd = fd;
+        epoll_ctl(io_thread.epoll_fd, EPOLL_CTL_ADD, fd, &event);
+    }
+}
+
+void QueryServer::ReadRequests(const std::shared_ptr<Connection>& connection) {
+    char buffer[READ_CHUNK_SIZE];
+    // A half-close still wants the responses, a broken connection or protocol does not
+    bool is_read_closed = false;
+    bool is_broken = false;
+    while (true) {
+        const ssize_t size = recv(connection->fd, buffer, sizeof(buffer), 0);
+        if (size > 0) {
+            connection->input.append(buffer, size);
+            continue;
+        }
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+        is_read_closed = size == 0;
+        is_broken = size < 0 && errno != EAGAIN && errno != EWOULDBLOCK;
+        break;
+    }
+
+    size_t position = 0;
+    try {
+        const std::string_view input = connection->input;
+        while (const size_t frame_size = GetFrameSize(input.substr(position))) {
+            Dispatch(connection, std::string(input.substr(position + FRAME_HEADER_SIZE, frame_size - FRAME_HEADER_SIZE)));
+            position += frame_size;
+        }
+    }
+    catch (const std::invalid_argument&) {
+        is_broken = true;
+    }
+    connection->input.erase(0, position);
+    if (is_broken) {
+        Close(connection);
+    }
+    else if (is_read_closed) {
+        StopReading(connection);
+    }
+}
+
+void QueryServer::Dispatch(const std::shared_ptr<Connection>& connection, std::string request) {
+    {
+        std::lock_guard lock(requests_mutex_);
+        ++requests_in_flight_;
+    }
+    {
+        std::lock_guard lock(connection->output_mutex);
+        ++connection->requests_in_flight;
+    }
+    search_server_.GetExecutor().Submit([this, connection, request = std::move(request)]() {
+        Send(*connection, Execute(request));
+        FinishRequest(connection);
+        std::lock_guard lock(requests_mutex_);
+        if (--requests_in_flight_ == 0) {
+            requests_done_.notify_all();
+        }
+    });
+}
+
+std::string QueryServer::Execute(std::string_view request) {
+    std::string response;
+    const size_t frame_begin = BeginFrame(response);
+    WireWriter writer(response);
+    WireReader reader(request);
+    uint32_t request_id = 0;
+    try {
+        request_id = reader.ReadU32();
+        const auto type = static_cast<RequestType>(reader.ReadU8());
+        std::string body;
+        WireWriter body_writer(body);
+        ExecuteRequest(type, reader, body_writer);
+        writer.WriteU32(request_id);
+        writer.WriteU8(static_cast<uint8_t>(ResponseStatus::OK));
+        response += body;
+    }
+    catch (const std::exception& e) {
+        response.resize(frame_begin + FRAME_HEADER_SIZE);
+        writer.WriteU32(request_id);
+        writer.WriteU8(static_cast<uint8_t>(ResponseStatus::ERROR));
+        writer.WriteString(e.what());
+    }
+    EndFrame(response, frame_begin);
+    return response;
+}
+
+void QueryServer::ExecuteRequest(RequestType type, WireReader& reader, WireWriter& writer) {
+    switch (type) {
+    case RequestType::FIND_TOP_DOCUMENTS: {
+        const DocumentStatus status = reader.ReadDocumentStatus();
+        const std::string_view query = reader.ReadString();
+        std::vector<Document> documents;
+        {
+            const auto lock = LockForReading();
+            documents = search_server_.GetParallelismMode() == ParallelismMode::INTER_QUERY
+                ? search_server_.FindTopDocuments(std::execution::seq, query, status)
+                : search_server_.FindTopDocuments(std::execution::par, query, status);
+        }
+        writer.WriteU32(static_cast<uint32_t>(documents.size()));
+        for (const Document& document : documents) {
+            writer.WriteI32(document.id);
+            writer.WriteF64(document.relevance);
+            writer.WriteI32(document.rating);
+        }
+        break;
+    }
+    case RequestType::MATCH_DOCUMENT: {
+        const int document_id = reader.ReadI32();
+        const std::string_view query = reader.ReadString();
+        const auto lock = LockForReading();
+        const auto [words, status] = search_server_.MatchDocument(query, document_id);
+        writer.WriteU8(static_cast<uint8_t>(status));
+        writer.WriteU32(static_cast<uint32_t>(words.size()));
+        for (const std::string_view word : words) {
+            writer.WriteString(word);
+        }
+        break;
+    }
+    case RequestType::ADD_DOCUMENT: {
+        const int document_id = reader.ReadI32();
+        const DocumentStatus status = reader.ReadDocumentStatus();
+        std::vector<int> ratings(reader.ReadCount(sizeof(int32_t)));
+        for (int& rating : ratings) {
+            rating = reader.ReadI32();
+        }
+        const std::string_view text = reader.ReadString();
+        if (is_read_only_) {
+            throw std::invalid_argument("Writes go to the replication leader"s);
+        }
+        const WriteScope write_scope(*this);
+        if (leader_) {
+            leader_->AddDocument(document_id, text, status, ratings);
+            break;
+        }
+        std::unique_lock lock(index_mutex_);
+        search_server_.AddDocument(document_id, text, status, ratings);
+        break;
+    }
+    case RequestType::REMOVE_DOCUMENT: {
+        const int document_id = reader.ReadI32();
+        if (is_read_only_) {
+            throw std::invalid_argument("Writes go to the replication leader"s);
+        }
+        const WriteScope write_scope(*this);
+        if (leader_) {
+            leader_->RemoveDocument(document_id);
+            break;
+        }
+        std::unique_lock lock(index_mutex_);
+        search_server_.RemoveDocument(document_id);
+        break;
+    }
+    default:
+        throw std::invalid_argument("Unknown request type "s + std::to_string(static_cast<int>(type)));
+    }
+}
+
+std::shared_lock<std::shared_mutex> QueryServer::LockForReading() {
+    {
+        std::unique_lock lock(writers_mutex_);
+        writers_done_.wait(lock, [this]() { return pending_writes_ == 0; });
+    }
+    return std::shared_lock(index_mutex_);
+}
+
+void QueryServer::Send(Connection& connection, std::string_view frame) {
+    std::lock_guard lock(connection.output_mutex);
+    if (connection.is_closed) {
+        return;
+    }
+    connection.output.append(frame);
+    // Written right away when possible, the I/O thread finishes what the socket does not take
+    while (!connection.output.empty()) {
+        const ssize_t size = send(connection.fd, connection.output.data(), connection.output.size(), MSG_NOSIGNAL);
+        if (size <= 0) {
+            break;
+        }
+        connection.output.erase(0, size);
+    }
+    if (!connection.output.empty() && !connection.is_waiting_writable) {
+        connection.is_waiting_writable = true;
+        epoll_event event{};
+        event.events = connection.GetEvents();
+        event.data.fd = connection.fd;
+        epoll_ctl(connection.epoll_fd, EPOLL_CTL_MOD, connection.fd, &event);
+    }
+}
+
+void QueryServer::FinishRequest(const std::shared_ptr<Connection>& connection) {
+    {
+        std::lock_guard lock(connection->output_mutex);
+        --connection->requests_in_flight;
+        if (connection->is_closed || !connection->IsDone()) {
+            return;
+        }
+    }
+    Close(connection);
+}
+
+void QueryServer::Flush(const std::shared_ptr<Connection>& connection) {
+    {
+        std::lock_guard lock(connection->output_mutex);
+        if (connection->is_closed) {
+            return;
+        }
+        while (!connection->output.empty()) {
+            const ssize_t size = send(connection->fd, connection->output.data(), connection->output.size(), MSG_NOSIGNAL);
+            if (size <= 0) {
+                return;
+            }
+            connection->output.erase(0, size);
+        }
+        if (connection->is_waiting_writable) {
+            connection->is_waiting_writable = false;
+            epoll_event event{};
+            event.events = connection->GetEvents();
+            event.data.fd = connection->fd;
+            epoll_ctl(connection->epoll_fd, EPOLL_CTL_MOD, connection->fd, &event);
+        }
+        if (!connection->IsDone()) {
+            return;
+        }
+    }
+    Close(connection);
+}
+
+void QueryServer::StopReading(const std::shared_ptr<Connection>& connection) {
+    {
+        std::lock_guard lock(connection->output_mutex);
+        connection->is_read_closed = true;
+        if (!connection->IsDone()) {
+            epoll_event event{};
+            event.events = connection->GetEvents();
+            event.data.fd = connection->fd;
+            epoll_ctl(connection->epoll_fd, EPOLL_CTL_MOD, connection->fd, &event);
+            return;
+        }
+    }
+    Close(connection);
+}
+
+void QueryServer::Close(const std::shared_ptr<Connection>& connection) {
+    IoThread& io_thread = *connection->io_thread;
+    {
+        std::lock_guard lock(io_thread.connections_mutex);
+        const auto it = io_thread.connections.find(connection->fd);
+        // Closed already, the descriptor may belong to a newer connection by now
+        if (it == io_thread.connections.end() || it->second != connection) {
+            return;
+        }
+        io_thread.connections.erase(it);
+    }
+    // Under the output mutex, so a response of a running request never goes to a reused descriptor
+    std::lock_guard lock(connection->output_mutex);
+    connection->is_closed = true;
+    epoll_ctl(io_thread.epoll_fd, EPOLL_CTL_DEL, connection->fd, nullptr);
+    close(connection->fd);
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "search_server.h"
+#include "wire_protocol.h"
+
+class ReplicationLeader;
+class ReplicationFollower;
+
+struct QueryServerOptions {
+    std::string address = "127.0.0.1";
+    // 0 picks a free port, see QueryServer::GetPort
+    uint16_t port = 0;
+    size_t io_thread_count = 2;
+};
+
+// TCP front end of a SearchServer speaking the protocol of wire_protocol.h (Linux only).
+// A few I/O threads wait on epoll, read whole frames and hand every request to the executor
+// of the server, so a slow query never holds up the connections of an I/O thread. Requests of
+// a connection are pipelined: they run concurrently and are answered in the order they finish.
+// Queries share a lock on the index, AddDocument and RemoveDocument take it exclusively.
+// Writers go first: std::shared_mutex on glibc admits new readers as long as one holds the lock,
+// so under steady query load a write would wait forever, holding an executor thread. A write
+// announces itself before locking, and queries arriving meanwhile wait until it is done.
+// A peer that shuts down its sending side after a pipeline still gets every response; the
+// connection closes once the last one is written.
+// Behind a replication leader writes go through its mutation log, a follower is read-only.
+class QueryServer {
+public:
+    explicit QueryServer(SearchServer& search_server, const QueryServerOptions& options = QueryServerOptions());
+    explicit QueryServer(ReplicationLeader& leader, const QueryServerOptions& options = QueryServerOptions());
+    explicit QueryServer(ReplicationFollower& follower, const QueryServerOptions& options = QueryServerOptions());
+    ~QueryServer();
+
+    QueryServer(const QueryServer&) = delete;
+    QueryServer& operator=(const QueryServer&) = delete;
+
+    // Binds the socket and starts the I/O threads; socket errors throw std::system_error
+    void Start();
+    // Closes all connections after the requests being executed are answered
+    void Stop();
+
+    uint16_t GetPort() const;
+
+private:
+    struct Connection;
+    class WriteScope;
+
+    struct IoThread {
+        int epoll_fd = -1;
+        std::thread thread;
+        // Connections are added by the accepting thread
+        std::mutex connections_mutex;
+        std::unordered_map<int, std::shared_ptr<Connection>> connections;
+    };
+
+    SearchServer& search_server_;
+    const QueryServerOptions options_;
+    std::shared_mutex own_index_mutex_;
+    // Own mutex or the one of the replica
+    std::shared_mutex& index_mutex_;
+    ReplicationLeader* const leader_ = nullptr;
+    const bool is_read_only_ = false;
+    int listen_fd_ = -1;
+    // Readable once Stop is called, wakes up every I/O thread
+    int stop_fd_ = -1;
+    uint16_t port_ = 0;
+    std::vector<std::unique_ptr<IoThread>> io_threads_;
+    std::atomic<size_t> next_io_thread_{ 0 };
+    std::mutex requests_mutex_;
+    std::condition_variable requests_done_;
+    size_t requests_in_flight_ = 0;
+    // Writes announced or running, queries wait for none to be left
+    std::mutex writers_mutex_;
+    std::condition_variable writers_done_;
+    size_t pending_writes_ = 0;
+
+    void RunIoThread(IoThread& io_thread);
+    void AcceptConnections();
+    void ReadRequests(const std::shared_ptr<Connection>& connection);
+    void Dispatch(const std::shared_ptr<Connection>& connection, std::string request);
+    // Response frame for a request payload
+    std::string Execute(std::string_view request);
+    void ExecuteRequest(RequestType type, WireReader& reader, WireWriter& writer);
+    std::shared_lock<std::shared_mutex> LockForReading();
+    void Send(Connection& connection, std::string_view frame);
+    void FinishRequest(const std::shared_ptr<Connection>& connection);
+    void Flush(const std::shared_ptr<Connection>& connection);
+    // Stops reading a connection whose peer has shut down its side
+    void StopReading(const std::shared_ptr<Connection>& connection);
+    void Close(const std::shared_ptr<Connection>& connection);
+};
@@ -0,0 +1,113 @@
+#include "query_trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std::string_literals;
+
+namespace {
+
+const size_t STAGE_COUNT = static_cast<size_t>(QueryStage::COUNT);
+
+// Written only by its own thread; atomics let CollectQueryTrace read it at any moment
+struct ThreadTraceBuffer {
+    std::array<std::atomic<uint64_t>, STAGE_COUNT> span_counts = {};
+    std::array<std::atomic<uint64_t>, STAGE_COUNT> total_ns = {};
+    std::array<std::atomic<uint64_t>, STAGE_COUNT> max_ns = {};
+};
+
+struct TraceRegistry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<ThreadTraceBuffer>> buffers;
+};
+
+TraceRegistry& GetTraceRegistry() {
+    static TraceRegistry registry;
+    return registry;
+}
+
+ThreadTraceBuffer& GetThreadTraceBuffer() {
+    // The registry lock is taken once per thread, recording itself never locks
+    thread_local const std::shared_ptr<ThreadTraceBuffer> buffer = [] {
+        auto new_buffer = std::make_shared<ThreadTraceBuffer>();
+        TraceRegistry& registry = GetTraceRegistry();
+        std::lock_guard guard(registry.mutex);
+        registry.buffers.push_back(new_buffer);
+        return new_buffer;
+    }();
+    return *buffer;
+}
+
+}
+
+std::string_view GetQueryStageName(QueryStage stage) {
+    switch (stage) {
+    case QueryStage::PARSE:
+        return "parse";
+    case QueryStage::IDF:
+        return "idf";
+    case QueryStage::POSTINGS:
+        return "postings";
+    case QueryStage::MINUS_WORDS:
+        return "minus_words";
+    case QueryStage::PHRASES:
+        return "phrases";
+    case QueryStage::SORT_TOP_K:
+        return "sort_top_k";
+    case QueryStage::MATERIALIZE:
+        return "materialize";
+    default:
+        return "unknown";
+    }
+}
+
+void QueryStageSpan::RecordQueryStage(QueryStage stage, uint64_t duration_ns) {
+    ThreadTraceBuffer& buffer = GetThreadTraceBuffer();
+    const size_t index = static_cast<size_t>(stage);
+    buffer.span_counts[index].store(buffer.span_counts[index].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    buffer.total_ns[index].store(buffer.total_ns[index].load(std::memory_order_relaxed) + duration_ns, std::memory_order_relaxed);
+    if (duration_ns > buffer.max_ns[index].load(std::memory_order_relaxed)) {
+        buffer.max_ns[index].store(duration_ns, std::memory_order_relaxed);
+    }
+}
+
+QueryTrace CollectQueryTrace() {
+    QueryTrace trace;
+    TraceRegistry& registry = GetTraceRegistry();
+    std::lock_guard guard(registry.mutex);
+    for (const auto& buffer : registry.buffers) {
+        for (size_t i = 0; i < STAGE_COUNT; ++i) {
+            trace[i].span_count += buffer->span_counts[i].load(std::memory_order_relaxed);
+            trace[i].total_ns += buffer->total_ns[i].load(std::memory_order_relaxed);
+            trace[i].max_ns = std::max(trace[i].max_ns, buffer->max_ns[i].load(std::memory_order_relaxed));
+        }
+    }
+    return trace;
+}
+
+void ResetQueryTrace() {
+    TraceRegistry& registry = GetTraceRegistry();
+    std::lock_guard guard(registry.mutex);
+    for (const auto& buffer : registry.buffers) {
+        for (size_t i = 0; i < STAGE_COUNT; ++i) {
+            buffer->span_counts[i].store(0, std::memory_order_relaxed);
+            buffer->total_ns[i].store(0, std::memory_order_relaxed);
+            buffer->max_ns[i].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+std::ostream& operator<<(std::ostream& output, const QueryTrace& trace) {
+    for (size_t i = 0; i < STAGE_COUNT; ++i) {
+        const auto& stage = trace[i];
+        output << GetQueryStageName(static_cast<QueryStage>(i)) << ": "s
+            << stage.span_count << " spans, "s
+            << stage.total_ns << " ns total, "s
+            << (stage.span_count ? stage.total_ns / stage.span_count : 0) << " ns avg, "s
+            << stage.max_ns << " ns max"s << std::endl;
+    }
+    return output;
+}
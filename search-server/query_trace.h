@@ -0,0 +1,64 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+
+#include "log_duration.h"
+
+// Stages of FindTopDocuments measured by TRACE_QUERY_STAGE
+enum class QueryStage {
+    PARSE,
+    IDF,
+    POSTINGS,
+    MINUS_WORDS,
+    PHRASES,
+    SORT_TOP_K,
+    MATERIALIZE,
+    COUNT,
+};
+
+std::string_view GetQueryStageName(QueryStage stage);
+
+struct QueryStageStatistics {
+    uint64_t span_count = 0;
+    uint64_t total_ns = 0;
+    uint64_t max_ns = 0;
+};
+
+using QueryTrace = std::array<QueryStageStatistics, static_cast<size_t>(QueryStage::COUNT)>;
+
+// Sums the spans recorded by all threads so far
+QueryTrace CollectQueryTrace();
+void ResetQueryTrace();
+std::ostream& operator<<(std::ostream& output, const QueryTrace& trace);
+
+// Like LogDuration, but instead of printing it adds the nanoseconds of its scope
+// to a buffer of the current thread
+class QueryStageSpan {
+public:
+    using Clock = LogDuration::Clock;
+
+    explicit QueryStageSpan(QueryStage stage)
+        : stage_(stage) {
+    }
+
+    ~QueryStageSpan() {
+        RecordQueryStage(stage_, std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start_time_).count());
+    }
+
+private:
+    const QueryStage stage_;
+    const Clock::time_point start_time_ = Clock::now();
+
+    static void RecordQueryStage(QueryStage stage, uint64_t duration_ns);
+};
+
+// Spans are compiled in only when SEARCH_SERVER_TRACING is defined
+#ifdef SEARCH_SERVER_TRACING
+#define TRACE_QUERY_STAGE(stage) QueryStageSpan UNIQUE_VAR_NAME_PROFILE(stage)
+#else
+#define TRACE_QUERY_STAGE(stage) ((void)0)
+#endif
@@ -0,0 +1,580 @@
+#include "replication.h"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <random>
+#include <stdexcept>
+#include <system_error>
+
+using namespace std::string_literals;
+
+namespace {
+
+// Mutations sent to a follower in one write
+const size_t SHIPPING_BATCH_SIZE = 1024;
+
+std::system_error MakeSystemError(const std::string& what) {
+    return std::system_error(errno, std::generic_category(), what);
+}
+
+void SendAll(int fd, std::string_view data) {
+    while (!data.empty()) {
+        const ssize_t size = send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+        if (size < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw MakeSystemError("send"s);
+        }
+        data.remove_prefix(size);
+    }
+}
+
+// Payload of the next frame, the bytes received after it stay in buffer
+std::string ReceiveFrame(int fd, std::string& buffer) {
+    size_t frame_size = 0;
+    while ((frame_size = GetFrameSize(buffer)) == 0) {
+        char chunk[64 * 1024];
+        const ssize_t size = recv(fd, chunk, sizeof(chunk), 0);
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (size <= 0) {
+            throw size == 0 ? std::runtime_error("Connection closed"s) : MakeSystemError("recv"s);
+        }
+        buffer.append(chunk, size);
+    }
+    std::string payload = buffer.substr(FRAME_HEADER_SIZE, frame_size - FRAME_HEADER_SIZE);
+    buffer.erase(0, frame_size);
+    return payload;
+}
+
+uint64_t GenerateEpoch() {
+    std::random_device random_device;
+    std::uniform_int_distribution<uint64_t> distribution(1);
+    return distribution(random_device);
+}
+
+void WriteMutation(std::string& buffer, uint64_t epoch, const Mutation& mutation) {
+    const size_t frame_begin = BeginFrame(buffer);
+    WireWriter writer(buffer);
+    writer.WriteU8(static_cast<uint8_t>(ReplicationMessage::MUTATION));
+    writer.WriteU64(epoch);
+    writer.WriteU64(mutation.sequence);
+    writer.WriteU8(static_cast<uint8_t>(mutation.type));
+    writer.WriteI32(mutation.document_id);
+    if (mutation.type == RequestType::ADD_DOCUMENT) {
+        writer.WriteU8(static_cast<uint8_t>(mutation.status));
+        writer.WriteU32(static_cast<uint32_t>(mutation.ratings.size()));
+        for (const int rating : mutation.ratings) {
+            writer.WriteI32(rating);
+        }
+        writer.WriteString(mutation.text);
+    }
+    EndFrame(buffer, frame_begin);
+}
+
+// Reads a MUTATION message after its ReplicationMessage byte, a mutation of another epoch throws
+Mutation ReadMutation(WireReader& reader, uint64_t epoch) {
+    if (reader.ReadU64() != epoch) {
+        throw std::invalid_argument("Mutation of another leader epoch"s);
+    }
+    Mutation mutation;
+    mutation.sequence = reader.ReadU64();
+    mutation.type = static_cast<RequestType>(reader.ReadU8());
+    mutation.document_id = reader.ReadI32();
+    if (mutation.type == RequestType::ADD_DOCUMENT) {
+        mutation.status = reader.ReadDocumentStatus();
+        mutation.ratings.resize(reader.ReadCount(sizeof(int32_t)));
+        for (int& rating : mutation.ratings) {
+            rating = reader.ReadI32();
+        }
+        mutation.text = reader.ReadString();
+    }
+    else if (mutation.type != RequestType::REMOVE_DOCUMENT) {
+        throw std::invalid_argument("Unexpected mutation type "s + std::to_string(static_cast<int>(mutation.type)));
+    }
+    return mutation;
+}
+
+void WriteHeartbeat(std::string& buffer, uint64_t sequence) {
+    const size_t frame_begin = BeginFrame(buffer);
+    WireWriter writer(buffer);
+    writer.WriteU8(static_cast<uint8_t>(ReplicationMessage::HEARTBEAT));
+    writer.WriteU64(sequence);
+    EndFrame(buffer, frame_begin);
+}
+
+}
+
+ReplicationLeader::ReplicationLeader(SearchServer& search_server, const ReplicationOptions& options)
+    : search_server_(search_server)
+    , options_(options)
+    , epoch_(GenerateEpoch()) {
+}
+
+ReplicationLeader::~ReplicationLeader() {
+    Stop();
+}
+
+void ReplicationLeader::Start() {
+    if (listen_fd_ >= 0) {
+        return;
+    }
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+        throw MakeSystemError("socket"s);
+    }
+    const int enable = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(options_.port);
+    if (inet_pton(AF_INET, options_.address.c_str(), &address.sin_addr) != 1) {
+        Stop();
+        throw std::invalid_argument("Invalid address "s + options_.address);
+    }
+    if (bind(listen_fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0 || listen(listen_fd_, SOMAXCONN) < 0) {
+        const auto error = MakeSystemError("bind "s + options_.address);
+        Stop();
+        throw error;
+    }
+    socklen_t address_size = sizeof(address);
+    getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&address), &address_size);
+    port_ = ntohs(address.sin_port);
+    stop_fd_ = eventfd(0, EFD_CLOEXEC);
+    {
+        std::lock_guard lock(log_mutex_);
+        stopping_ = false;
+    }
+    accept_thread_ = std::thread([this]() { AcceptFollowers(); });
+}
+
+void ReplicationLeader::Stop() {
+    {
+        std::lock_guard lock(log_mutex_);
+        stopping_ = true;
+    }
+    log_changed_.notify_all();
+    if (stop_fd_ >= 0) {
+        const uint64_t one = 1;
+        [[maybe_unused]] const auto written = write(stop_fd_, &one, sizeof(one));
+    }
+    if (accept_thread_.joinable()) {
+        accept_thread_.join();
+    }
+    {
+        // Wakes up threads blocked in send to a slow follower
+        std::lock_guard lock(followers_mutex_);
+        for (const int fd : follower_fds_) {
+            shutdown(fd, SHUT_RDWR);
+        }
+    }
+    for (auto& thread : follower_threads_) {
+        thread.join();
+    }
+    follower_threads_.clear();
+    if (listen_fd_ >= 0) {
+        close(listen_fd_);
+        listen_fd_ = -1;
+    }
+    if (stop_fd_ >= 0) {
+        close(stop_fd_);
+        stop_fd_ = -1;
+    }
+}
+
+uint16_t ReplicationLeader::GetPort() const {
+    return port_;
+}
+
+uint64_t ReplicationLeader::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    std::unique_lock lock(index_mutex_);
+    search_server_.AddDocument(document_id, document, status, ratings);
+    Mutation mutation;
+    mutation.type = RequestType::ADD_DOCUMENT;
+    mutation.document_id = document_id;
+    mutation.status = status;
+    mutation.ratings = ratings;
+    mutation.text = document;
+    return AppendMutation(std::move(mutation));
+}
+
+uint64_t ReplicationLeader::RemoveDocument(int document_id) {
+    std::unique_lock lock(index_mutex_);
+    const int document_count = search_server_.GetDocumentCount();
+    search_server_.RemoveDocument(document_id);
+    // Removing a missing document changes nothing, there is nothing to replicate
+    if (search_server_.GetDocumentCount() == document_count) {
+        return GetSequence();
+    }
+    Mutation mutation;
+    mutation.type = RequestType::REMOVE_DOCUMENT;
+    mutation.document_id = document_id;
+    return AppendMutation(std::move(mutation));
+}
+
+uint64_t ReplicationLeader::GetSequence() const {
+    std::lock_guard lock(log_mutex_);
+    return sequence_;
+}
+
+uint64_t ReplicationLeader::GetEpoch() const {
+    return epoch_;
+}
+
+SearchServer& ReplicationLeader::GetSearchServer() {
+    return search_server_;
+}
+
+std::shared_mutex& ReplicationLeader::GetIndexMutex() {
+    return index_mutex_;
+}
+
+uint64_t ReplicationLeader::AppendMutation(Mutation mutation) {
+    std::lock_guard lock(log_mutex_);
+    mutation.sequence = ++sequence_;
+    log_.push_back(std::move(mutation));
+    while (log_.size() > options_.max_log_size) {
+        log_.pop_front();
+    }
+    log_changed_.notify_all();
+    return sequence_;
+}
+
+void ReplicationLeader::AcceptFollowers() {
+    pollfd fds[2] = { { listen_fd_, POLLIN, 0 }, { stop_fd_, POLLIN, 0 } };
+    while (true) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        if (fds[1].revents) {
+            return;
+        }
+        const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+        const int enable = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        std::lock_guard lock(followers_mutex_);
+        follower_fds_.push_back(fd);
+        follower_threads_.emplace_back([this, fd]() {
+            try {
+                ShipLog(fd);
+            }
+            catch (const std::exception&) {
+                // The follower reconnects and subscribes again
+            }
+            std::lock_guard lock(followers_mutex_);
+            follower_fds_.erase(std::find(follower_fds_.begin(), follower_fds_.end(), fd));
+            close(fd);
+        });
+    }
+}
+
+void ReplicationLeader::ShipLog(int fd) {
+    std::string input;
+    const std::string subscribe = ReceiveFrame(fd, input);
+    WireReader reader(subscribe);
+    if (static_cast<ReplicationMessage>(reader.ReadU8()) != ReplicationMessage::SUBSCRIBE) {
+        throw std::invalid_argument("Expected a subscription"s);
+    }
+    // Sequence numbers of another epoch mean nothing here
+    bool is_same_epoch = reader.ReadU64() == epoch_;
+    uint64_t next_sequence = reader.ReadU64();
+
+    std::string output;
+    while (true) {
+        output.clear();
+        bool send_snapshot = false;
+        {
+            std::unique_lock lock(log_mutex_);
+            const auto needs_snapshot = [this, &next_sequence, &is_same_epoch]() {
+                const uint64_t log_begin = log_.empty() ? sequence_ + 1 : log_.front().sequence;
+                return !is_same_epoch || next_sequence < log_begin || next_sequence > sequence_ + 1;
+            };
+            log_changed_.wait_for(lock, REPLICATION_HEARTBEAT_INTERVAL, [this, &next_sequence, &needs_snapshot]() {
+                return stopping_ || sequence_ >= next_sequence || needs_snapshot();
+            });
+            if (stopping_) {
+                return;
+            }
+            if (needs_snapshot()) {
+                send_snapshot = true;
+            }
+            else if (next_sequence <= sequence_) {
+                const uint64_t log_begin = log_.front().sequence;
+                const uint64_t end = std::min(sequence_ + 1, next_sequence + SHIPPING_BATCH_SIZE);
+                for (; next_sequence < end; ++next_sequence) {
+                    WriteMutation(output, epoch_, log_[next_sequence - log_begin]);
+                }
+            }
+            else {
+                WriteHeartbeat(output, sequence_);
+            }
+        }
+        if (send_snapshot) {
+            next_sequence = SendSnapshot(fd) + 1;
+            is_same_epoch = true;
+            continue;
+        }
+        SendAll(fd, output);
+    }
+}
+
+uint64_t ReplicationLeader::SendSnapshot(int fd) {
+    // Writers log under the unique index mutex, so under the shared one the documents of the
+    // server are the state as of sequence_. Only the copy is made under the lock: queries go on,
+    // writes wait for the copy but not for the encoding or the network.
+    std::vector<Mutation> documents;
+    uint64_t sequence = 0;
+    {
+        std::shared_lock index_lock(index_mutex_);
+        {
+            std::lock_guard log_lock(log_mutex_);
+            sequence = sequence_;
+        }
+        documents.reserve(search_server_.GetDocumentCount());
+        for (const int document_id : search_server_) {
+            const StoredDocument stored = search_server_.GetStoredDocument(document_id);
+            Mutation document;
+            document.sequence = sequence;
+            document.document_id = document_id;
+            document.status = stored.status;
+            // The average keeps the ranking of the follower the same
+            document.ratings = { stored.rating };
+            document.text = stored.text;
+            documents.push_back(std::move(document));
+        }
+    }
+
+    std::string output;
+    const size_t frame_begin = BeginFrame(output);
+    WireWriter writer(output);
+    writer.WriteU8(static_cast<uint8_t>(ReplicationMessage::SNAPSHOT));
+    writer.WriteU64(epoch_);
+    writer.WriteU64(sequence);
+    writer.WriteU32(static_cast<uint32_t>(documents.size()));
+    EndFrame(output, frame_begin);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        WriteMutation(output, epoch_, documents[i]);
+        if ((i + 1) % SHIPPING_BATCH_SIZE == 0) {
+            SendAll(fd, output);
+            output.clear();
+        }
+    }
+    SendAll(fd, output);
+    return sequence;
+}
+
+ReplicationFollower::ReplicationFollower(SearchServer& search_server, std::string leader_host, uint16_t leader_port)
+    : search_server_(search_server)
+    , leader_host_(std::move(leader_host))
+    , leader_port_(leader_port) {
+}
+
+ReplicationFollower::~ReplicationFollower() {
+    Stop();
+}
+
+void ReplicationFollower::Start() {
+    if (thread_.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard lock(state_mutex_);
+        stopping_ = false;
+    }
+    thread_ = std::thread([this]() { Run(); });
+}
+
+void ReplicationFollower::Stop() {
+    {
+        std::lock_guard lock(state_mutex_);
+        stopping_ = true;
+        if (fd_ >= 0) {
+            shutdown(fd_, SHUT_RDWR);
+        }
+    }
+    state_changed_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+uint64_t ReplicationFollower::GetAppliedSequence() const {
+    std::lock_guard lock(state_mutex_);
+    return applied_sequence_;
+}
+
+bool ReplicationFollower::WaitForSequence(uint64_t sequence, std::chrono::steady_clock::duration timeout) const {
+    std::unique_lock lock(state_mutex_);
+    return state_changed_.wait_for(lock, timeout, [this, sequence]() { return applied_sequence_ >= sequence; });
+}
+
+SearchServer& ReplicationFollower::GetSearchServer() {
+    return search_server_;
+}
+
+std::shared_mutex& ReplicationFollower::GetIndexMutex() {
+    return index_mutex_;
+}
+
+void ReplicationFollower::Run() {
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    while (true) {
+        int fd = -1;
+        addrinfo* addresses = nullptr;
+        if (getaddrinfo(leader_host_.c_str(), std::to_string(leader_port_).c_str(), &hints, &addresses) == 0 && addresses != nullptr) {
+            fd = socket(addresses->ai_family, addresses->ai_socktype | SOCK_CLOEXEC, addresses->ai_protocol);
+            if (fd >= 0 && connect(fd, addresses->ai_addr, addresses->ai_addrlen) < 0) {
+                close(fd);
+                fd = -1;
+            }
+            freeaddrinfo(addresses);
+        }
+        {
+            std::unique_lock lock(state_mutex_);
+            if (stopping_) {
+                if (fd >= 0) {
+                    close(fd);
+                }
+                return;
+            }
+            fd_ = fd;
+        }
+        if (fd >= 0) {
+            try {
+                ReceiveLog(fd);
+            }
+            catch (const std::exception&) {
+                // Leader is gone or the connection was shut down by Stop
+            }
+            std::lock_guard lock(state_mutex_);
+            fd_ = -1;
+            close(fd);
+        }
+        std::unique_lock lock(state_mutex_);
+        if (state_changed_.wait_for(lock, REPLICATION_RECONNECT_DELAY, [this]() { return stopping_; })) {
+            return;
+        }
+    }
+}
+
+void ReplicationFollower::ReceiveLog(int fd) {
+    const auto timeout_us = std::chrono::duration_cast<std::chrono::microseconds>(REPLICATION_TIMEOUT).count();
+    const timeval receive_timeout{ static_cast<time_t>(timeout_us / 1000000), static_cast<suseconds_t>(timeout_us % 1000000) };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &receive_timeout, sizeof(receive_timeout));
+    const int enable = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+    uint64_t epoch = 0;
+    uint64_t applied_sequence = 0;
+    {
+        std::lock_guard lock(state_mutex_);
+        epoch = leader_epoch_;
+        applied_sequence = applied_sequence_;
+    }
+    std::string output;
+    const size_t frame_begin = BeginFrame(output);
+    WireWriter writer(output);
+    writer.WriteU8(static_cast<uint8_t>(ReplicationMessage::SUBSCRIBE));
+    writer.WriteU64(epoch);
+    writer.WriteU64(applied_sequence + 1);
+    EndFrame(output, frame_begin);
+    SendAll(fd, output);
+
+    std::string input;
+    while (true) {
+        const std::string payload = ReceiveFrame(fd, input);
+        WireReader reader(payload);
+        const auto message = static_cast<ReplicationMessage>(reader.ReadU8());
+        if (message == ReplicationMessage::MUTATION) {
+            Apply(ReadMutation(reader, epoch));
+        }
+        else if (message == ReplicationMessage::SNAPSHOT) {
+            const uint64_t snapshot_epoch = reader.ReadU64();
+            const uint64_t sequence = reader.ReadU64();
+            // Documents come in frames of their own, so the vector grows only with what arrives
+            const uint32_t document_count = reader.ReadU32();
+            std::vector<Mutation> documents;
+            for (uint32_t i = 0; i < document_count; ++i) {
+                const std::string document_payload = ReceiveFrame(fd, input);
+                WireReader document_reader(document_payload);
+                if (static_cast<ReplicationMessage>(document_reader.ReadU8()) != ReplicationMessage::MUTATION) {
+                    throw std::invalid_argument("Expected a snapshot document"s);
+                }
+                documents.push_back(ReadMutation(document_reader, snapshot_epoch));
+            }
+            ApplySnapshot(snapshot_epoch, sequence, documents);
+            epoch = snapshot_epoch;
+        }
+        else if (message != ReplicationMessage::HEARTBEAT) {
+            throw std::invalid_argument("Unexpected replication message"s);
+        }
+    }
+}
+
+void ReplicationFollower::Apply(const Mutation& mutation) {
+    {
+        std::unique_lock lock(index_mutex_);
+        try {
+            if (mutation.type == RequestType::ADD_DOCUMENT) {
+                search_server_.AddDocument(mutation.document_id, mutation.text, mutation.status, mutation.ratings);
+            }
+            else {
+                search_server_.RemoveDocument(mutation.document_id);
+            }
+        }
+        catch (const std::exception&) {
+            // The index has diverged from the leader
+            ResetAppliedState();
+            throw;
+        }
+    }
+    std::lock_guard lock(state_mutex_);
+    applied_sequence_ = mutation.sequence;
+    state_changed_.notify_all();
+}
+
+void ReplicationFollower::ApplySnapshot(uint64_t epoch, uint64_t sequence, const std::vector<Mutation>& documents) {
+    {
+        // Readers see either the old index or the whole snapshot
+        std::unique_lock lock(index_mutex_);
+        try {
+            search_server_.RemoveDocuments(std::vector<int>(search_server_.begin(), search_server_.end()));
+            for (const Mutation& document : documents) {
+                search_server_.AddDocument(document.document_id, document.text, document.status, document.ratings);
+            }
+        }
+        catch (const std::exception&) {
+            ResetAppliedState();
+            throw;
+        }
+    }
+    std::lock_guard lock(state_mutex_);
+    leader_epoch_ = epoch;
+    applied_sequence_ = sequence;
+    state_changed_.notify_all();
+}
+
+void ReplicationFollower::ResetAppliedState() {
+    std::lock_guard lock(state_mutex_);
+    leader_epoch_ = 0;
+    applied_sequence_ = 0;
+}
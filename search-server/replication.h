@@ -0,0 +1,154 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "search_server.h"
+#include "wire_protocol.h"
+
+// Leader/follower replication of a SearchServer (Linux only). The leader applies every
+// AddDocument and RemoveDocument, numbers it and keeps it in a mutation log. Followers subscribe
+// over TCP with the sequence number they need next and receive the log from there on. Every
+// leader picks a random epoch when it is created; sequence numbers are only comparable within
+// one epoch. A follower of another epoch (a restarted leader or none yet), behind the kept part
+// of the log or ahead of the leader first receives a snapshot: the live documents at some
+// sequence number, followed by the rest of the log.
+//
+// Messages are frames of wire_protocol.h, the payload starts with a ReplicationMessage:
+//   SUBSCRIBE  u64 epoch, u64 next_sequence                            follower to leader, once
+//   SNAPSHOT   u64 epoch, u64 sequence, u32 document_count             followed by document_count ADD mutations
+//   MUTATION   u64 epoch, u64 sequence, u8 RequestType, request body   ADD_DOCUMENT or REMOVE_DOCUMENT
+//   HEARTBEAT  u64 leader_sequence                                     sent when the log is idle
+enum class ReplicationMessage : uint8_t {
+    SUBSCRIBE = 1,
+    SNAPSHOT = 2,
+    MUTATION = 3,
+    HEARTBEAT = 4,
+};
+
+struct ReplicationOptions {
+    std::string address = "127.0.0.1";
+    // 0 picks a free port, see ReplicationLeader::GetPort
+    uint16_t port = 0;
+    // Older mutations are dropped, a follower behind them catches up from a snapshot
+    size_t max_log_size = 100000;
+};
+
+const std::chrono::milliseconds REPLICATION_HEARTBEAT_INTERVAL(500);
+// A follower reconnects when the leader is silent for longer
+const std::chrono::milliseconds REPLICATION_TIMEOUT(3 * REPLICATION_HEARTBEAT_INTERVAL);
+const std::chrono::milliseconds REPLICATION_RECONNECT_DELAY(100);
+
+struct Mutation {
+    uint64_t sequence = 0;
+    RequestType type = RequestType::ADD_DOCUMENT;
+    int document_id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+    std::string text;
+};
+
+// Writes go through the leader, which applies them to its SearchServer under GetIndexMutex
+// and ships them to the followers. Readers of the server take the mutex shared.
+class ReplicationLeader {
+public:
+    explicit ReplicationLeader(SearchServer& search_server, const ReplicationOptions& options = ReplicationOptions());
+    ~ReplicationLeader();
+
+    ReplicationLeader(const ReplicationLeader&) = delete;
+    ReplicationLeader& operator=(const ReplicationLeader&) = delete;
+
+    // Starts accepting followers, socket errors throw std::system_error
+    void Start();
+    void Stop();
+    uint16_t GetPort() const;
+
+    // Return the sequence number of the mutation. A mutation the server rejects throws and is not logged.
+    uint64_t AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    uint64_t RemoveDocument(int document_id);
+
+    uint64_t GetSequence() const;
+    uint64_t GetEpoch() const;
+    SearchServer& GetSearchServer();
+    std::shared_mutex& GetIndexMutex();
+
+private:
+    SearchServer& search_server_;
+    const ReplicationOptions options_;
+    // Random and never 0, which is the epoch of a follower that has not applied a snapshot yet
+    const uint64_t epoch_;
+    std::shared_mutex index_mutex_;
+
+    mutable std::mutex log_mutex_;
+    std::condition_variable log_changed_;
+    std::deque<Mutation> log_;
+    uint64_t sequence_ = 0;
+    bool stopping_ = false;
+
+    int listen_fd_ = -1;
+    int stop_fd_ = -1;
+    uint16_t port_ = 0;
+    std::thread accept_thread_;
+    std::mutex followers_mutex_;
+    std::vector<int> follower_fds_;
+    std::vector<std::thread> follower_threads_;
+
+    uint64_t AppendMutation(Mutation mutation);
+    void AcceptFollowers();
+    void ShipLog(int fd);
+    // Sends the documents of the server as a snapshot and returns its sequence number
+    uint64_t SendSnapshot(int fd);
+};
+
+// Applies the log of a leader to its SearchServer under GetIndexMutex, reconnecting when the
+// connection breaks. Readers of the server take the mutex shared.
+class ReplicationFollower {
+public:
+    ReplicationFollower(SearchServer& search_server, std::string leader_host, uint16_t leader_port);
+    ~ReplicationFollower();
+
+    ReplicationFollower(const ReplicationFollower&) = delete;
+    ReplicationFollower& operator=(const ReplicationFollower&) = delete;
+
+    void Start();
+    void Stop();
+
+    // Sequence number of the last mutation applied, 0 before the first one
+    uint64_t GetAppliedSequence() const;
+    // False if the mutation is not applied within the timeout
+    bool WaitForSequence(uint64_t sequence, std::chrono::steady_clock::duration timeout) const;
+
+    SearchServer& GetSearchServer();
+    std::shared_mutex& GetIndexMutex();
+
+private:
+    SearchServer& search_server_;
+    const std::string leader_host_;
+    const uint16_t leader_port_;
+    std::shared_mutex index_mutex_;
+
+    mutable std::mutex state_mutex_;
+    mutable std::condition_variable state_changed_;
+    uint64_t applied_sequence_ = 0;
+    // Epoch of the leader that applied_sequence_ belongs to
+    uint64_t leader_epoch_ = 0;
+    bool stopping_ = false;
+    // Connection to the leader, shut down by Stop to wake up the thread
+    int fd_ = -1;
+    std::thread thread_;
+
+    void Run();
+    void ReceiveLog(int fd);
+    void Apply(const Mutation& mutation);
+    void ApplySnapshot(uint64_t epoch, uint64_t sequence, const std::vector<Mutation>& documents);
+    // Forgets the applied state after a failed mutation, the next connection starts from a snapshot
+    void ResetAppliedState();
+};
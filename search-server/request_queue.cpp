@@ -26,4 +26,22 @@ void RequestQueue::RequestsControl(bool emptyResults) {
         }
         requests_.pop_front();
     }
-}
\ No newline at end of file
+}
+
+std::vector<Document> ConcurrentRequestQueue::AddFindRequest(const std::string_view raw_query, DocumentStatus status) {
+    std::vector<Document> search_results = search_server_.FindTopDocuments(raw_query, status);
+    statistics_.Record(search_results.size(), status);
+    return search_results;
+}
+
+std::vector<Document> ConcurrentRequestQueue::AddFindRequest(const std::string_view raw_query) {
+    return AddFindRequest(raw_query, DocumentStatus::ACTUAL);
+}
+
+int ConcurrentRequestQueue::GetNoResultRequests() const {
+    return static_cast<int>(statistics_.GetSnapshot(StatisticsWindow::DAY).empty_result_count);
+}
+
+RequestStatisticsSnapshot ConcurrentRequestQueue::GetStatistics(StatisticsWindow window) const {
+    return statistics_.GetSnapshot(window);
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include <deque>
 #include "search_server.h"
+#include "request_statistics.h"
 
 class RequestQueue {
 
@@ -34,4 +35,34 @@ std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query,
     std::vector<Document> SearchResults = search_server_.FindTopDocuments(raw_query, document_predicate);
     RequestsControl(SearchResults.empty());
     return SearchResults;
-}
\ No newline at end of file
+}
+
+// Thread-safe counterpart of RequestQueue: any number of threads may add requests at once,
+// statistics are kept over real time windows instead of the last 1440 requests
+class ConcurrentRequestQueue {
+public:
+    explicit ConcurrentRequestQueue(const SearchServer& search_server)
+        : search_server_(search_server)
+    {
+    }
+
+    template <typename DocumentPredicate>
+    std::vector<Document> AddFindRequest(const std::string_view raw_query, DocumentPredicate document_predicate);
+    std::vector<Document> AddFindRequest(const std::string_view raw_query, DocumentStatus status);
+    std::vector<Document> AddFindRequest(const std::string_view raw_query);
+
+    // Empty results during the last day
+    int GetNoResultRequests() const;
+    RequestStatisticsSnapshot GetStatistics(StatisticsWindow window) const;
+
+private:
+    const SearchServer& search_server_;
+    RequestStatistics statistics_;
+};
+
+template <typename DocumentPredicate>
+std::vector<Document> ConcurrentRequestQueue::AddFindRequest(const std::string_view raw_query, DocumentPredicate document_predicate) {
+    std::vector<Document> search_results = search_server_.FindTopDocuments(raw_query, document_predicate);
+    statistics_.Record(search_results.size(), std::nullopt);
+    return search_results;
+}
@@ -0,0 +1,103 @@
+#include "request_statistics.h"
+
+#include <algorithm>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+const std::array<RequestStatistics::Ring, 3> RequestStatistics::RINGS = { {
+    { 1s, 60, 0 },
+    { 1min, 60, 60 },
+    { 1h, 24, 120 },
+} };
+
+RequestStatistics::RequestStatistics(size_t shard_count, Clock::time_point start)
+    : start_(start)
+    , shard_count_(shard_count > 0 ? shard_count : std::max(1u, std::thread::hardware_concurrency()))
+    , shards_(new Shard[shard_count_])
+{
+}
+
+void RequestStatistics::Record(size_t result_count, std::optional<DocumentStatus> status_filter, Clock::time_point now) {
+    Shard& shard = GetThreadShard();
+    const auto elapsed = now - start_;
+    const size_t result_slot = std::min(result_count, RESULT_COUNT_SLOTS - 1);
+    const size_t status_slot = status_filter ? static_cast<size_t>(*status_filter) : STATUS_FILTER_SLOTS - 1;
+
+    for (const Ring& ring : RINGS) {
+        const int64_t tick = elapsed / ring.granularity;
+        Bucket& bucket = shard.buckets[ring.first_bucket + tick % ring.bucket_count];
+
+        int64_t bucket_tick = bucket.tick.load(std::memory_order_acquire);
+        while (bucket_tick != tick) {
+            if (bucket_tick > tick) {
+                // Another thread of this shard has already moved on to a period a whole ring later
+                break;
+            }
+            if (bucket_tick == RESETTING_TICK) {
+                std::this_thread::yield();
+                bucket_tick = bucket.tick.load(std::memory_order_acquire);
+                continue;
+            }
+            if (bucket.tick.compare_exchange_weak(bucket_tick, RESETTING_TICK, std::memory_order_acq_rel)) {
+                for (auto& counter : bucket.counters) {
+                    counter.store(0, std::memory_order_relaxed);
+                }
+                bucket.tick.store(tick, std::memory_order_release);
+                bucket_tick = tick;
+            }
+        }
+        if (bucket_tick != tick) {
+            continue;
+        }
+
+        bucket.counters[REQUESTS_COUNTER].fetch_add(1, std::memory_order_relaxed);
+        if (result_count == 0) {
+            bucket.counters[EMPTY_COUNTER].fetch_add(1, std::memory_order_relaxed);
+        }
+        bucket.counters[RESULT_COUNT_COUNTER + result_slot].fetch_add(1, std::memory_order_relaxed);
+        bucket.counters[STATUS_FILTER_COUNTER + status_slot].fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+RequestStatisticsSnapshot RequestStatistics::GetSnapshot(StatisticsWindow window, Clock::time_point now) const {
+    const Ring& ring = RINGS[static_cast<size_t>(window)];
+    const auto elapsed = now - start_;
+    const int64_t current_tick = elapsed / ring.granularity;
+    const int64_t oldest_tick = current_tick - static_cast<int64_t>(ring.bucket_count) + 1;
+
+    std::array<uint64_t, COUNTER_COUNT> totals = {};
+    for (size_t shard_index = 0; shard_index < shard_count_; ++shard_index) {
+        for (size_t i = 0; i < ring.bucket_count; ++i) {
+            const Bucket& bucket = shards_[shard_index].buckets[ring.first_bucket + i];
+            const int64_t tick = bucket.tick.load(std::memory_order_acquire);
+            if (tick < oldest_tick || tick > current_tick) {
+                continue;
+            }
+            for (size_t counter = 0; counter < COUNTER_COUNT; ++counter) {
+                totals[counter] += bucket.counters[counter].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    RequestStatisticsSnapshot snapshot;
+    snapshot.window = std::chrono::duration_cast<std::chrono::seconds>(ring.granularity * ring.bucket_count);
+    snapshot.request_count = totals[REQUESTS_COUNTER];
+    snapshot.empty_result_count = totals[EMPTY_COUNTER];
+    std::copy_n(totals.begin() + RESULT_COUNT_COUNTER, RESULT_COUNT_SLOTS, snapshot.result_count_distribution.begin());
+    std::copy_n(totals.begin() + STATUS_FILTER_COUNTER, STATUS_FILTER_SLOTS, snapshot.status_filter_counts.begin());
+
+    if (snapshot.request_count > 0) {
+        snapshot.empty_result_rate = snapshot.empty_result_count * 1.0 / snapshot.request_count;
+    }
+    // Right after start the window is not filled yet, so the rate uses the time actually covered
+    const double seconds = std::max(1.0, std::min<double>(snapshot.window.count(), std::chrono::duration<double>(elapsed).count()));
+    snapshot.queries_per_second = snapshot.request_count / seconds;
+    return snapshot;
+}
+
+RequestStatistics::Shard& RequestStatistics::GetThreadShard() {
+    static std::atomic<size_t> next_thread_index{ 0 };
+    thread_local const size_t thread_index = next_thread_index.fetch_add(1, std::memory_order_relaxed);
+    return shards_[thread_index % shard_count_];
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+#include "document.h"
+
+// Number of distinct result counts tracked: 0..MAX_RESULT_DOCUMENT_COUNT (larger counts share the last slot)
+const size_t RESULT_COUNT_SLOTS = 6;
+// Status filters: one slot per DocumentStatus plus one for custom predicates
+const size_t STATUS_FILTER_SLOTS = 5;
+
+enum class StatisticsWindow {
+    MINUTE,
+    HOUR,
+    DAY,
+};
+
+struct RequestStatisticsSnapshot {
+    std::chrono::seconds window{ 0 };
+    uint64_t request_count = 0;
+    uint64_t empty_result_count = 0;
+    double empty_result_rate = 0.0;
+    double queries_per_second = 0.0;
+    // result_count_distribution[k] - requests that returned k documents
+    std::array<uint64_t, RESULT_COUNT_SLOTS> result_count_distribution = {};
+    // status_filter_counts[static_cast<int>(status)] - requests filtered by status, the last slot - by predicate
+    std::array<uint64_t, STATUS_FILTER_SLOTS> status_filter_counts = {};
+};
+
+// Request statistics over real time windows that many threads can record into concurrently.
+// Every thread writes into its own shard (no shared lock); a shard keeps ring buffers of
+// time buckets: 60 x 1 second, 60 x 1 minute and 24 x 1 hour.
+// A bucket is recycled by the first writer that sees it is outdated: it marks the bucket as being
+// reset, zeroes the counters and only then publishes the new period, so no increment of the new
+// period is wiped out. Writers that meet the mark wait the few stores it takes, readers skip it.
+class RequestStatistics {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // shard_count = 0 picks one shard per hardware thread
+    explicit RequestStatistics(size_t shard_count = 0, Clock::time_point start = Clock::now());
+
+    // status_filter is empty when the request used a custom document predicate
+    void Record(size_t result_count, std::optional<DocumentStatus> status_filter, Clock::time_point now = Clock::now());
+
+    RequestStatisticsSnapshot GetSnapshot(StatisticsWindow window, Clock::time_point now = Clock::now()) const;
+
+private:
+    static const size_t COUNTER_COUNT = 2 + RESULT_COUNT_SLOTS + STATUS_FILTER_SLOTS;
+    static const size_t REQUESTS_COUNTER = 0;
+    static const size_t EMPTY_COUNTER = 1;
+    static const size_t RESULT_COUNT_COUNTER = 2;
+    static const size_t STATUS_FILTER_COUNTER = RESULT_COUNT_COUNTER + RESULT_COUNT_SLOTS;
+
+    // Tick of a bucket whose counters are being zeroed
+    static const int64_t RESETTING_TICK = -2;
+
+    struct Bucket {
+        std::atomic<int64_t> tick{ -1 };
+        std::array<std::atomic<uint64_t>, COUNTER_COUNT> counters = {};
+    };
+
+    struct Ring {
+        std::chrono::seconds granularity;
+        size_t bucket_count;
+        size_t first_bucket;
+    };
+    static const std::array<Ring, 3> RINGS;
+    static const size_t BUCKETS_PER_SHARD = 60 + 60 + 24;
+
+    struct alignas(64) Shard {
+        std::array<Bucket, BUCKETS_PER_SHARD> buckets;
+    };
+
+    const Clock::time_point start_;
+    const size_t shard_count_;
+    std::unique_ptr<Shard[]> shards_;
+
+    Shard& GetThreadShard();
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Index-wide numbers a scoring policy needs, taken once per query
+struct CollectionStatistics {
+    size_t document_count = 0;
+    double average_document_length = 0.0;
+};
+
+// Scoring policies of the query path. A policy is a small value passed as a template argument;
+// Prepare folds the collection statistics into a scorer whose IDF and Score calls are inlined
+// into the posting loops, so the choice of policy costs nothing per posting.
+// term_freq is the share of the word in the document, document_length counts words without stop words.
+
+// Classic TF-IDF, the default ranking of SearchServer
+struct TfIdfScoring {
+    struct Scorer {
+        double document_count;
+
+        double ComputeIdf(size_t document_freq) const {
+            return std::log(document_count / document_freq);
+        }
+
+        double Score(double term_freq, uint32_t /*document_length*/, double inverse_document_freq) const {
+            return term_freq * inverse_document_freq;
+        }
+    };
+
+    Scorer Prepare(const CollectionStatistics& statistics) const {
+        return { static_cast<double>(statistics.document_count) };
+    }
+};
+
+// Okapi BM25: term frequency saturates with k1, b controls how much long documents are penalized
+struct Bm25Scoring {
+    double k1 = 1.2;
+    double b = 0.75;
+
+    struct Scorer {
+        double document_count;
+        double k1;
+        // k1 * (1 - b + b * length / average_length) == length_norm_base + length_norm_slope * length
+        double length_norm_base;
+        double length_norm_slope;
+
+        double ComputeIdf(size_t document_freq) const {
+            return std::log(1.0 + (document_count - document_freq + 0.5) / (document_freq + 0.5));
+        }
+
+        double Score(double term_freq, uint32_t document_length, double inverse_document_freq) const {
+            const double count = term_freq * document_length;
+            return inverse_document_freq * count * (k1 + 1.0) / (count + length_norm_base + length_norm_slope * document_length);
+        }
+    };
+
+    Scorer Prepare(const CollectionStatistics& statistics) const {
+        const double average_length = statistics.average_document_length > 0 ? statistics.average_document_length : 1.0;
+        return { static_cast<double>(statistics.document_count), k1, k1 * (1.0 - b), k1 * b / average_length };
+    }
+};
+
+// Document frequencies of the terms of one query. An index split into shards ranks
+// with the sum of the statistics of its shards, so relevance does not depend on the split.
+struct QueryStatistics {
+    CollectionStatistics collection;
+    // Documents containing each plus word, in the order of QueryContext::plus_words
+    std::vector<size_t> word_freqs;
+    // Documents matched by each prefix or fuzzy expansion of the query
+    std::vector<size_t> expansion_freqs;
+};
+
+// Document frequency a shard ranks a term with: the global one, but never below the shard's own,
+// so statistics that missed a write cannot turn the IDF into log(N / 0)
+inline size_t GetGlobalDocumentFreq(const std::vector<size_t>& global_freqs, size_t index, size_t local_freq) {
+    return std::max(global_freqs.at(index), local_freq);
+}
+
+// Adds statistics of a shard with disjoint documents to total
+inline void AddQueryStatistics(QueryStatistics& total, const QueryStatistics& shard) {
+    const size_t document_count = total.collection.document_count + shard.collection.document_count;
+    if (document_count > 0) {
+        total.collection.average_document_length =
+            (total.collection.average_document_length * total.collection.document_count
+                + shard.collection.average_document_length * shard.collection.document_count) / document_count;
+    }
+    total.collection.document_count = document_count;
+
+    total.word_freqs.resize(std::max(total.word_freqs.size(), shard.word_freqs.size()));
+    for (size_t i = 0; i < shard.word_freqs.size(); ++i) {
+        total.word_freqs[i] += shard.word_freqs[i];
+    }
+    total.expansion_freqs.resize(std::max(total.expansion_freqs.size(), shard.expansion_freqs.size()));
+    for (size_t i = 0; i < shard.expansion_freqs.size(); ++i) {
+        total.expansion_freqs[i] += shard.expansion_freqs[i];
+    }
+}
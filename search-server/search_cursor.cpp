@@ -0,0 +1,118 @@
+#include "search_cursor.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std::string_literals;
+
+std::string SearchCursor::ToString() const {
+    uint64_t relevance_bits;
+    std::memcpy(&relevance_bits, &relevance, sizeof(relevance_bits));
+    std::ostringstream token;
+    token << std::hex << relevance_bits << '.' << std::dec << rating << '.' << id;
+    return token.str();
+}
+
+SearchCursor SearchCursor::FromString(std::string_view token) {
+    std::istringstream input{ std::string(token) };
+    uint64_t relevance_bits = 0;
+    char first_dot = 0;
+    char second_dot = 0;
+    SearchCursor cursor;
+    input >> std::hex >> relevance_bits >> first_dot >> std::dec >> cursor.rating >> second_dot >> cursor.id;
+    if (!input || first_dot != '.' || second_dot != '.' || input.peek() != std::char_traits<char>::eof()) {
+        throw std::invalid_argument("Invalid search cursor \""s + std::string(token) + "\""s);
+    }
+    std::memcpy(&cursor.relevance, &relevance_bits, sizeof(relevance_bits));
+    return cursor;
+}
+
+namespace {
+
+SearchCursor MakeCursor(const Document& document) {
+    return { document.relevance, document.rating, document.id };
+}
+
+}
+
+SearchPage SelectPage(std::vector<Document> documents, const SearchCursor& after, size_t page_size, double eps) {
+    const auto ranked_before = [eps](const Document& lhs, const Document& rhs) {
+        return IsRankedBefore(lhs.relevance, lhs.rating, lhs.id, rhs.relevance, rhs.rating, rhs.id, eps);
+    };
+    documents.erase(std::remove_if(documents.begin(), documents.end(),
+        [&after, eps](const Document& document) { return !IsAfterCursor(document, after, eps); }),
+        documents.end());
+
+    SearchPage page;
+    if (documents.size() > page_size) {
+        std::nth_element(documents.begin(), documents.begin() + page_size, documents.end(), ranked_before);
+        documents.resize(page_size);
+        std::sort(documents.begin(), documents.end(), ranked_before);
+        if (!documents.empty()) {
+            page.next_cursor = MakeCursor(documents.back());
+        }
+    }
+    else {
+        std::sort(documents.begin(), documents.end(), ranked_before);
+    }
+    page.documents = std::move(documents);
+    return page;
+}
+
+SearchPage SelectRankedPage(const std::vector<Document>& ranked, const SearchCursor& after, size_t page_size, double eps) {
+    const auto first = std::partition_point(ranked.begin(), ranked.end(),
+        [&after, eps](const Document& document) { return !IsAfterCursor(document, after, eps); });
+    const auto last = ranked.end() - first > static_cast<std::ptrdiff_t>(page_size) ? first + page_size : ranked.end();
+
+    SearchPage page;
+    page.documents.assign(first, last);
+    if (last != ranked.end() && !page.documents.empty()) {
+        page.next_cursor = MakeCursor(page.documents.back());
+    }
+    return page;
+}
+
+SearchResultCache::SearchResultCache(size_t capacity, Clock::duration ttl)
+    : capacity_(capacity)
+    , ttl_(ttl) {
+}
+
+SearchResultCache::RankedDocuments SearchResultCache::Find(const std::string& key, uint64_t generation, Clock::time_point now) {
+    std::lock_guard guard(mutex_);
+    const auto it = entries_.find(key);
+    if (it == entries_.end()) {
+        return nullptr;
+    }
+    if (it->second.generation != generation || now - it->second.created > ttl_) {
+        ages_.erase(it->second.age_it);
+        entries_.erase(it);
+        return nullptr;
+    }
+    return it->second.documents;
+}
+
+void SearchResultCache::Insert(const std::string& key, uint64_t generation, RankedDocuments documents, Clock::time_point now) {
+    if (capacity_ == 0) {
+        return;
+    }
+    std::lock_guard guard(mutex_);
+    const auto it = entries_.find(key);
+    if (it != entries_.end()) {
+        ages_.erase(it->second.age_it);
+        entries_.erase(it);
+    }
+    while (entries_.size() >= capacity_) {
+        entries_.erase(ages_.front());
+        ages_.pop_front();
+    }
+    const auto age_it = ages_.insert(ages_.end(), key);
+    entries_.emplace(key, Entry{ std::move(documents), generation, now, age_it });
+}
+
+void SearchResultCache::Clear() {
+    std::lock_guard guard(mutex_);
+    entries_.clear();
+    ages_.clear();
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "document.h"
+
+// Position in a ranked result list: the last document of the previous page.
+// An empty cursor (id < 0) means the first page.
+struct SearchCursor {
+    double relevance = 0.0;
+    int rating = 0;
+    int id = -1;
+
+    bool IsStart() const {
+        return id < 0;
+    }
+
+    // Opaque token for clients, parsed back by FromString
+    std::string ToString() const;
+    // Throws std::invalid_argument for a malformed token
+    static SearchCursor FromString(std::string_view token);
+};
+
+struct SearchPage {
+    std::vector<Document> documents;
+    // Set when there are documents ranked after the last one of this page
+    std::optional<SearchCursor> next_cursor;
+};
+
+// Relevances within EPS of each other rank equally. Relevance is compared by its EPS-sized
+// bucket, which unlike a plain EPS comparison is a strict weak ordering that a cursor can rely on.
+inline int64_t GetRelevanceRank(double relevance, double eps) {
+    return std::llround(relevance / eps);
+}
+
+// Ranking of search results: relevance descending, then rating descending, then id ascending
+inline bool IsRankedBefore(double lhs_relevance, int lhs_rating, int lhs_id, double rhs_relevance, int rhs_rating, int rhs_id, double eps) {
+    const int64_t lhs_rank = GetRelevanceRank(lhs_relevance, eps);
+    const int64_t rhs_rank = GetRelevanceRank(rhs_relevance, eps);
+    if (lhs_rank != rhs_rank) {
+        return lhs_rank > rhs_rank;
+    }
+    if (lhs_rating != rhs_rating) {
+        return lhs_rating > rhs_rating;
+    }
+    return lhs_id < rhs_id;
+}
+
+inline bool IsAfterCursor(const Document& document, const SearchCursor& cursor, double eps) {
+    return cursor.IsStart()
+        || IsRankedBefore(cursor.relevance, cursor.rating, cursor.id, document.relevance, document.rating, document.id, eps);
+}
+
+// Keeps the page_size best documents ranked after the cursor, in rank order, and builds the page.
+// Costs O(n + page_size * log(page_size)) instead of sorting all matches.
+SearchPage SelectPage(std::vector<Document> documents, const SearchCursor& after, size_t page_size, double eps);
+
+// Short-lived cache of fully ranked result lists, so consecutive pages of one query cost
+// a binary search. Entries expire after ttl or when the index generation changes.
+class SearchResultCache {
+public:
+    using Clock = std::chrono::steady_clock;
+    using RankedDocuments = std::shared_ptr<const std::vector<Document>>;
+
+    SearchResultCache(size_t capacity, Clock::duration ttl);
+
+    RankedDocuments Find(const std::string& key, uint64_t generation, Clock::time_point now = Clock::now());
+    void Insert(const std::string& key, uint64_t generation, RankedDocuments documents, Clock::time_point now = Clock::now());
+    void Clear();
+
+private:
+    struct Entry {
+        RankedDocuments documents;
+        uint64_t generation;
+        Clock::time_point created;
+        std::list<std::string>::iterator age_it;
+    };
+
+    const size_t capacity_;
+    const Clock::duration ttl_;
+    std::mutex mutex_;
+    std::unordered_map<std::string, Entry> entries_;
+    // Keys from the oldest to the newest insertion
+    std::list<std::string> ages_;
+};
+
+// A page out of a fully ranked list
+SearchPage SelectRankedPage(const std::vector<Document>& ranked, const SearchCursor& after, size_t page_size, double eps);
@@ -7,20 +7,29 @@
 #include "read_input_functions.h"
 #include <chrono>
 
-void SearchServer::AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+template <typename Traits>
+void BasicSearchServer<Traits>::AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    MetricsScope metrics(MetricsEntryPoint::ADD_DOCUMENT);
  
     using namespace std::string_literals;
  
     if (document_id < 0)
         throw std::invalid_argument("ID \""s + std::to_string(document_id) + "\" is negative"s);
+
+    if (!FitsDocumentId(document_id))
+        throw std::out_of_range("ID \""s + std::to_string(document_id) + "\" does not fit the document id type"s);
  
     if (documents_.count(document_id) > 0)
         throw std::invalid_argument("ID \""s + std::to_string(document_id) + "\" is present in database"s);
  
-    auto it_of_document = doc_content_.emplace(doc_content_.end(), std::move(std::string(document)));
+    ++generation_;
+    auto it_of_document = doc_content_.emplace(doc_content_.end(), document);
+    const size_t content_heap_size = GetStringHeapSize(*it_of_document);
+    content_heap_usage_.AddAllocations(content_heap_size > 0 ? 1 : 0, content_heap_size);
 
     const std::vector<std::string_view> words_in_doc = SplitIntoWordsNoStopSV(doc_content_.back());
  
+    std::pmr::vector<int> term_ids(GetMemoryResource());
     if (words_in_doc.size() != 0) {
         for (const auto word : words_in_doc) {
             if (!IsValidWordSV(word)) {
@@ -28,168 +37,877 @@ void SearchServer::AddDocument(int document_id, const std::string_view document,
             } 
         }
  
-        const double fract_freq = 1.0 / words_in_doc.size();
- 
-        for (const auto word : words_in_doc) {
-            word_to_document_freqs_SV_[word][document_id] += fract_freq;
-            id_to_document_freqs_SV_[document_id][word] += fract_freq;
+        ScratchArena arena;
+        std::pmr::vector<std::string_view> sorted_words(words_in_doc.begin(), words_in_doc.end(), arena.Get());
+        std::sort(sorted_words.begin(), sorted_words.end());
+        for (auto it = sorted_words.begin(); it != sorted_words.end();) {
+            const auto run_end = std::upper_bound(it, sorted_words.end(), *it);
+            const uint32_t occurrences = static_cast<uint32_t>(run_end - it);
+            PostingList& postings = word_to_document_freqs_SV_[*it];
+            postings_heap_usage_.RemoveBytes(postings.GetHeapUsage());
+            postings.Add(document_id, occurrences);
+            postings_heap_usage_.AddBytes(postings.GetHeapUsage());
+            term_ids.push_back(GetOrAddTermId(*it));
+            it = run_end;
         }
+        term_ids.shrink_to_fit();
+        std::sort(term_ids.begin(), term_ids.end());
+        posting_count_ += term_ids.size();
+        total_document_length_ += words_in_doc.size();
+        term_ids_heap_usage_.AddAllocations(1, term_ids.capacity() * sizeof(int));
+    }
+
+    DocumentPositions positions;
+    if (positional_index_enabled_) {
+        positions = BuildDocumentPositions(words_in_doc, term_ids);
     }
  
-    documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status, it_of_document });
+    documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status, it_of_document, std::move(term_ids), static_cast<uint32_t>(words_in_doc.size()), std::move(positions) });
     id_of_documents_.insert(document_id);
 }
  
-std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const {
-    return FindTopDocuments(raw_query, [status](int document_id, DocumentStatus d_status, int rating) { return d_status == status; });
+template <typename Traits>
+std::vector<typename BasicSearchServer<Traits>::DocumentType> BasicSearchServer<Traits>::FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const {
+    return FindTopDocuments(raw_query, [status](DocumentId document_id, DocumentStatus d_status, int rating) { return d_status == status; });
 }
  
-std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query) const {
+template <typename Traits>
+std::vector<typename BasicSearchServer<Traits>::DocumentType> BasicSearchServer<Traits>::FindTopDocuments(const std::string_view raw_query) const {
     return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
 }
+
+template <typename Traits>
+std::vector<typename BasicSearchServer<Traits>::DocumentType> BasicSearchServer<Traits>::FindTopDocuments(const QueryContext& query, DocumentStatus status) const {
+    return FindTopDocuments(query, [status](DocumentId document_id, DocumentStatus d_status, int rating) { return d_status == status; });
+}
  
-int SearchServer::GetDocumentCount() const {
+template <typename Traits>
+int BasicSearchServer<Traits>::GetDocumentCount() const {
     return documents_.size();
 }
  
-std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::string_view raw_query, int document_id) const {
+template <typename Traits>
+std::tuple<std::vector<std::string_view>, DocumentStatus> BasicSearchServer<Traits>::MatchDocument(const std::string_view raw_query, int document_id) const {
     return MatchDocument(std::execution::seq, raw_query, document_id);
 }
 
-std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::execution::sequenced_policy, const std::string_view raw_query, int document_id) const {
+template <typename Traits>
+std::tuple<std::vector<std::string_view>, DocumentStatus> BasicSearchServer<Traits>::MatchDocument(std::execution::sequenced_policy, const std::string_view raw_query, int document_id) const {
+    MetricsScope metrics(MetricsEntryPoint::MATCH_DOCUMENT);
+    QueryContext query;
+    PrepareQuery(raw_query, query);
+    return MatchDocument(std::execution::seq, query, document_id);
+}
+
+template <typename Traits>
+std::tuple<std::vector<std::string_view>, DocumentStatus> BasicSearchServer<Traits>::MatchDocument(std::execution::parallel_policy, const std::string_view raw_query, int document_id) const {
+    MetricsScope metrics(MetricsEntryPoint::MATCH_DOCUMENT);
+    QueryContext query;
+    PrepareQuery(raw_query, query);
+    return MatchDocument(std::execution::par, query, document_id);
+}
+
+template <typename Traits>
+std::tuple<std::vector<std::string_view>, DocumentStatus> BasicSearchServer<Traits>::MatchDocument(const QueryContext& query, int document_id) const {
+    return MatchDocument(std::execution::seq, query, document_id);
+}
+
+template <typename Traits>
+std::tuple<std::vector<std::string_view>, DocumentStatus> BasicSearchServer<Traits>::MatchDocument(std::execution::sequenced_policy, const QueryContext& query, int document_id) const {
+    MetricsScope metrics(MetricsEntryPoint::MATCH_DOCUMENT);
     
-    if (documents_.count(document_id) == 0) {
+    if (!FitsDocumentId(document_id) || documents_.count(document_id) == 0) {
         throw std::out_of_range("Invalid document_id");
     }
 
-    const QuerySV query = ParseQuerySV(raw_query);
-    std::vector<std::string_view> matched_words = {};
+    const DocumentData& document = documents_.at(document_id);
+    const DocumentStatus status = document.status;
 
     for (const auto word : query.minus_words) {
-        if (word_to_document_freqs_SV_.count(word) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_SV_.at(word).count(document_id)) {
-            return{ {}, documents_.at(document_id).status };
+        if (HasTerm(document, word)) {
+            return { std::vector<std::string_view>(), status };
         }
     }
+    if (!MatchesPhrases(query, document)) {
+        return { std::vector<std::string_view>(), status };
+    }
 
+    std::vector<std::string_view> matched_words;
     for (const auto word : query.plus_words) {
-        if (word_to_document_freqs_SV_.count(word) == 0) {
-            continue;
-        }
-        if (word_to_document_freqs_SV_.at(word).count(document_id)) {
+        if (HasTerm(document, word)) {
             matched_words.push_back(word);
         }
     }
+    AppendExpandedMatches(query, GetFuzzyWords(query), document, matched_words);
     
-    return { matched_words, documents_.at(document_id).status };
+    return { matched_words, status };
 }
 
-std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::execution::parallel_policy, const std::string_view raw_query, int document_id) const {
- 
-    if (documents_.count(document_id) == 0 ) {
-		throw std::out_of_range("Invalid document_id");
-	}
- 
-    const auto query = ParseQuerySV(raw_query);
- 	std::vector<std::string_view> matched_words(query.plus_words.size());
-
-     auto ptr = &id_to_document_freqs_SV_.at(document_id);
-     	if (std::any_of(std::execution::par,
-                    query.minus_words.begin(),
-                    query.minus_words.end(),
-                    [ptr](auto word) { return ptr->count(word);})) {
-		    return { {}, documents_.at(document_id).status };
-	    }
- 
-	std::copy_if(std::execution::par, 
-                    query.plus_words.begin(),
-                    query.plus_words.end(),
-                    matched_words.begin(),
-		            [ptr](auto& word) {	return ptr->count(word);});
+template <typename Traits>
+std::tuple<std::vector<std::string_view>, DocumentStatus> BasicSearchServer<Traits>::MatchDocument(std::execution::parallel_policy, const QueryContext& query, int document_id) const {
+    // Each query word costs one binary search over the term ids of the document, far less than
+    // handing the word to another thread, so the parallel overload runs the sequential loops
+    return MatchDocument(std::execution::seq, query, document_id);
+}
  
-	std::sort(matched_words.begin(), matched_words.end());
-	auto word_end = std::unique(matched_words.begin(), matched_words.end());
-    matched_words.erase(word_end, matched_words.end());
+template <typename Traits>
+std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> BasicSearchServer<Traits>::MatchDocuments(const std::string_view raw_query, const std::vector<DocumentId>& document_ids) const {
+    MetricsScope metrics(MetricsEntryPoint::MATCH_DOCUMENTS);
+    QueryContext query;
+    PrepareQuery(raw_query, query);
+    return MatchDocuments(query, document_ids);
+}
 
-	if (matched_words[0].empty()) {
-		matched_words.erase(matched_words.begin());
-	}
+namespace {
 
-	return { matched_words, documents_.at(document_id).status };
- 
+// Smallest chunks of the executor loops, a chunk should outweigh the cost of handing it to another thread
+const size_t MATCH_DOCUMENTS_GRAIN_SIZE = 16;
+const size_t REMOVE_DOCUMENT_GRAIN_SIZE = 256;
+
+// Calls callback(position_in_query) for every element of query_terms that is present in document_terms.
+// Both ranges must be sorted by term id. Short queries against long documents use galloping search,
+// comparable sizes use a plain merge.
+template <typename Callback>
+void IntersectTermIds(const std::vector<std::pair<int, std::string_view>>& query_terms, const std::pmr::vector<int>& document_terms, Callback callback) {
+    if (query_terms.empty() || document_terms.empty()) {
+        return;
+    }
+    if (query_terms.size() * 8 < document_terms.size()) {
+        auto low = document_terms.begin();
+        for (size_t i = 0; i < query_terms.size() && low != document_terms.end(); ++i) {
+            const int term_id = query_terms[i].first;
+            size_t step = 1;
+            auto high = low;
+            while (high != document_terms.end() && *high < term_id) {
+                low = high;
+                high = static_cast<size_t>(document_terms.end() - high) > step ? high + step : document_terms.end();
+                step *= 2;
+            }
+            low = std::lower_bound(low, high, term_id);
+            if (low != document_terms.end() && *low == term_id) {
+                callback(i);
+            }
+        }
+    }
+    else {
+        size_t i = 0;
+        auto it = document_terms.begin();
+        while (i < query_terms.size() && it != document_terms.end()) {
+            if (query_terms[i].first < *it) {
+                ++i;
+            }
+            else if (*it < query_terms[i].first) {
+                ++it;
+            }
+            else {
+                callback(i);
+                ++i;
+                ++it;
+            }
+        }
+    }
 }
- 
-int SearchServer::GetStopWordsCount() const {
+
+}
+
+template <typename Traits>
+std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> BasicSearchServer<Traits>::MatchDocuments(const QueryContext& query, const std::vector<DocumentId>& document_ids) const {
+    MetricsScope metrics(MetricsEntryPoint::MATCH_DOCUMENTS);
+    std::vector<const DocumentData*> documents(document_ids.size());
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        const auto it = documents_.find(document_ids[i]);
+        if (it == documents_.end()) {
+            throw std::out_of_range("Invalid document_id");
+        }
+        documents[i] = &it->second;
+    }
+
+    metrics.AddDocumentsScored(documents.size());
+
+    const auto plus_terms = GetQueryTermIds(query.plus_words);
+    const auto minus_terms = GetQueryTermIds(query.minus_words);
+    const auto fuzzy_words = GetFuzzyWords(query);
+
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> result(documents.size());
+    GetExecutor().ParallelFor(0, documents.size(), MATCH_DOCUMENTS_GRAIN_SIZE,
+        [&](size_t i) {
+            const DocumentData* document = documents[i];
+            auto& match = result[i];
+            match = { std::vector<std::string_view>(), document->status };
+
+            bool has_minus_word = false;
+            IntersectTermIds(minus_terms, document->term_ids, [&has_minus_word](size_t) { has_minus_word = true; });
+            if (has_minus_word || !MatchesPhrases(query, *document)) {
+                return;
+            }
+
+            auto& matched_words = std::get<0>(match);
+            IntersectTermIds(plus_terms, document->term_ids, [&matched_words, &plus_terms](size_t i) { matched_words.push_back(plus_terms[i].second); });
+            if (!query.prefix_words.empty() || !fuzzy_words.empty()) {
+                AppendExpandedMatches(query, fuzzy_words, *document, matched_words);
+            }
+            std::sort(matched_words.begin(), matched_words.end());
+        });
+
+    return result;
+}
+
+template <typename Traits>
+int BasicSearchServer<Traits>::GetStopWordsCount() const {
     return stop_words_.size();
 }
+
+template <typename Traits>
+std::vector<std::string> BasicSearchServer<Traits>::GetStopWords() const {
+    return std::vector<std::string>(stop_words_.begin(), stop_words_.end());
+}
+
+template <typename Traits>
+StoredDocument BasicSearchServer<Traits>::GetStoredDocument(int document_id) const {
+    if (!FitsDocumentId(document_id)) {
+        throw std::out_of_range("Invalid document_id");
+    }
+    const DocumentData& document = documents_.at(document_id);
+    return { document_id, *document.it_of_document, document.status, document.rating };
+}
  
-std::set<int>::iterator SearchServer::begin() {
+template <typename Traits>
+typename std::pmr::set<typename BasicSearchServer<Traits>::DocumentId>::iterator BasicSearchServer<Traits>::begin() {
     return id_of_documents_.begin();
 }
  
-std::set<int>::iterator SearchServer::end() {
+template <typename Traits>
+typename std::pmr::set<typename BasicSearchServer<Traits>::DocumentId>::iterator BasicSearchServer<Traits>::end() {
+    return id_of_documents_.end();
+}
+
+template <typename Traits>
+typename std::pmr::set<typename BasicSearchServer<Traits>::DocumentId>::const_iterator BasicSearchServer<Traits>::begin() const {
+    return id_of_documents_.begin();
+}
+
+template <typename Traits>
+typename std::pmr::set<typename BasicSearchServer<Traits>::DocumentId>::const_iterator BasicSearchServer<Traits>::end() const {
     return id_of_documents_.end();
 }
  
-const std::map<std::string_view, double, std::less<>>& SearchServer::GetWordFrequencies(int document_id) const {
-    static const std::map<std::string_view, double, std::less<>> document_freqs_if_id_absent_;
+template <typename Traits>
+typename BasicSearchServer<Traits>::WordFrequencies BasicSearchServer<Traits>::GetWordFrequencies(int document_id) const {
+    WordFrequencies word_freqs;
+    if (!FitsDocumentId(document_id)) {
+        return word_freqs;
+    }
+    const auto it = documents_.find(document_id);
+    if (it == documents_.end()) {
+        return word_freqs;
+    }
+    const DocumentData& document = it->second;
+    for (const int term_id : document.term_ids) {
+        const std::string_view word = term_id_to_word_[term_id];
+        // Only the block holding the document is decoded
+        word_to_document_freqs_SV_.at(word).ForEachInRange(document_id, document_id, [&](int, uint32_t occurrences) {
+            word_freqs.emplace(word, Traits::MakeTermFreq(occurrences, document.length));
+            return false;
+        });
+    }
+    return word_freqs;
+}
  
-    if (id_to_document_freqs_SV_.count(document_id)) {
-        return id_to_document_freqs_SV_.at(document_id) ;
+template <typename Traits>
+CollectionStatistics BasicSearchServer<Traits>::GetCollectionStatistics() const {
+    CollectionStatistics statistics;
+    statistics.document_count = documents_.size();
+    if (!documents_.empty()) {
+        statistics.average_document_length = static_cast<double>(total_document_length_) / documents_.size();
+    }
+    return statistics;
+}
+
+template <typename Traits>
+size_t BasicSearchServer<Traits>::GetDocumentFreq(const std::string_view word) const {
+    const auto it = word_to_document_freqs_SV_.find(word);
+    return it == word_to_document_freqs_SV_.end() ? 0 : it->second.size();
+}
+
+template <typename Traits>
+const std::pmr::vector<int>& BasicSearchServer<Traits>::GetDocumentTermIds(int document_id) const {
+    static const std::pmr::vector<int> term_ids_if_id_absent_;
+
+    const auto it = FitsDocumentId(document_id) ? documents_.find(document_id) : documents_.end();
+    if (it != documents_.end()) {
+        return it->second.term_ids;
     }
     else {
-        return document_freqs_if_id_absent_;
+        return term_ids_if_id_absent_;
     }
- 
 }
  
-void SearchServer::RemoveDocument(int document_id) {
-    if (id_to_document_freqs_SV_.count(document_id)) {
-        for (auto word : id_to_document_freqs_SV_.at(document_id)) {
-            word_to_document_freqs_SV_.at(word.first).erase(document_id);
+template <typename Traits>
+SearchPage BasicSearchServer<Traits>::FindPage(const std::string_view raw_query, size_t page_size, const SearchCursor& after) const {
+    return FindPage(raw_query, DocumentStatus::ACTUAL, page_size, after);
+}
+
+template <typename Traits>
+SearchPage BasicSearchServer<Traits>::FindPage(const std::string_view raw_query, DocumentStatus status, size_t page_size, const SearchCursor& after) const {
+    using namespace std::string_literals;
+    const auto status_predicate = [status](DocumentId document_id, DocumentStatus document_status, int rating) { return document_status == status; };
+    if (!result_cache_) {
+        return FindPage(raw_query, status_predicate, page_size, after);
+    }
+    if (page_size == 0) {
+        throw std::invalid_argument("Page size must be positive"s);
+    }
+
+    MetricsScope metrics(MetricsEntryPoint::FIND_TOP_DOCUMENTS_SEQ);
+    const QueryContext query = PrepareQuery(raw_query);
+    // Queries differing only in word order or repeated words share an entry
+    std::string key;
+    for (const auto word : query.plus_words) {
+        key.append(word).push_back(' ');
+    }
+    key.push_back('-');
+    for (const auto word : query.minus_words) {
+        key.append(word).push_back(' ');
+    }
+    for (const auto word : query.prefix_words) {
+        key.push_back('*');
+        key.append(word).push_back(' ');
+    }
+    // Phrases keep their word order, so the same words quoted or reordered get their own entries
+    size_t phrase_begin = 0;
+    for (const size_t phrase_size : query.phrase_sizes) {
+        key.push_back('"');
+        key.append(std::to_string(phrase_size)).push_back(' ');
+        for (size_t i = phrase_begin; i < phrase_begin + phrase_size; ++i) {
+            key.append(query.phrase_words[i]).push_back(' ');
         }
-       id_to_document_freqs_SV_.erase(document_id);
+        phrase_begin += phrase_size;
+    }
+    key.push_back(static_cast<char>('0' + static_cast<int>(status)));
+
+    auto ranked = result_cache_->Find(key, generation_);
+    if (!ranked) {
+        auto documents = ToDocuments(FindAllDocuments(query, status_predicate));
+        std::sort(documents.begin(), documents.end(), [](const Document& lhs, const Document& rhs) {
+            return IsRankedBefore(lhs.relevance, lhs.rating, lhs.id, rhs.relevance, rhs.rating, rhs.id, Traits::EPS);
+        });
+        ranked = std::make_shared<const std::vector<Document>>(std::move(documents));
+        result_cache_->Insert(key, generation_, ranked);
+    }
+    return SelectRankedPage(*ranked, after, page_size, Traits::EPS);
+}
+
+template <typename Traits>
+void BasicSearchServer<Traits>::EnableResultCache(size_t capacity, std::chrono::milliseconds ttl) {
+    result_cache_ = std::make_unique<SearchResultCache>(capacity, ttl);
+}
+
+template <typename Traits>
+void BasicSearchServer<Traits>::DisableResultCache() {
+    result_cache_.reset();
+}
+
+template <typename Traits>
+void BasicSearchServer<Traits>::RemoveDocument(int document_id) {
+    MetricsScope metrics(MetricsEntryPoint::REMOVE_DOCUMENT);
+    if (!FitsDocumentId(document_id) || documents_.count(document_id) == 0) {
+        return;
+    }
+    for (const int term_id : documents_.at(document_id).term_ids) {
+        PostingList& postings = word_to_document_freqs_SV_.at(term_id_to_word_[term_id]);
+        postings_heap_usage_.RemoveBytes(postings.GetHeapUsage());
+        postings.Erase(document_id);
+        postings_heap_usage_.AddBytes(postings.GetHeapUsage());
+    }
  
-       documents_.erase(document_id);
+    ForgetDocumentCounters(documents_.at(document_id));
+    documents_.erase(document_id);
  
-       id_of_documents_.erase(document_id);
-    }   
+    id_of_documents_.erase(document_id);
+}
+
+template <typename Traits>
+void BasicSearchServer<Traits>::RemoveDocuments(const std::vector<DocumentId>& document_ids) {
+    MetricsScope metrics(MetricsEntryPoint::REMOVE_DOCUMENT);
+    // Postings are grouped by word first, so every posting map is visited once
+    // and different words are cleaned up in parallel
+    std::map<std::string_view, std::vector<DocumentId>> word_to_removed_ids;
+    for (const DocumentId document_id : document_ids) {
+        const auto it = documents_.find(document_id);
+        if (it == documents_.end()) {
+            continue;
+        }
+        for (const int term_id : it->second.term_ids) {
+            word_to_removed_ids[term_id_to_word_[term_id]].push_back(document_id);
+        }
+    }
+
+    std::vector<std::pair<PostingList*, const std::vector<DocumentId>*>> postings_to_clean;
+    postings_to_clean.reserve(word_to_removed_ids.size());
+    for (const auto& [word, ids] : word_to_removed_ids) {
+        postings_to_clean.emplace_back(&word_to_document_freqs_SV_.at(word), &ids);
+        postings_heap_usage_.RemoveBytes(postings_to_clean.back().first->GetHeapUsage());
+    }
+    GetExecutor().ParallelFor(0, postings_to_clean.size(), REMOVE_DOCUMENT_GRAIN_SIZE,
+        [&postings_to_clean](size_t i) {
+            for (const DocumentId document_id : *postings_to_clean[i].second) {
+                postings_to_clean[i].first->Erase(document_id);
+            }
+        });
+    for (const auto& [postings, _] : postings_to_clean) {
+        postings_heap_usage_.AddBytes(postings->GetHeapUsage());
+    }
+
+    for (const DocumentId document_id : document_ids) {
+        const auto it = documents_.find(document_id);
+        if (it == documents_.end()) {
+            continue;
+        }
+        ForgetDocumentCounters(it->second);
+        documents_.erase(it);
+        id_of_documents_.erase(document_id);
+    }
 }
  
-void SearchServer::RemoveDocument(std::execution::sequenced_policy, int document_id) {
+template <typename Traits>
+void BasicSearchServer<Traits>::RemoveDocument(std::execution::sequenced_policy, int document_id) {
      RemoveDocument(document_id);
 }
  
-void SearchServer::RemoveDocument(std::execution::parallel_policy, int document_id) {
-    auto it = find_if(std::execution::par, documents_.begin(), documents_.end(), [document_id](auto p_id) {return p_id.first == document_id; });
+template <typename Traits>
+void BasicSearchServer<Traits>::RemoveDocument(std::execution::parallel_policy, int document_id) {
+    MetricsScope metrics(MetricsEntryPoint::REMOVE_DOCUMENT);
+    auto it = FitsDocumentId(document_id) ? documents_.find(document_id) : documents_.end();
     if (it != documents_.end()) {
  
         id_of_documents_.erase(document_id);
-        std::vector<std::string_view> words;
-        words.reserve(id_to_document_freqs_SV_.at(document_id).size());
-  
-        for_each(std::execution::par,
-            id_to_document_freqs_SV_.at(document_id).begin(),
-            id_to_document_freqs_SV_.at(document_id).end(),
-            [&words](auto& word) {words.push_back(word.first); });
+        std::vector<PostingList*> postings;
+        postings.reserve(it->second.term_ids.size());
+        for (const int term_id : it->second.term_ids) {
+            postings.push_back(&word_to_document_freqs_SV_.at(term_id_to_word_[term_id]));
+            postings_heap_usage_.RemoveBytes(postings.back()->GetHeapUsage());
+        }
  
-        for_each(std::execution::par,
-            words.begin(),
-            words.end(),
-            [&](const auto word) {word_to_document_freqs_SV_.at(word).erase(document_id); });
+        // Every word has its own postings, so the erasures do not touch shared state
+        GetExecutor().ParallelFor(0, postings.size(), REMOVE_DOCUMENT_GRAIN_SIZE,
+            [&postings, document_id](size_t i) { postings[i]->Erase(document_id); });
+        for (const PostingList* word_postings : postings) {
+            postings_heap_usage_.AddBytes(word_postings->GetHeapUsage());
+        }
  
-        id_to_document_freqs_SV_.erase(document_id);
+        ForgetDocumentCounters(it->second);
         documents_.erase(it);
     }
 }
+
+template <typename Traits>
+void BasicSearchServer<Traits>::ForgetDocumentCounters(const DocumentData& document) {
+    // Cached results may contain the document
+    ++generation_;
+    // The text stays in doc_content_: index keys may still point into it
+    posting_count_ -= document.term_ids.size();
+    total_document_length_ -= document.length;
+    if (document.term_ids.capacity() > 0) {
+        term_ids_heap_usage_.RemoveAllocations(1, document.term_ids.capacity() * sizeof(int));
+    }
+    if (!document.positions.IsEmpty()) {
+        positions_heap_usage_.RemoveAllocations(1, document.positions.GetOffsets().capacity() * sizeof(uint32_t));
+        positions_heap_usage_.RemoveAllocations(document.positions.GetData().capacity() > 0 ? 1 : 0, document.positions.GetData().capacity());
+    }
+}
+
+template <typename Traits>
+void BasicSearchServer<Traits>::EnablePositionalIndex() {
+    if (positional_index_enabled_) {
+        return;
+    }
+    positional_index_enabled_ = true;
+    for (auto& [document_id, document] : documents_) {
+        document.positions = BuildDocumentPositions(SplitIntoWordsNoStopSV(*document.it_of_document), document.term_ids);
+    }
+}
+
+template <typename Traits>
+bool BasicSearchServer<Traits>::HasPositionalIndex() const {
+    return positional_index_enabled_;
+}
+
+template <typename Traits>
+DocumentPositions BasicSearchServer<Traits>::BuildDocumentPositions(const std::vector<std::string_view>& words, const std::pmr::vector<int>& term_ids) {
+    std::vector<std::vector<uint32_t>> term_positions(term_ids.size());
+    for (size_t position = 0; position < words.size(); ++position) {
+        const int term_id = word_to_term_id_.at(words[position]);
+        const size_t term_index = std::lower_bound(term_ids.begin(), term_ids.end(), term_id) - term_ids.begin();
+        term_positions[term_index].push_back(static_cast<uint32_t>(position));
+    }
+
+    DocumentPositions positions(term_positions);
+    positions_heap_usage_.AddAllocations(1, positions.GetOffsets().capacity() * sizeof(uint32_t));
+    positions_heap_usage_.AddAllocations(positions.GetData().capacity() > 0 ? 1 : 0, positions.GetData().capacity());
+    return positions;
+}
+
+template <typename Traits>
+std::vector<std::string_view> BasicSearchServer<Traits>::ExpandPrefix(const std::string_view prefix, size_t max_count) const {
+    std::vector<std::string_view> words;
+    if (max_count == 0) {
+        return words;
+    }
+    GetTermDictionary()->ForEachWithPrefix(prefix, [this, &words, max_count](const std::string_view word) {
+        // Words of removed documents stay in the index with empty postings
+        const auto it = word_to_document_freqs_SV_.find(word);
+        if (it != word_to_document_freqs_SV_.end() && !it->second.empty()) {
+            words.push_back(it->first);
+        }
+        return words.size() < max_count;
+    });
+    return words;
+}
+
+template <typename Traits>
+std::shared_ptr<const FrontCodedDictionary> BasicSearchServer<Traits>::GetTermDictionary() const {
+    std::lock_guard guard(*term_dictionary_mutex_);
+    if (!term_dictionary_ || term_dictionary_->size() != word_to_document_freqs_SV_.size()) {
+        std::vector<std::string_view> words;
+        words.reserve(word_to_document_freqs_SV_.size());
+        for (const auto& [word, _] : word_to_document_freqs_SV_) {
+            words.push_back(word);
+        }
+        term_dictionary_ = std::make_shared<const FrontCodedDictionary>(words);
+    }
+    return term_dictionary_;
+}
+
+template <typename Traits>
+std::vector<typename BasicSearchServer<Traits>::WeightedWords> BasicSearchServer<Traits>::GetQueryExpansions(const QueryContext& query) const {
+    std::vector<WeightedWords> expansions;
+    for (const auto prefix : query.prefix_words) {
+        WeightedWords& expansion = expansions.emplace_back();
+        for (const auto word : ExpandPrefix(prefix)) {
+            expansion.emplace_back(word, 1.0);
+        }
+    }
+    for (WeightedWords& expansion : GetFuzzyExpansions(query)) {
+        expansions.push_back(std::move(expansion));
+    }
+    return expansions;
+}
+
+template <typename Traits>
+std::vector<typename BasicSearchServer<Traits>::WeightedWords> BasicSearchServer<Traits>::GetFuzzyExpansions(const QueryContext& query) const {
+    std::vector<WeightedWords> expansions;
+    if (!fuzzy_index_) {
+        return expansions;
+    }
+    for (const auto word : query.plus_words) {
+        WeightedWords& expansion = expansions.emplace_back();
+        const auto it = word_to_document_freqs_SV_.find(word);
+        if (!fuzzy_options_.expand_indexed_words && it != word_to_document_freqs_SV_.end() && !it->second.empty()) {
+            continue;
+        }
+        expansion = ExpandFuzzy(word);
+    }
+    return expansions;
+}
+
+template <typename Traits>
+QueryStatistics BasicSearchServer<Traits>::GetQueryStatistics(const QueryContext& query) const {
+    QueryStatistics statistics;
+    statistics.collection = GetCollectionStatistics();
+    for (const auto word : query.plus_words) {
+        statistics.word_freqs.push_back(GetDocumentFreq(word));
+    }
+    for (const WeightedWords& expansion : GetQueryExpansions(query)) {
+        statistics.expansion_freqs.push_back(MergePostings(expansion).term_freqs.size());
+    }
+    return statistics;
+}
+
+template <typename Traits>
+typename BasicSearchServer<Traits>::VirtualPostings BasicSearchServer<Traits>::MergePostings(const WeightedWords& words, std::pmr::memory_resource* resource) const {
+    VirtualPostings postings(resource);
+    for (const auto& [word, weight] : words) {
+        const PostingList& word_postings = word_to_document_freqs_SV_.at(word);
+        postings.postings_touched += word_postings.size();
+        word_postings.ForEach([this, &postings, weight = weight](DocumentId document_id, uint32_t occurrences) {
+            postings.term_freqs[document_id] += ComputeTermFreq(occurrences, documents_.at(document_id).length) * weight;
+            return true;
+        });
+    }
+    return postings;
+}
+
+template <typename Traits>
+bool BasicSearchServer<Traits>::HasTerm(const DocumentData& document, const std::string_view word) const {
+    const auto term_it = word_to_term_id_.find(word);
+    return term_it != word_to_term_id_.end() && std::binary_search(document.term_ids.begin(), document.term_ids.end(), term_it->second);
+}
+
+template <typename Traits>
+void BasicSearchServer<Traits>::AppendExpandedMatches(const QueryContext& query, const std::vector<std::string_view>& fuzzy_words,
+                                         const DocumentData& document, std::vector<std::string_view>& matched_words) const {
+    if (query.prefix_words.empty() && fuzzy_words.empty()) {
+        return;
+    }
+    if (!query.prefix_words.empty()) {
+        for (const int term_id : document.term_ids) {
+            const std::string_view word = term_id_to_word_[term_id];
+            for (const auto prefix : query.prefix_words) {
+                if (word.substr(0, prefix.size()) == prefix) {
+                    matched_words.push_back(word);
+                    break;
+                }
+            }
+        }
+    }
+    for (const auto word : fuzzy_words) {
+        if (HasTerm(document, word)) {
+            matched_words.push_back(word);
+        }
+    }
+    std::sort(matched_words.begin(), matched_words.end());
+    matched_words.erase(std::unique(matched_words.begin(), matched_words.end()), matched_words.end());
+}
+
+template <typename Traits>
+void BasicSearchServer<Traits>::EnableFuzzyMatching(const FuzzyOptions& options) {
+    ++generation_;
+    fuzzy_index_ = std::make_unique<SymmetricDeleteIndex>(options.max_distance);
+    fuzzy_options_ = options;
+    for (size_t term_id = 0; term_id < term_id_to_word_.size(); ++term_id) {
+        fuzzy_index_->Add(term_id_to_word_[term_id], static_cast<int>(term_id));
+    }
+}
+
+template <typename Traits>
+void BasicSearchServer<Traits>::DisableFuzzyMatching() {
+    ++generation_;
+    fuzzy_index_.reset();
+}
+
+template <typename Traits>
+void BasicSearchServer<Traits>::SetParallelism(size_t thread_count, ParallelismMode mode, size_t intra_query_postings_threshold) {
+    executor_ = std::make_unique<WorkStealingExecutor>(thread_count);
+    parallelism_mode_ = mode;
+    intra_query_postings_threshold_ = intra_query_postings_threshold;
+}
+
+template <typename Traits>
+ParallelismMode BasicSearchServer<Traits>::GetParallelismMode() const {
+    return parallelism_mode_;
+}
+
+template <typename Traits>
+WorkStealingExecutor& BasicSearchServer<Traits>::GetExecutor() const {
+    return executor_ ? *executor_ : WorkStealingExecutor::GetDefault();
+}
+
+template <typename Traits>
+bool BasicSearchServer<Traits>::ShouldSplitQuery(size_t postings_to_score) const {
+    switch (parallelism_mode_) {
+    case ParallelismMode::INTER_QUERY:
+        return false;
+    case ParallelismMode::INTRA_QUERY:
+        return true;
+    default:
+        return postings_to_score >= intra_query_postings_threshold_;
+    }
+}
+
+template <typename Traits>
+std::vector<std::pair<std::string_view, double>> BasicSearchServer<Traits>::ExpandFuzzy(const std::string_view word) const {
+    std::vector<std::pair<std::string_view, double>> expansion;
+    if (!fuzzy_index_) {
+        return expansion;
+    }
+    std::vector<int> candidates;
+    fuzzy_index_->ForEachCandidate(word, [&candidates](int term_id) { candidates.push_back(term_id); });
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    for (const int term_id : candidates) {
+        const std::string_view candidate = term_id_to_word_[term_id];
+        if (candidate == word) {
+            continue;
+        }
+        const int distance = ComputeEditDistance(word, candidate, fuzzy_options_.max_distance);
+        if (distance > fuzzy_options_.max_distance) {
+            continue;
+        }
+        // Words of removed documents stay in the index with empty postings
+        const auto it = word_to_document_freqs_SV_.find(candidate);
+        if (it != word_to_document_freqs_SV_.end() && !it->second.empty()) {
+            expansion.emplace_back(it->first, std::pow(fuzzy_options_.weight_per_edit, distance));
+        }
+    }
+    return expansion;
+}
+
+template <typename Traits>
+std::vector<std::string_view> BasicSearchServer<Traits>::GetFuzzyWords(const QueryContext& query) const {
+    std::vector<std::string_view> words;
+    for (const WeightedWords& expansion : GetFuzzyExpansions(query)) {
+        for (const auto& [word, _] : expansion) {
+            words.push_back(word);
+        }
+    }
+    return words;
+}
+
+template <typename Traits>
+bool BasicSearchServer<Traits>::MatchesPhrases(const QueryContext& query, const DocumentData& document) const {
+    if (query.phrase_sizes.empty()) {
+        return true;
+    }
+    std::vector<std::vector<uint32_t>> word_positions;
+    std::vector<size_t> term_indexes;
+    size_t phrase_begin = 0;
+    for (const size_t phrase_size : query.phrase_sizes) {
+        word_positions.resize(phrase_size);
+        term_indexes.resize(phrase_size);
+        // Term ids filter out documents missing a word before any positions are decoded
+        for (size_t i = 0; i < phrase_size; ++i) {
+            const auto term_it = word_to_term_id_.find(query.phrase_words[phrase_begin + i]);
+            if (term_it == word_to_term_id_.end()) {
+                return false;
+            }
+            const auto index_it = std::lower_bound(document.term_ids.begin(), document.term_ids.end(), term_it->second);
+            if (index_it == document.term_ids.end() || *index_it != term_it->second) {
+                return false;
+            }
+            term_indexes[i] = index_it - document.term_ids.begin();
+        }
+        for (size_t i = 0; i < phrase_size; ++i) {
+            document.positions.Decode(term_indexes[i], word_positions[i]);
+        }
+        if (!ContainsPhrase(word_positions)) {
+            return false;
+        }
+        phrase_begin += phrase_size;
+    }
+    return true;
+}
+
+template <typename Traits>
+void BasicSearchServer<Traits>::RemovePhraseMismatches(std::execution::sequenced_policy, const QueryContext& query, std::pmr::map<DocumentId, Score>& document_to_relevance) const {
+    for (auto it = document_to_relevance.begin(); it != document_to_relevance.end();) {
+        if (MatchesPhrases(query, documents_.at(it->first))) {
+            ++it;
+        }
+        else {
+            it = document_to_relevance.erase(it);
+        }
+    }
+}
+
+template <typename Traits>
+void BasicSearchServer<Traits>::RemovePhraseMismatches(std::execution::parallel_policy, const QueryContext& query, std::pmr::map<DocumentId, Score>& document_to_relevance) const {
+    std::vector<std::pair<DocumentId, const DocumentData*>> candidates;
+    candidates.reserve(document_to_relevance.size());
+    for (const auto& [document_id, _] : document_to_relevance) {
+        candidates.emplace_back(document_id, &documents_.at(document_id));
+    }
+    std::vector<char> matches(candidates.size());
+    GetExecutor().ParallelFor(0, candidates.size(), MATCH_DOCUMENTS_GRAIN_SIZE,
+        [&](size_t i) { matches[i] = MatchesPhrases(query, *candidates[i].second); });
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        if (!matches[i]) {
+            document_to_relevance.erase(candidates[i].first);
+        }
+    }
+}
+
+template <typename Traits>
+std::pmr::memory_resource* BasicSearchServer<Traits>::GetMemoryResource() const {
+    return index_memory_ ? index_memory_.get() : std::pmr::new_delete_resource();
+}
+
+template <typename Traits>
+MemoryUsage BasicSearchServer<Traits>::GetMemoryUsage() const {
+    MemoryUsage usage;
+    usage.document_count = documents_.size();
+
+    StructureMemoryUsage word_to_document_freqs = postings_heap_usage_;
+    word_to_document_freqs.name = "word_to_document_freqs_SV_";
+    word_to_document_freqs.node_count = word_to_document_freqs_SV_.size() + posting_count_;
+    word_to_document_freqs.AddAllocations(word_to_document_freqs_SV_.size(), GetTreeNodeSize<std::pair<const std::string_view, PostingList>>());
+    usage.structures.push_back(word_to_document_freqs);
+
+    StructureMemoryUsage documents = term_ids_heap_usage_;
+    documents.name = "documents_";
+    documents.node_count = documents_.size();
+    documents.AddAllocations(documents_.size(), GetTreeNodeSize<std::pair<const DocumentId, DocumentData>>());
+    usage.structures.push_back(documents);
+
+    StructureMemoryUsage positions = positions_heap_usage_;
+    positions.name = "positions";
+    positions.node_count = positional_index_enabled_ ? documents_.size() : 0;
+    usage.structures.push_back(positions);
+
+    StructureMemoryUsage term_dictionary{ "term_dictionary_" };
+    {
+        std::lock_guard guard(*term_dictionary_mutex_);
+        if (term_dictionary_) {
+            term_dictionary.node_count = term_dictionary_->size();
+            term_dictionary.AddAllocations(1, term_dictionary_->GetData().capacity());
+            term_dictionary.AddAllocations(1, term_dictionary_->GetBlockOffsets().capacity() * sizeof(uint32_t));
+        }
+    }
+    usage.structures.push_back(term_dictionary);
+
+    StructureMemoryUsage fuzzy_index{ "fuzzy_index_" };
+    if (fuzzy_index_ && fuzzy_index_->GetVariantCount() > 0) {
+        fuzzy_index.node_count = fuzzy_index_->GetVariantCount();
+        fuzzy_index.AddAllocations(fuzzy_index_->GetVariantCount(), GetHashNodeSize<std::pair<const uint64_t, std::vector<int>>>());
+        fuzzy_index.AddAllocations(fuzzy_index_->GetVariantCount(), fuzzy_index_->GetEntryCount() / fuzzy_index_->GetVariantCount() * sizeof(int));
+    }
+    usage.structures.push_back(fuzzy_index);
+
+    StructureMemoryUsage id_of_documents{ "id_of_documents_" };
+    id_of_documents.node_count = id_of_documents_.size();
+    id_of_documents.AddAllocations(id_of_documents_.size(), GetTreeNodeSize<DocumentId>());
+    usage.structures.push_back(id_of_documents);
+
+    // Includes the texts of removed documents, they are never freed
+    StructureMemoryUsage doc_content = content_heap_usage_;
+    doc_content.name = "doc_content_";
+    doc_content.node_count = doc_content_.size();
+    doc_content.AddAllocations(doc_content_.size(), GetListNodeSize<std::pmr::string>());
+    usage.structures.push_back(doc_content);
+
+    usage.structures.push_back(stop_words_.GetMemoryUsage());
+
+    StructureMemoryUsage word_to_term_id{ "word_to_term_id_" };
+    word_to_term_id.node_count = word_to_term_id_.size();
+    word_to_term_id.AddAllocations(word_to_term_id_.size(), GetHashNodeSize<std::pair<const std::string_view, int>>());
+    word_to_term_id.AddAllocations(1, word_to_term_id_.bucket_count() * sizeof(void*));
+    usage.structures.push_back(word_to_term_id);
+
+    StructureMemoryUsage term_id_to_word{ "term_id_to_word_" };
+    term_id_to_word.node_count = term_id_to_word_.size();
+    term_id_to_word.AddAllocations(term_id_to_word_.capacity() > 0 ? 1 : 0, term_id_to_word_.capacity() * sizeof(std::string_view));
+    usage.structures.push_back(term_id_to_word);
+
+    return usage;
+}
  
-bool SearchServer::IsStopWordSV(const std::string_view word) const {
-    return stop_words_.count(word) > 0;
+template <typename Traits>
+void BasicSearchServer<Traits>::CheckStopWords() const {
+    using namespace std::string_literals;
+
+    (void)std::all_of(stop_words_.begin(), stop_words_.end(),
+                      [](auto& word) {
+                                        if (!IsValidWordSV(word)) {
+                                            throw std::invalid_argument("Stop word \""s + word + "\" contents special characters"s);
+                                        }
+                                        else {
+                                            return true;
+                                        }
+                       });
 }
 
-std::vector<std::string_view> SearchServer::SplitIntoWordsNoStopSV(const std::string_view text) const {
+template <typename Traits>
+std::vector<std::string_view> BasicSearchServer<Traits>::SplitIntoWordsNoStopSV(const std::string_view text) const {
     std::vector<std::string_view> words;
     for (const std::string_view word : SplitIntoWordsSV(text)) {
         if (!IsStopWordSV(word)) {
@@ -199,7 +917,8 @@ std::vector<std::string_view> SearchServer::SplitIntoWordsNoStopSV(const std::st
     return words;
 }
 
-int SearchServer::ComputeAverageRating(const std::vector<int>& rating_in) {
+template <typename Traits>
+int BasicSearchServer<Traits>::ComputeAverageRating(const std::vector<int>& rating_in) {
     int rating_len = rating_in.size();
     if (rating_len != 0)
         return accumulate(rating_in.begin(), rating_in.end(), 0) / rating_len;
@@ -207,24 +926,26 @@ int SearchServer::ComputeAverageRating(const std::vector<int>& rating_in) {
         return 0;
 }
  
-bool SearchServer::IsValidWordSV(const std::string_view word) {
+template <typename Traits>
+bool BasicSearchServer<Traits>::IsValidWordSV(const std::string_view word) {
     // A valid word must not contain special characters
     return std::none_of(word.begin(), word.end(), [](char c) { return c >= 0 && c < 32; });
 }
 
-SearchServer::QueryWordSV SearchServer::ParseQueryWordSV(std::string_view text) const {
+template <typename Traits>
+typename BasicSearchServer<Traits>::QueryWordSV BasicSearchServer<Traits>::ParseQueryWordSV(std::string_view text) const {
     QueryWordSV queryWord;
     using namespace std::string_literals;
     if (text.empty()) {
         throw std::invalid_argument("Query is empty"s);
     }
     if (text[0] == '-') {
-        if (text[1] == '-') {
-            throw std::invalid_argument("Query contents more then 1 minus character"s);
-        }
         if (text.size() == 1) {
             throw std::invalid_argument("There are no a word after minus character"s);
         }
+        if (text[1] == '-') {
+            throw std::invalid_argument("Query contents more then 1 minus character"s);
+        }
         queryWord.is_minus = true;
         text = text.substr(1);
     }
@@ -232,13 +953,74 @@ SearchServer::QueryWordSV SearchServer::ParseQueryWordSV(std::string_view text)
         throw std::invalid_argument("Query \""s + std::string(text) + "\" contents special characters"s);
     }
     queryWord.data = text;
-    queryWord.is_stop = SearchServer::IsStopWordSV(text);
+    queryWord.is_stop = IsStopWordSV(text);
     return queryWord;
 }
 
-SearchServer::QuerySV SearchServer::ParseQuerySV(const std::string_view text) const {
-    QuerySV query;
-    for (const std::string_view word : SplitIntoWordsSV(text)) {
+template <typename Traits>
+QueryContext BasicSearchServer<Traits>::PrepareQuery(const std::string_view raw_query) const {
+    QueryContext query;
+    PrepareQuery(raw_query, query);
+    return query;
+}
+
+template <typename Traits>
+void BasicSearchServer<Traits>::PrepareQuery(const std::string_view raw_query, QueryContext& query) const {
+    using namespace std::string_literals;
+    query.Clear();
+    bool in_phrase = false;
+    size_t phrase_size = 0;
+    ForEachWordSV(raw_query, [this, &query, &in_phrase, &phrase_size](std::string_view word) {
+        // A phrase starts with a word beginning with a quote and ends with a word ending with one
+        const bool opens_phrase = !in_phrase && !word.empty() && word[0] == '"';
+        if (opens_phrase) {
+            word.remove_prefix(1);
+            in_phrase = true;
+            phrase_size = 0;
+        }
+        else if (!in_phrase && word.size() > 1 && word[0] == '-' && word[1] == '"') {
+            throw std::invalid_argument("Minus phrases are not supported"s);
+        }
+        const bool closes_phrase = in_phrase && !word.empty() && word.back() == '"';
+        if (closes_phrase) {
+            word.remove_suffix(1);
+        }
+
+        if (in_phrase) {
+            if (!word.empty()) {
+                const QueryWordSV query_word = ParseQueryWordSV(word);
+                if (query_word.is_minus) {
+                    throw std::invalid_argument("Minus words are not allowed inside a phrase"s);
+                }
+                // Positions do not count stop words, so they are skipped in phrases as well
+                if (!query_word.is_stop) {
+                    query.plus_words.push_back(query_word.data);
+                    query.phrase_words.push_back(query_word.data);
+                    ++phrase_size;
+                }
+            }
+            if (closes_phrase) {
+                in_phrase = false;
+                if (phrase_size > 1) {
+                    query.phrase_sizes.push_back(phrase_size);
+                }
+                else {
+                    // A phrase of one word is just a plus word
+                    query.phrase_words.erase(query.phrase_words.end() - phrase_size, query.phrase_words.end());
+                }
+            }
+            return;
+        }
+
+        if (word.size() > 1 && word.back() == '*' && word[0] != '-') {
+            const std::string_view prefix = word.substr(0, word.size() - 1);
+            if (!IsValidWordSV(prefix) || prefix.find('*') != std::string_view::npos) {
+                throw std::invalid_argument("Query prefix \""s + std::string(word) + "\" is invalid"s);
+            }
+            query.prefix_words.push_back(prefix);
+            return;
+        }
+
         const QueryWordSV query_word = ParseQueryWordSV(word);
         if (!query_word.is_stop) {
             if (query_word.is_minus) {
@@ -248,6 +1030,12 @@ SearchServer::QuerySV SearchServer::ParseQuerySV(const std::string_view text) co
                 query.plus_words.push_back(query_word.data);
             }
         }
+    });
+    if (in_phrase) {
+        throw std::invalid_argument("Query has an unclosed quote"s);
+    }
+    if (!query.phrase_sizes.empty() && !positional_index_enabled_) {
+        throw std::invalid_argument("Phrase queries need the positional index"s);
     }
 
     std::sort(query.minus_words.begin(), query.minus_words.end());
@@ -255,9 +1043,53 @@ SearchServer::QuerySV SearchServer::ParseQuerySV(const std::string_view text) co
 
     std::sort(query.plus_words.begin(), query.plus_words.end());
     query.plus_words.erase(std::unique(query.plus_words.begin(), query.plus_words.end()), query.plus_words.end());
-    return query;
+
+    std::sort(query.prefix_words.begin(), query.prefix_words.end());
+    query.prefix_words.erase(std::unique(query.prefix_words.begin(), query.prefix_words.end()), query.prefix_words.end());
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string_view word) const {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_SV_.at(word).size());
+template <typename Traits>
+int BasicSearchServer<Traits>::GetOrAddTermId(const std::string_view word) {
+    const auto [it, inserted] = word_to_term_id_.emplace(word, static_cast<int>(term_id_to_word_.size()));
+    if (inserted) {
+        term_id_to_word_.push_back(word);
+        if (fuzzy_index_) {
+            fuzzy_index_->Add(word, it->second);
+        }
+    }
+    return it->second;
 }
+
+template <typename Traits>
+std::vector<std::pair<int, std::string_view>> BasicSearchServer<Traits>::GetQueryTermIds(const SmallVector<std::string_view, QUERY_INLINE_WORD_COUNT>& words) const {
+    std::vector<std::pair<int, std::string_view>> term_ids;
+    term_ids.reserve(words.size());
+    for (const auto word : words) {
+        const auto it = word_to_term_id_.find(word);
+        if (it != word_to_term_id_.end()) {
+            term_ids.emplace_back(it->second, word);
+        }
+    }
+    std::sort(term_ids.begin(), term_ids.end());
+    return term_ids;
+}
+
+template <typename Traits>
+std::vector<Document> BasicSearchServer<Traits>::ToDocuments(std::vector<DocumentType> documents) {
+    if constexpr (std::is_same_v<DocumentType, Document>) {
+        return documents;
+    }
+    else {
+        std::vector<Document> result;
+        result.reserve(documents.size());
+        for (const DocumentType& document : documents) {
+            result.push_back({ document.id, document.relevance, document.rating });
+        }
+        return result;
+    }
+}
+
+template class BasicSearchServer<DefaultIndexTraits>;
+template class BasicSearchServer<CompactIndexTraits>;
+template class BasicSearchServer<QuantizedIndexTraits>;
+template class BasicSearchServer<NarrowIndexTraits>;
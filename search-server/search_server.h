@@ -12,65 +12,234 @@
 #include <algorithm>
 #include <execution>
 #include <mutex>
+#include <type_traits>
+#include <memory>
+#include <chrono>
+#include <atomic>
+#include <cstdint>
+#include <memory_resource>
 
 #include "string_processing.h"
 #include "document.h"
-#include "concurrent_map.h"
+#include "executor.h"
+#include "query_context.h"
+#include "stop_word_set.h"
+#include "query_trace.h"
+#include "metrics.h"
+#include "memory_usage.h"
+#include "search_cursor.h"
+#include "positional_index.h"
+#include "term_dictionary.h"
+#include "fuzzy_index.h"
+#include "scoring.h"
+#include "query_deadline.h"
+#include "posting_list.h"
+#include "index_traits.h"
+#include "index_memory.h"
 
-const int MAX_RESULT_DOCUMENT_COUNT = 5;
-const double EPS = 1e-6;
+// Limits of SearchServer, a BasicSearchServer takes its own from the traits
+const int MAX_RESULT_DOCUMENT_COUNT = static_cast<int>(DefaultIndexTraits::MAX_RESULT_DOCUMENT_COUNT);
+const double EPS = DefaultIndexTraits::EPS;
+// A prefix query word (foo*) is expanded to at most this many indexed words, in lexicographic order
+const size_t MAX_PREFIX_EXPANSION_COUNT = 64;
+// In the adaptive mode a parallel query is split between threads from this many postings on
+const size_t INTRA_QUERY_POSTINGS_THRESHOLD = 16384;
+
+// Full-text index ranking documents by TF-IDF or another scoring policy. Traits pick the types
+// of ids, stored term frequencies and scores, see index_traits.h. Member functions that are not
+// templates are compiled in search_server.cpp for the traits instantiated there.
+template <typename Traits>
+class BasicSearchServer {
+
+    static_assert(IsValidIndexTraits<Traits>(), "DocumentId must be a signed integer no wider than int, Score a floating point type");
 
-class SearchServer {
 public:
+    using DocumentId = typename Traits::DocumentId;
+    using TermFreq = typename Traits::TermFreq;
+    using Score = typename Traits::Score;
+    using DocumentType = BasicDocument<DocumentId, Score>;
+    using WordFrequencies = std::pmr::map<std::string_view, TermFreq, std::less<>>;
+
+    // The index is allocated as memory chooses: from the heap, from pools or from a monotonic arena
     template <typename StringContainer>
-    explicit SearchServer(const StringContainer& stop_words);
-    explicit SearchServer(const std::string& stop_words_text = std::string())
-        : SearchServer(SplitIntoWordsSV(stop_words_text))
+    explicit BasicSearchServer(const StringContainer& stop_words, const IndexMemoryOptions& memory = IndexMemoryOptions());
+    template <size_t WordCount>
+    explicit BasicSearchServer(const StaticStopWordSet<WordCount>& stop_words, const IndexMemoryOptions& memory = IndexMemoryOptions());
+    explicit BasicSearchServer(const std::string& stop_words_text = std::string(), const IndexMemoryOptions& memory = IndexMemoryOptions())
+        : BasicSearchServer(SplitIntoWordsSV(stop_words_text), memory)
     {
     }
-    explicit SearchServer(const std::string_view stop_words_sv = std::string_view())
-        : SearchServer(SplitIntoWordsSV(stop_words_sv))
+    explicit BasicSearchServer(const std::string_view stop_words_sv = std::string_view(), const IndexMemoryOptions& memory = IndexMemoryOptions())
+        : BasicSearchServer(SplitIntoWordsSV(stop_words_sv), memory)
     {
     }
+
+    // Containers keep the resource they were built with, so a server can be moved but not
+    // assigned over: the old containers would outlive the resource they allocate from
+    BasicSearchServer(BasicSearchServer&&) = default;
+    BasicSearchServer& operator=(BasicSearchServer&&) = delete;
     
+    // Ids are taken as int, one that DocumentId cannot hold throws std::out_of_range here
+    // and names no document in the calls below
     void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    QueryContext PrepareQuery(const std::string_view raw_query) const;
+    void PrepareQuery(const std::string_view raw_query, QueryContext& query) const;
     
     template<typename Policy>
-    std::vector<Document> FindTopDocuments(Policy policy, const std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL) const;
+    std::vector<DocumentType> FindTopDocuments(Policy policy, const std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL) const;
     template <typename DocumentPredicate>
-    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const; 
+    std::vector<DocumentType> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const; 
     template<typename DocumentPredicate, typename Policy>
-    std::vector<Document> FindTopDocuments(Policy policy, const std::string_view raw_query, DocumentPredicate document_predicate) const;
-    std::vector<Document> FindTopDocuments(const std::string_view raw_query) const;
-    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const;
+    std::vector<DocumentType> FindTopDocuments(Policy policy, const std::string_view raw_query, DocumentPredicate document_predicate) const;
+    std::vector<DocumentType> FindTopDocuments(const std::string_view raw_query) const;
+    std::vector<DocumentType> FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const;
+
+    template<typename Policy>
+    std::vector<DocumentType> FindTopDocuments(Policy policy, const QueryContext& query, DocumentStatus status = DocumentStatus::ACTUAL) const;
+    template <typename DocumentPredicate>
+    std::vector<DocumentType> FindTopDocuments(const QueryContext& query, DocumentPredicate document_predicate) const;
+    template<typename DocumentPredicate, typename Policy>
+    std::vector<DocumentType> FindTopDocuments(Policy policy, const QueryContext& query, DocumentPredicate document_predicate) const;
+    std::vector<DocumentType> FindTopDocuments(const QueryContext& query, DocumentStatus status = DocumentStatus::ACTUAL) const;
+
+    // Ranking with a scoring policy other than the default TfIdfScoring, e.g. Bm25Scoring()
+    template <typename Scoring, typename Policy>
+    std::vector<DocumentType> FindTopDocuments(const Scoring& scoring, Policy policy, const std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL) const;
+    template <typename Scoring, typename Policy, typename DocumentPredicate>
+    std::vector<DocumentType> FindTopDocuments(const Scoring& scoring, Policy policy, const std::string_view raw_query, DocumentPredicate document_predicate) const;
+    template <typename Scoring, typename Policy, typename DocumentPredicate>
+    std::vector<DocumentType> FindTopDocuments(const Scoring& scoring, Policy policy, const QueryContext& query, DocumentPredicate document_predicate) const;
+    // Ranking of a shard with the statistics of the whole index, see ShardedSearchServer
+    template <typename Scoring, typename Policy, typename DocumentPredicate>
+    std::vector<DocumentType> FindTopDocuments(const Scoring& scoring, Policy policy, const QueryContext& query, DocumentPredicate document_predicate,
+                                           const QueryStatistics& statistics) const;
+    QueryStatistics GetQueryStatistics(const QueryContext& query) const;
+
+    // Stops scoring once the deadline expires and returns the best documents scored by then,
+    // flagged as partial. Minus words and phrases still filter a partial result.
+    template <typename Policy, typename DocumentPredicate>
+    QueryResult FindTopDocumentsUntil(const QueryDeadline& deadline, Policy policy, const std::string_view raw_query, DocumentPredicate document_predicate) const;
+    template <typename Policy>
+    QueryResult FindTopDocumentsUntil(const QueryDeadline& deadline, Policy policy, const std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL) const;
+
+    // Search-after pagination: page_size documents ranked after the cursor, in the order of
+    // FindTopDocuments but without its cap. Only the next page is selected, not the whole result.
+    SearchPage FindPage(const std::string_view raw_query, size_t page_size, const SearchCursor& after = SearchCursor()) const;
+    SearchPage FindPage(const std::string_view raw_query, DocumentStatus status, size_t page_size, const SearchCursor& after = SearchCursor()) const;
+    template <typename DocumentPredicate>
+    SearchPage FindPage(const std::string_view raw_query, DocumentPredicate document_predicate, size_t page_size, const SearchCursor& after = SearchCursor()) const;
+    template <typename Policy, typename DocumentPredicate>
+    SearchPage FindPage(Policy policy, const std::string_view raw_query, DocumentPredicate document_predicate, size_t page_size, const SearchCursor& after = SearchCursor()) const;
+
+    // Status queries of FindPage keep their whole ranked result for ttl, so following pages are cheap.
+    // Any change of the index drops the cached results.
+    void EnableResultCache(size_t capacity, std::chrono::milliseconds ttl);
+    void DisableResultCache();
+
+    // Builds word positions of all documents and keeps them for new ones, which enables
+    // quoted phrases in queries: "white cat" matches only documents with these words in a row
+    void EnablePositionalIndex();
+    bool HasPositionalIndex() const;
+
+    // Indexed words starting with prefix, in lexicographic order. A query word foo* is expanded
+    // by this call, and the postings of the expansion are scored together as one word.
+    std::vector<std::string_view> ExpandPrefix(const std::string_view prefix, size_t max_count = MAX_PREFIX_EXPANSION_COUNT) const;
+
+    // Fuzzy mode: a query word is also matched by indexed words within a small edit distance,
+    // found through a symmetric delete index, with their scores down-weighted
+    void EnableFuzzyMatching(const FuzzyOptions& options = FuzzyOptions());
+    void DisableFuzzyMatching();
+
+    // Parallel queries, batches and parallel removals run on an executor of thread_count threads
+    // owned by the server, instead of the process-wide default one
+    void SetParallelism(size_t thread_count, ParallelismMode mode = ParallelismMode::ADAPTIVE,
+                        size_t intra_query_postings_threshold = INTRA_QUERY_POSTINGS_THRESHOLD);
+    ParallelismMode GetParallelismMode() const;
+    WorkStealingExecutor& GetExecutor() const;
+    // Indexed words within the fuzzy edit distance of word with their weights, empty if fuzzy mode is off
+    std::vector<std::pair<std::string_view, double>> ExpandFuzzy(const std::string_view word) const;
 
     void RemoveDocument(int document_id);
     void RemoveDocument(std::execution::sequenced_policy, int document_id);
     void RemoveDocument(std::execution::parallel_policy, int document_id);
+    void RemoveDocuments(const std::vector<DocumentId>& document_ids);
    
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::parallel_policy, const std::string_view raw_query, int document_id) const;
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::sequenced_policy, const std::string_view raw_query, int document_id) const;
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const QueryContext& query, int document_id) const;
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::parallel_policy, const QueryContext& query, int document_id) const;
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::sequenced_policy, const QueryContext& query, int document_id) const;
+
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(const std::string_view raw_query, const std::vector<DocumentId>& document_ids) const;
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(const QueryContext& query, const std::vector<DocumentId>& document_ids) const;
     
     int GetDocumentCount() const;
     int GetStopWordsCount() const;
-    const std::map<std::string_view, double, std::less<>>& GetWordFrequencies(int document_id) const;
+    std::vector<std::string> GetStopWords() const;
+    // Text, status and rating of the document, throws std::out_of_range for an unknown id.
+    // The text stays valid until the server is destroyed.
+    StoredDocument GetStoredDocument(int document_id) const;
+    // Decoded from the postings of the document's words, empty for an unknown id
+    WordFrequencies GetWordFrequencies(int document_id) const;
+    const std::pmr::vector<int>& GetDocumentTermIds(int document_id) const;
+    CollectionStatistics GetCollectionStatistics() const;
+    // Number of documents containing the word
+    size_t GetDocumentFreq(const std::string_view word) const;
+    // Bytes used by every internal structure. Computed from element counts kept up to date
+    // by AddDocument and RemoveDocument, so the call does not walk the index.
+    MemoryUsage GetMemoryUsage() const;
+    // Resource of the index containers, std::pmr::new_delete_resource() for IndexAllocation::DEFAULT
+    std::pmr::memory_resource* GetMemoryResource() const;
 
-    std::set<int>::iterator begin();
-    std::set<int>::iterator end();
+    typename std::pmr::set<DocumentId>::iterator begin();
+    typename std::pmr::set<DocumentId>::iterator end();
+    typename std::pmr::set<DocumentId>::const_iterator begin() const;
+    typename std::pmr::set<DocumentId>::const_iterator end() const;
 
 private:
     struct DocumentData {
         int rating;
         DocumentStatus status;
-        std::list<std::string>::iterator it_of_document;
+        std::pmr::list<std::pmr::string>::iterator it_of_document;
+        // Sorted ids of the distinct words: the whole forward index, frequencies live in the postings
+        std::pmr::vector<int> term_ids;
+        // Words without stop words, for length normalization of scoring
+        uint32_t length;
+        // Empty unless the positional index is enabled
+        DocumentPositions positions;
     };
-    std::set<std::string, std::less<>> stop_words_;
-    std::map<int, std::map<std::string_view, double, std::less<>>> id_to_document_freqs_SV_;
-    std::map<std::string_view, std::map<int, double>, std::less<>> word_to_document_freqs_SV_;
-    std::map<int, DocumentData> documents_;
-    std::set<int> id_of_documents_;
-    std::list<std::string> doc_content_;
+    // Declared first: the containers below allocate from it and must be destroyed before it
+    std::unique_ptr<std::pmr::memory_resource> index_memory_;
+    StopWordSet stop_words_;
+    // Compressed postings with occurrence counts, term frequencies are recomputed from document lengths
+    std::pmr::map<std::string_view, PostingList, std::less<>> word_to_document_freqs_SV_{ GetMemoryResource() };
+    std::pmr::map<DocumentId, DocumentData> documents_{ GetMemoryResource() };
+    std::pmr::set<DocumentId> id_of_documents_{ GetMemoryResource() };
+    std::pmr::list<std::pmr::string> doc_content_{ GetMemoryResource() };
+    std::pmr::unordered_map<std::string_view, int> word_to_term_id_{ GetMemoryResource() };
+    std::pmr::vector<std::string_view> term_id_to_word_{ GetMemoryResource() };
+    std::unique_ptr<SearchResultCache> result_cache_;
+    // Changes on every AddDocument and RemoveDocument
+    uint64_t generation_ = 0;
+    bool positional_index_enabled_ = false;
+    // Built on the first prefix query after new words were indexed. Words are never erased from
+    // word_to_document_freqs_SV_, so a different word count means the dictionary is stale.
+    mutable std::shared_ptr<const FrontCodedDictionary> term_dictionary_;
+    mutable std::unique_ptr<std::mutex> term_dictionary_mutex_ = std::make_unique<std::mutex>();
+    std::unique_ptr<SymmetricDeleteIndex> fuzzy_index_;
+    FuzzyOptions fuzzy_options_;
+    std::unique_ptr<WorkStealingExecutor> executor_;
+    ParallelismMode parallelism_mode_ = ParallelismMode::ADAPTIVE;
+    size_t intra_query_postings_threshold_ = INTRA_QUERY_POSTINGS_THRESHOLD;
+    // Sizes of nested containers, for GetMemoryUsage
+    size_t posting_count_ = 0;
+    size_t total_document_length_ = 0;
+    StructureMemoryUsage content_heap_usage_;
+    StructureMemoryUsage term_ids_heap_usage_;
+    StructureMemoryUsage positions_heap_usage_;
+    StructureMemoryUsage postings_heap_usage_;
 
    struct QueryWordSV {
         std::string_view data;
@@ -83,78 +252,190 @@ private:
             , is_stop(false)
         {}
     }; 
-     
-    struct QuerySV {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
-
-        QuerySV()
-            : plus_words({})
-            , minus_words({})
-        {}
-    };
     
-    bool IsStopWordSV(const std::string_view word) const;
+    bool IsStopWordSV(const std::string_view word) const {
+        return stop_words_.Contains(word);
+    }
+    void CheckStopWords() const;
     static bool IsValidWordSV(const std::string_view word);
    
     std::vector<std::string_view> SplitIntoWordsNoStopSV(const std::string_view text) const;
       
     QueryWordSV ParseQueryWordSV(std::string_view text) const;
-    QuerySV ParseQuerySV(const std::string_view text) const;
 
-    double ComputeWordInverseDocumentFreq(const std::string_view word) const;
+    int GetOrAddTermId(const std::string_view word);
+    // Updates the counters of GetMemoryUsage and scoring statistics for a removed document
+    void ForgetDocumentCounters(const DocumentData& document);
+
+    // Postings of several words merged into the postings of one virtual word
+    struct VirtualPostings {
+        explicit VirtualPostings(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+            : term_freqs(resource) {
+        }
+
+        std::pmr::map<DocumentId, Score> term_freqs;
+        size_t postings_touched = 0;
+    };
+    using WeightedWords = std::vector<std::pair<std::string_view, double>>;
+
+    std::shared_ptr<const FrontCodedDictionary> GetTermDictionary() const;
+    // Groups of indexed words the expanded query words stand for: one group per prefix word,
+    // then one per plus word if fuzzy mode is on. Groups may be empty, so the layout depends only on the query.
+    std::vector<WeightedWords> GetQueryExpansions(const QueryContext& query) const;
+    VirtualPostings MergePostings(const WeightedWords& words, std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
+    std::vector<WeightedWords> GetFuzzyExpansions(const QueryContext& query) const;
+    // Fuzzy expansions of the query words, flattened for MatchDocument
+    std::vector<std::string_view> GetFuzzyWords(const QueryContext& query) const;
+    bool HasTerm(const DocumentData& document, const std::string_view word) const;
+    void AppendExpandedMatches(const QueryContext& query, const std::vector<std::string_view>& fuzzy_words,
+                               const DocumentData& document, std::vector<std::string_view>& matched_words) const;
+    DocumentPositions BuildDocumentPositions(const std::vector<std::string_view>& words, const std::pmr::vector<int>& term_ids);
+    bool MatchesPhrases(const QueryContext& query, const DocumentData& document) const;
+    void RemovePhraseMismatches(std::execution::sequenced_policy, const QueryContext& query, std::pmr::map<DocumentId, Score>& document_to_relevance) const;
+    void RemovePhraseMismatches(std::execution::parallel_policy, const QueryContext& query, std::pmr::map<DocumentId, Score>& document_to_relevance) const;
+    std::vector<std::pair<int, std::string_view>> GetQueryTermIds(const SmallVector<std::string_view, QUERY_INLINE_WORD_COUNT>& words) const;
+
     static int ComputeAverageRating(const std::vector<int>& rating_in);
+    static bool FitsDocumentId(int document_id) {
+        return static_cast<int>(static_cast<DocumentId>(document_id)) == document_id;
+    }
+    // Pages and deadline results are handed out as Document whatever the score type
+    static std::vector<Document> ToDocuments(std::vector<DocumentType> documents);
+
+    template <typename Policy>
+    static constexpr MetricsEntryPoint GetFindTopDocumentsEntryPoint() {
+        return std::is_same_v<std::decay_t<Policy>, std::execution::parallel_policy> ? MetricsEntryPoint::FIND_TOP_DOCUMENTS_PAR : MetricsEntryPoint::FIND_TOP_DOCUMENTS_SEQ;
+    }
+    // A parallel query too small to split is scored by the sequential code under the parallel entry point
+    static MetricsScope* GetActiveFindScope() {
+        MetricsScope* scope = MetricsScope::GetActive(MetricsEntryPoint::FIND_TOP_DOCUMENTS_SEQ);
+        return scope ? scope : MetricsScope::GetActive(MetricsEntryPoint::FIND_TOP_DOCUMENTS_PAR);
+    }
+    bool ShouldSplitQuery(size_t postings_to_score) const;
+    template <typename Scoring, typename Policy, typename DocumentPredicate>
+    std::vector<DocumentType> RankTopDocuments(const Scoring& scoring, Policy policy, const QueryContext& query, DocumentPredicate document_predicate,
+                                           const QueryStatistics* statistics, const QueryDeadline* deadline = nullptr) const;
 
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(const QuerySV& query, DocumentPredicate document_predicate) const;
-    template<typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(std::execution::sequenced_policy, const QuerySV& query, DocumentPredicate document_predicate) const;
-    template<typename DocumentPredicate>
-    std::vector<Document> FindAllDocuments(std::execution::parallel_policy, const QuerySV& query, DocumentPredicate document_predicate) const;
+    std::vector<DocumentType> FindAllDocuments(const QueryContext& query, DocumentPredicate document_predicate) const;
+    template<typename Scoring, typename DocumentPredicate>
+    std::vector<DocumentType> FindAllDocuments(std::execution::sequenced_policy, const Scoring& scoring, const QueryContext& query, DocumentPredicate document_predicate,
+                                           const QueryStatistics* statistics = nullptr, const QueryDeadline* deadline = nullptr) const;
+    template<typename Scoring, typename DocumentPredicate>
+    std::vector<DocumentType> FindAllDocuments(std::execution::parallel_policy, const Scoring& scoring, const QueryContext& query, DocumentPredicate document_predicate,
+                                           const QueryStatistics* statistics = nullptr, const QueryDeadline* deadline = nullptr) const;
 };
 
+template <typename Traits>
 template <typename StringContainer>
-SearchServer::SearchServer(const StringContainer& stop_words)
-    : stop_words_(MakeUniqueNonEmptyStrings(stop_words)) {
-    using namespace std::string_literals;
+BasicSearchServer<Traits>::BasicSearchServer(const StringContainer& stop_words, const IndexMemoryOptions& memory)
+    : index_memory_(MakeIndexMemoryResource(memory))
+    , stop_words_(MakeUniqueNonEmptyStrings(stop_words)) {
+    CheckStopWords();
+}
 
-    (void)std::all_of(stop_words_.begin(), stop_words_.end(),
-                      [](auto& word) {
-                                        if (!IsValidWordSV(word)) {
-                                            throw std::invalid_argument("Stop word \""s + word + "\" contents special characters"s);
-                                        }
-                                        else {
-                                            return true;
-                                        }
-                       });
+template <typename Traits>
+template <size_t WordCount>
+BasicSearchServer<Traits>::BasicSearchServer(const StaticStopWordSet<WordCount>& stop_words, const IndexMemoryOptions& memory)
+    : index_memory_(MakeIndexMemoryResource(memory))
+    , stop_words_(stop_words) {
+    CheckStopWords();
 }
 
-template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(std::execution::sequenced_policy, const QuerySV& query, DocumentPredicate document_predicate) const {
-    std::map<int, double> document_to_relevance;
+template <typename Traits>
+template <typename Scoring, typename DocumentPredicate>
+std::vector<typename BasicSearchServer<Traits>::DocumentType> BasicSearchServer<Traits>::FindAllDocuments(std::execution::sequenced_policy, const Scoring& scoring, const QueryContext& query, DocumentPredicate document_predicate,
+                                                    const QueryStatistics* statistics, const QueryDeadline* deadline) const {
+    ScratchArena arena;
+    std::pmr::map<DocumentId, Score> document_to_relevance(arena.Get());
+    size_t postings_touched = 0;
+    const auto scorer = scoring.Prepare(statistics ? statistics->collection : GetCollectionStatistics());
 
-    for (const auto word : query.plus_words) {
-        if (word_to_document_freqs_SV_.count(word) == 0) {
+    // Postings scored since the last check of the deadline
+    size_t unchecked_postings = 0;
+    const auto is_expired = [deadline, &unchecked_postings]() {
+        if (deadline == nullptr || ++unchecked_postings < DEADLINE_CHECK_INTERVAL) {
+            return false;
+        }
+        unchecked_postings = 0;
+        return deadline->IsExpired();
+    };
+
+    for (size_t word_index = 0; word_index < query.plus_words.size(); ++word_index) {
+        const auto postings_it = word_to_document_freqs_SV_.find(query.plus_words[word_index]);
+        if (postings_it == word_to_document_freqs_SV_.end() || postings_it->second.empty()) {
             continue;
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
+        if (deadline && deadline->IsExpired()) {
+            break;
+        }
+        postings_touched += postings_it->second.size();
+        double inverse_document_freq = 0.0;
+        {
+            TRACE_QUERY_STAGE(QueryStage::IDF);
+            inverse_document_freq = scorer.ComputeIdf(statistics ? GetGlobalDocumentFreq(statistics->word_freqs, word_index, postings_it->second.size()) : postings_it->second.size());
+        }
 
-        for (const auto [document_id, term_freq] : word_to_document_freqs_SV_.at(word)) {
-            DocumentData temp_doc_data = documents_.at(document_id);
+        TRACE_QUERY_STAGE(QueryStage::POSTINGS);
+        postings_it->second.ForEach([&](int document_id, uint32_t occurrences) {
+            if (is_expired()) {
+                return false;
+            }
+            const DocumentData& temp_doc_data = documents_.at(document_id);
             if (document_predicate(document_id, temp_doc_data.status, temp_doc_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+                document_to_relevance[document_id] += scorer.Score(ComputeTermFreq(occurrences, temp_doc_data.length), temp_doc_data.length, inverse_document_freq);
+            }
+            return true;
+        });
+    }
+    const std::vector<WeightedWords> expansions = GetQueryExpansions(query);
+    for (size_t expansion_index = 0; expansion_index < expansions.size(); ++expansion_index) {
+        if (deadline && deadline->IsExpired()) {
+            break;
+        }
+        TRACE_QUERY_STAGE(QueryStage::POSTINGS);
+        const VirtualPostings postings = MergePostings(expansions[expansion_index], arena.Get());
+        postings_touched += postings.postings_touched;
+        if (postings.term_freqs.empty()) {
+            continue;
+        }
+        const double inverse_document_freq = scorer.ComputeIdf(statistics ? GetGlobalDocumentFreq(statistics->expansion_freqs, expansion_index, postings.term_freqs.size()) : postings.term_freqs.size());
+        for (const auto [document_id, term_freq] : postings.term_freqs) {
+            if (is_expired()) {
+                break;
+            }
+            const DocumentData& document = documents_.at(document_id);
+            if (document_predicate(document_id, document.status, document.rating)) {
+                document_to_relevance[document_id] += scorer.Score(term_freq, document.length, inverse_document_freq);
             }
         }
     }
+    if (MetricsScope* metrics = GetActiveFindScope()) {
+        metrics->AddDocumentsScored(document_to_relevance.size());
+    }
     for (const auto word : query.minus_words) {
         if (word_to_document_freqs_SV_.count(word) == 0) {
             continue;
         }
-        for (const auto [document_id, _] : word_to_document_freqs_SV_.at(word)) {
+        postings_touched += word_to_document_freqs_SV_.at(word).size();
+        TRACE_QUERY_STAGE(QueryStage::MINUS_WORDS);
+        word_to_document_freqs_SV_.at(word).ForEach([&document_to_relevance](int document_id, uint32_t) {
             document_to_relevance.erase(document_id);
-        }
+            return true;
+        });
+    }
+
+    if (!query.phrase_sizes.empty()) {
+        TRACE_QUERY_STAGE(QueryStage::PHRASES);
+        RemovePhraseMismatches(std::execution::seq, query, document_to_relevance);
     }
-    std::vector<Document> matched_documents;
+
+    if (MetricsScope* metrics = GetActiveFindScope()) {
+        metrics->AddPostingsTouched(postings_touched);
+    }
+
+    TRACE_QUERY_STAGE(QueryStage::MATERIALIZE);
+    std::vector<DocumentType> matched_documents;
     for (const auto [document_id, relevance] : document_to_relevance) {
         matched_documents.push_back({
             document_id,
@@ -166,93 +447,301 @@ std::vector<Document> SearchServer::FindAllDocuments(std::execution::sequenced_p
     return matched_documents;
 }
 
+template <typename Traits>
 template <typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(const QuerySV& query, DocumentPredicate document_predicate) const {
-    return FindAllDocuments(std::execution::seq, query, document_predicate);
+std::vector<typename BasicSearchServer<Traits>::DocumentType> BasicSearchServer<Traits>::FindAllDocuments(const QueryContext& query, DocumentPredicate document_predicate) const {
+    return FindAllDocuments(std::execution::seq, TfIdfScoring(), query, document_predicate);
 }
 
-template<typename DocumentPredicate>
-std::vector<Document> SearchServer::FindAllDocuments(std::execution::parallel_policy, const QuerySV& query, DocumentPredicate document_predicate) const
+template <typename Traits>
+template<typename Scoring, typename DocumentPredicate>
+std::vector<typename BasicSearchServer<Traits>::DocumentType> BasicSearchServer<Traits>::FindAllDocuments(std::execution::parallel_policy, const Scoring& scoring, const QueryContext& query, DocumentPredicate document_predicate,
+                                                    const QueryStatistics* statistics, const QueryDeadline* deadline) const
 {
-    ConcurrentMap<int, double> document_to_relevance(500);
+    std::vector<std::pair<size_t, const PostingList*>> word_postings;
+    size_t postings_to_score = 0;
+    for (size_t word_index = 0; word_index < query.plus_words.size(); ++word_index) {
+        const auto postings_it = word_to_document_freqs_SV_.find(query.plus_words[word_index]);
+        if (postings_it != word_to_document_freqs_SV_.end() && !postings_it->second.empty()) {
+            word_postings.emplace_back(word_index, &postings_it->second);
+            postings_to_score += postings_it->second.size();
+        }
+    }
+    const std::vector<WeightedWords> expansions = GetQueryExpansions(query);
+    for (const WeightedWords& expansion : expansions) {
+        for (const auto& [word, _] : expansion) {
+            postings_to_score += word_to_document_freqs_SV_.at(word).size();
+        }
+    }
+    if (documents_.empty() || !ShouldSplitQuery(postings_to_score)) {
+        return FindAllDocuments(std::execution::seq, scoring, query, document_predicate, statistics, deadline);
+    }
 
-    for_each(std::execution::par,
-        query.plus_words.begin(), query.plus_words.end(),
-        [&](auto& word)
-        {
-            if (word_to_document_freqs_SV_.count(word)) {
-                const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-                std::for_each(std::execution::par,
-                    word_to_document_freqs_SV_.at(word).begin(), word_to_document_freqs_SV_.at(word).end(),
-                    [&](const auto& id_freq)
-                    {
-                        const auto& document = documents_.at(id_freq.first);
-                        if (document_predicate(id_freq.first, document.status, document.rating)) {
-                            document_to_relevance[id_freq.first].ref_to_value += id_freq.second * inverse_document_freq;
-                        }
-                    });
-            }
-        });
+    WorkStealingExecutor& executor = GetExecutor();
+    const auto scorer = scoring.Prepare(statistics ? statistics->collection : GetCollectionStatistics());
+    std::vector<VirtualPostings> expansion_postings(expansions.size());
+    executor.ParallelFor(0, expansions.size(), 1, [&](size_t i) {
+        if (deadline && deadline->IsExpired()) {
+            return;
+        }
+        TRACE_QUERY_STAGE(QueryStage::POSTINGS);
+        expansion_postings[i] = MergePostings(expansions[i]);
+    });
 
-    std::map<int, double> result(std::move(document_to_relevance.BuildOrdinaryMap()));
+    // Every chunk scores its own range of document ids into its own map, so chunks share no state
+    // and their maps are concatenated in order
+    const int64_t first_id = documents_.begin()->first;
+    const int64_t id_count = documents_.rbegin()->first - first_id + 1;
+    const size_t chunk_count = static_cast<size_t>(std::min<int64_t>(id_count, executor.GetThreadCount() * 2));
+    // Scratch maps get an arena per chunk, as chunks run on different threads
+    std::vector<std::pmr::monotonic_buffer_resource> chunk_arenas(chunk_count);
+    std::vector<std::pmr::map<DocumentId, Score>> chunk_relevance;
+    chunk_relevance.reserve(chunk_count);
+    for (auto& chunk_arena : chunk_arenas) {
+        chunk_relevance.emplace_back(&chunk_arena);
+    }
+    std::atomic<size_t> documents_scored = 0;
+    executor.ParallelFor(0, chunk_count, 1, [&](size_t chunk) {
+        const int lower_id = static_cast<int>(first_id + id_count * chunk / chunk_count);
+        const int upper_id = static_cast<int>(first_id + id_count * (chunk + 1) / chunk_count - 1);
+        std::pmr::map<DocumentId, Score>& document_to_relevance = chunk_relevance[chunk];
+        size_t unchecked_postings = 0;
+        // get_term_freq(document) gives the term frequency of the posting, returns false once the deadline has expired
+        const auto score_posting = [&](DocumentId document_id, double inverse_document_freq, auto get_term_freq) {
+            if (deadline && ++unchecked_postings >= DEADLINE_CHECK_INTERVAL) {
+                unchecked_postings = 0;
+                if (deadline->IsExpired()) {
+                    return false;
+                }
+            }
+            const DocumentData& document = documents_.at(document_id);
+            if (document_predicate(document_id, document.status, document.rating)) {
+                document_to_relevance[document_id] += scorer.Score(get_term_freq(document), document.length, inverse_document_freq);
+            }
+            return true;
+        };
 
-    for_each(std::execution::par,
-        query.minus_words.begin(), query.minus_words.end(),
-        [&result, this](auto& word)
-        {
-            if (word_to_document_freqs_SV_.count(word)) {
-                for (auto [document_id, _] : word_to_document_freqs_SV_.at(word)) {
-                    result.erase(document_id);
+        TRACE_QUERY_STAGE(QueryStage::POSTINGS);
+        for (const auto& [word_index, postings] : word_postings) {
+            if (deadline && deadline->IsExpired()) {
+                break;
+            }
+            const double inverse_document_freq = scorer.ComputeIdf(statistics ? GetGlobalDocumentFreq(statistics->word_freqs, word_index, postings->size()) : postings->size());
+            postings->ForEachInRange(lower_id, upper_id, [&](int document_id, uint32_t occurrences) {
+                return score_posting(document_id, inverse_document_freq,
+                                     [occurrences](const DocumentData& document) { return ComputeTermFreq(occurrences, document.length); });
+            });
+        }
+        for (size_t i = 0; i < expansion_postings.size(); ++i) {
+            const auto& term_freqs = expansion_postings[i].term_freqs;
+            if (term_freqs.empty()) {
+                continue;
+            }
+            const double inverse_document_freq = scorer.ComputeIdf(statistics ? GetGlobalDocumentFreq(statistics->expansion_freqs, i, term_freqs.size()) : term_freqs.size());
+            for (auto it = term_freqs.lower_bound(lower_id); it != term_freqs.end() && it->first <= upper_id; ++it) {
+                const double term_freq = it->second;
+                if (!score_posting(it->first, inverse_document_freq, [term_freq](const DocumentData&) { return term_freq; })) {
+                    break;
                 }
             }
-        });
-  
-    std::vector<Document> matched_documents(result.size());
-    std::atomic_int length = 0;
+        }
+        documents_scored += document_to_relevance.size();
 
-    std::for_each(std::execution::par,
-        result.begin(), result.end(),
-        [&matched_documents, &length, this](const auto& id_relevance)
-        {
-            matched_documents[length++] = { id_relevance.first, id_relevance.second, documents_.at(id_relevance.first).rating };
-        });
+        for (const auto word : query.minus_words) {
+            const auto postings_it = word_to_document_freqs_SV_.find(word);
+            if (postings_it == word_to_document_freqs_SV_.end()) {
+                continue;
+            }
+            TRACE_QUERY_STAGE(QueryStage::MINUS_WORDS);
+            postings_it->second.ForEachInRange(lower_id, upper_id, [&document_to_relevance](int document_id, uint32_t) {
+                document_to_relevance.erase(document_id);
+                return true;
+            });
+        }
+    });
+
+    ScratchArena arena;
+    std::pmr::map<DocumentId, Score> result(arena.Get());
+    for (auto& document_to_relevance : chunk_relevance) {
+        result.insert(document_to_relevance.begin(), document_to_relevance.end());
+    }
+
+    size_t postings_touched = postings_to_score;
+    for (const auto word : query.minus_words) {
+        postings_touched += GetDocumentFreq(word);
+    }
+    if (MetricsScope* metrics = MetricsScope::GetActive(MetricsEntryPoint::FIND_TOP_DOCUMENTS_PAR)) {
+        metrics->AddDocumentsScored(documents_scored);
+    }
+
+    if (!query.phrase_sizes.empty()) {
+        TRACE_QUERY_STAGE(QueryStage::PHRASES);
+        RemovePhraseMismatches(std::execution::par, query, result);
+    }
+
+    if (MetricsScope* metrics = MetricsScope::GetActive(MetricsEntryPoint::FIND_TOP_DOCUMENTS_PAR)) {
+        metrics->AddPostingsTouched(postings_touched);
+    }
+
+    TRACE_QUERY_STAGE(QueryStage::MATERIALIZE);
+    std::vector<DocumentType> matched_documents;
+    matched_documents.reserve(result.size());
+    for (const auto [document_id, relevance] : result) {
+        matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+    }
 
     return matched_documents;
 }
 
+template <typename Traits>
+template<typename DocumentPredicate, typename Policy>
+std::vector<typename BasicSearchServer<Traits>::DocumentType> BasicSearchServer<Traits>::FindTopDocuments(Policy policy, const std::string_view raw_query, DocumentPredicate document_predicate) const
+{
+    return FindTopDocuments(TfIdfScoring(), policy, raw_query, document_predicate);
+}
+
+template <typename Traits>
 template<typename DocumentPredicate, typename Policy>
-std::vector<Document> SearchServer::FindTopDocuments(Policy policy, const std::string_view raw_query, DocumentPredicate document_predicate) const
+std::vector<typename BasicSearchServer<Traits>::DocumentType> BasicSearchServer<Traits>::FindTopDocuments(Policy policy, const QueryContext& query, DocumentPredicate document_predicate) const
+{
+    return FindTopDocuments(TfIdfScoring(), policy, query, document_predicate);
+}
+
+template <typename Traits>
+template<typename Scoring, typename Policy>
+std::vector<typename BasicSearchServer<Traits>::DocumentType> BasicSearchServer<Traits>::FindTopDocuments(const Scoring& scoring, Policy policy, const std::string_view raw_query, DocumentStatus status) const
+{
+    return FindTopDocuments(scoring, policy, raw_query, [status](DocumentId document_id, DocumentStatus document_status, int rating) { return document_status == status; });
+}
+
+template <typename Traits>
+template<typename Scoring, typename Policy, typename DocumentPredicate>
+std::vector<typename BasicSearchServer<Traits>::DocumentType> BasicSearchServer<Traits>::FindTopDocuments(const Scoring& scoring, Policy policy, const std::string_view raw_query, DocumentPredicate document_predicate) const
+{
+    MetricsScope metrics(GetFindTopDocumentsEntryPoint<Policy>());
+    QueryContext query;
+    {
+        TRACE_QUERY_STAGE(QueryStage::PARSE);
+        PrepareQuery(raw_query, query);
+    }
+
+    return FindTopDocuments(scoring, policy, query, document_predicate);
+}
+
+template <typename Traits>
+template<typename Scoring, typename Policy, typename DocumentPredicate>
+std::vector<typename BasicSearchServer<Traits>::DocumentType> BasicSearchServer<Traits>::FindTopDocuments(const Scoring& scoring, Policy policy, const QueryContext& query, DocumentPredicate document_predicate) const
 {
-    QuerySV query = ParseQuerySV(raw_query);
+    return RankTopDocuments(scoring, policy, query, document_predicate, nullptr);
+}
 
-    auto matched_documents = FindAllDocuments(policy, query, document_predicate);
+template <typename Traits>
+template<typename Scoring, typename Policy, typename DocumentPredicate>
+std::vector<typename BasicSearchServer<Traits>::DocumentType> BasicSearchServer<Traits>::FindTopDocuments(const Scoring& scoring, Policy policy, const QueryContext& query, DocumentPredicate document_predicate,
+                                                     const QueryStatistics& statistics) const
+{
+    return RankTopDocuments(scoring, policy, query, document_predicate, &statistics);
+}
+
+template <typename Traits>
+template<typename Scoring, typename Policy, typename DocumentPredicate>
+std::vector<typename BasicSearchServer<Traits>::DocumentType> BasicSearchServer<Traits>::RankTopDocuments(const Scoring& scoring, Policy policy, const QueryContext& query, DocumentPredicate document_predicate,
+                                                     const QueryStatistics* statistics, const QueryDeadline* deadline) const
+{
+    MetricsScope metrics(GetFindTopDocumentsEntryPoint<Policy>());
+    auto matched_documents = FindAllDocuments(policy, scoring, query, document_predicate, statistics, deadline);
    
-    std::sort(std::execution::par,
-        matched_documents.begin(), matched_documents.end(),
-        [](const Document& lhs, const Document& rhs)
+    TRACE_QUERY_STAGE(QueryStage::SORT_TOP_K);
+    // Only the top is ordered, which for a handful of documents is cheaper than waking other threads
+    const auto top_end = matched_documents.begin() + std::min<size_t>(matched_documents.size(), Traits::MAX_RESULT_DOCUMENT_COUNT);
+    std::partial_sort(matched_documents.begin(), top_end, matched_documents.end(),
+        [](const DocumentType& lhs, const DocumentType& rhs)
         {
-            if (std::abs(lhs.relevance - rhs.relevance) < EPS) {
-                return lhs.rating > rhs.rating;
-            }
-            else {
-                return lhs.relevance > rhs.relevance;
-            }
+            return IsRankedBefore(lhs.relevance, lhs.rating, lhs.id, rhs.relevance, rhs.rating, rhs.id, Traits::EPS);
         });
+    matched_documents.erase(top_end, matched_documents.end());
 
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    return matched_documents;
+}
+
+template <typename Traits>
+template <typename Policy, typename DocumentPredicate>
+QueryResult BasicSearchServer<Traits>::FindTopDocumentsUntil(const QueryDeadline& deadline, Policy policy, const std::string_view raw_query, DocumentPredicate document_predicate) const {
+    MetricsScope metrics(GetFindTopDocumentsEntryPoint<Policy>());
+    QueryContext query;
+    {
+        TRACE_QUERY_STAGE(QueryStage::PARSE);
+        PrepareQuery(raw_query, query);
     }
 
-    return matched_documents;
+    QueryResult result;
+    result.documents = ToDocuments(RankTopDocuments(TfIdfScoring(), policy, query, document_predicate, nullptr, &deadline));
+    if (deadline.WasExpired()) {
+        result.outcome = QueryOutcome::PARTIAL;
+    }
+    return result;
+}
+
+template <typename Traits>
+template <typename Policy>
+QueryResult BasicSearchServer<Traits>::FindTopDocumentsUntil(const QueryDeadline& deadline, Policy policy, const std::string_view raw_query, DocumentStatus status) const {
+    return FindTopDocumentsUntil(deadline, policy, raw_query, [status](DocumentId document_id, DocumentStatus document_status, int rating) { return document_status == status; });
 }
 
+template <typename Traits>
 template<typename DocumentPredicate>
- std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const {
+std::vector<typename BasicSearchServer<Traits>::DocumentType> BasicSearchServer<Traits>::FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const {
     return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
 }
 
- template<typename Policy>
- std::vector<Document> SearchServer::FindTopDocuments(Policy policy, const std::string_view raw_query, DocumentStatus status) const
+template <typename Traits>
+template<typename Policy>
+std::vector<typename BasicSearchServer<Traits>::DocumentType> BasicSearchServer<Traits>::FindTopDocuments(Policy policy, const std::string_view raw_query, DocumentStatus status) const
  {
-     return FindTopDocuments(policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) { return document_status == status; });
- }
\ No newline at end of file
+     return FindTopDocuments(policy, raw_query, [status](DocumentId document_id, DocumentStatus document_status, int rating) { return document_status == status; });
+ }
+
+template <typename Traits>
+template<typename DocumentPredicate>
+std::vector<typename BasicSearchServer<Traits>::DocumentType> BasicSearchServer<Traits>::FindTopDocuments(const QueryContext& query, DocumentPredicate document_predicate) const {
+    return FindTopDocuments(std::execution::seq, query, document_predicate);
+}
+
+template <typename Traits>
+template<typename Policy>
+std::vector<typename BasicSearchServer<Traits>::DocumentType> BasicSearchServer<Traits>::FindTopDocuments(Policy policy, const QueryContext& query, DocumentStatus status) const
+{
+    return FindTopDocuments(policy, query, [status](DocumentId document_id, DocumentStatus document_status, int rating) { return document_status == status; });
+}
+
+template <typename Traits>
+template<typename DocumentPredicate>
+SearchPage BasicSearchServer<Traits>::FindPage(const std::string_view raw_query, DocumentPredicate document_predicate, size_t page_size, const SearchCursor& after) const {
+    return FindPage(std::execution::seq, raw_query, document_predicate, page_size, after);
+}
+
+template <typename Traits>
+template<typename Policy, typename DocumentPredicate>
+SearchPage BasicSearchServer<Traits>::FindPage(Policy policy, const std::string_view raw_query, DocumentPredicate document_predicate, size_t page_size, const SearchCursor& after) const {
+    using namespace std::string_literals;
+    if (page_size == 0) {
+        throw std::invalid_argument("Page size must be positive"s);
+    }
+    MetricsScope metrics(GetFindTopDocumentsEntryPoint<Policy>());
+    QueryContext query;
+    {
+        TRACE_QUERY_STAGE(QueryStage::PARSE);
+        PrepareQuery(raw_query, query);
+    }
+    auto matched_documents = FindAllDocuments(policy, TfIdfScoring(), query, document_predicate);
+
+    TRACE_QUERY_STAGE(QueryStage::SORT_TOP_K);
+    return SelectPage(ToDocuments(std::move(matched_documents)), after, page_size, Traits::EPS);
+}
+
+using SearchServer = BasicSearchServer<DefaultIndexTraits>;
+
+extern template class BasicSearchServer<DefaultIndexTraits>;
+extern template class BasicSearchServer<CompactIndexTraits>;
+extern template class BasicSearchServer<QuantizedIndexTraits>;
+extern template class BasicSearchServer<NarrowIndexTraits>;
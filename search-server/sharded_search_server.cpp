@@ -0,0 +1,134 @@
+#include "sharded_search_server.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <execution>
+#include <mutex>
+#include <stdexcept>
+
+using namespace std::string_literals;
+
+ShardedSearchServer::ShardedSearchServer(const std::string& stop_words_text, size_t shard_count) {
+    if (shard_count == 0) {
+        throw std::invalid_argument("Shard count must be positive"s);
+    }
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.push_back(std::make_unique<Shard>(stop_words_text));
+    }
+}
+
+void ShardedSearchServer::AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    Shard& shard = *shards_[GetShardIndex(document_id)];
+    std::unique_lock lock(shard.mutex);
+    shard.server.AddDocument(document_id, document, status, ratings);
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+    Shard& shard = *shards_[GetShardIndex(document_id)];
+    std::unique_lock lock(shard.mutex);
+    shard.server.RemoveDocument(document_id);
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const {
+    return FindTopDocuments(raw_query, [status](int document_id, DocumentStatus document_status, int rating) { return document_status == status; });
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(const std::string_view raw_query, int document_id) const {
+    const Shard& shard = *shards_[GetShardIndex(document_id)];
+    std::shared_lock lock(shard.mutex);
+    return shard.server.MatchDocument(raw_query, document_id);
+}
+
+void ShardedSearchServer::EnablePositionalIndex() {
+    for (auto& shard : shards_) {
+        std::unique_lock lock(shard->mutex);
+        shard->server.EnablePositionalIndex();
+    }
+}
+
+void ShardedSearchServer::EnableFuzzyMatching(const FuzzyOptions& options) {
+    for (auto& shard : shards_) {
+        std::unique_lock lock(shard->mutex);
+        shard->server.EnableFuzzyMatching(options);
+    }
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+    int document_count = 0;
+    for (const auto& shard : shards_) {
+        std::shared_lock lock(shard->mutex);
+        document_count += shard->server.GetDocumentCount();
+    }
+    return document_count;
+}
+
+size_t ShardedSearchServer::GetShardCount() const {
+    return shards_.size();
+}
+
+size_t ShardedSearchServer::GetShardIndex(int document_id) const {
+    // Multiplicative hashing spreads runs of consecutive ids over all shards
+    const uint64_t hash = static_cast<uint32_t>(document_id) * 0x9E3779B97F4A7C15ull;
+    return (hash >> 32) % shards_.size();
+}
+
+CollectionStatistics ShardedSearchServer::GetCollectionStatistics() const {
+    QueryStatistics total;
+    for (const auto& shard : shards_) {
+        QueryStatistics statistics;
+        {
+            std::shared_lock lock(shard->mutex);
+            statistics.collection = shard->server.GetCollectionStatistics();
+        }
+        AddQueryStatistics(total, statistics);
+    }
+    return total.collection;
+}
+
+QueryContext ShardedSearchServer::PrepareQuery(const std::string_view raw_query) const {
+    // Shards share stop words and settings, any of them parses the same way
+    std::shared_lock lock(shards_.front()->mutex);
+    return shards_.front()->server.PrepareQuery(raw_query);
+}
+
+std::vector<std::shared_lock<std::shared_mutex>> ShardedSearchServer::LockShards() const {
+    // Writers lock a single shard, so taking the shards in index order cannot deadlock
+    std::vector<std::shared_lock<std::shared_mutex>> locks;
+    locks.reserve(shards_.size());
+    for (const auto& shard : shards_) {
+        locks.emplace_back(shard->mutex);
+    }
+    return locks;
+}
+
+QueryStatistics ShardedSearchServer::GetQueryStatistics(const QueryContext& query) const {
+    std::vector<QueryStatistics> shard_statistics(shards_.size());
+    std::transform(std::execution::par, shards_.begin(), shards_.end(), shard_statistics.begin(),
+        [&query](const std::unique_ptr<Shard>& shard)
+        {
+            return shard->server.GetQueryStatistics(query);
+        });
+
+    QueryStatistics total;
+    for (const QueryStatistics& statistics : shard_statistics) {
+        AddQueryStatistics(total, statistics);
+    }
+    return total;
+}
+
+std::vector<Document> ShardedSearchServer::MergeTopDocuments(const std::vector<std::vector<Document>>& shard_documents) {
+    // The global top is among the tops of the shards
+    std::vector<Document> documents;
+    for (const auto& top : shard_documents) {
+        documents.insert(documents.end(), top.begin(), top.end());
+    }
+    std::sort(documents.begin(), documents.end(),
+        [](const Document& lhs, const Document& rhs)
+        {
+            return IsRankedBefore(lhs.relevance, lhs.rating, lhs.id, rhs.relevance, rhs.rating, rhs.id, EPS);
+        });
+    if (documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
+        documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    }
+    return documents;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <execution>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include "search_server.h"
+
+// Documents split by id hash between independent SearchServer shards. Every shard has its own lock,
+// so AddDocument and RemoveDocument on one shard do not wait for queries on the others.
+// A query is scattered to all shards twice: first to sum up the statistics of its words,
+// then to rank with these global statistics, so relevance is the same as of one SearchServer
+// with all documents. A query keeps every shard locked across both scatters, so no write lands
+// between them. Prefix and fuzzy expansions are found in each shard separately,
+// only their document frequencies are global.
+class ShardedSearchServer {
+public:
+    explicit ShardedSearchServer(const std::string& stop_words_text, size_t shard_count);
+
+    void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL) const;
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const;
+    template <typename Scoring, typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const Scoring& scoring, const std::string_view raw_query, DocumentPredicate document_predicate) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view raw_query, int document_id) const;
+
+    void EnablePositionalIndex();
+    void EnableFuzzyMatching(const FuzzyOptions& options = FuzzyOptions());
+
+    int GetDocumentCount() const;
+    size_t GetShardCount() const;
+    size_t GetShardIndex(int document_id) const;
+    CollectionStatistics GetCollectionStatistics() const;
+
+private:
+    struct Shard {
+        explicit Shard(const std::string& stop_words_text)
+            : server(stop_words_text) {
+        }
+
+        SearchServer server;
+        mutable std::shared_mutex mutex;
+    };
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+
+    QueryContext PrepareQuery(const std::string_view raw_query) const;
+    // Shared locks of all shards, always taken in the same order
+    std::vector<std::shared_lock<std::shared_mutex>> LockShards() const;
+    // The caller holds the locks of all shards
+    QueryStatistics GetQueryStatistics(const QueryContext& query) const;
+    static std::vector<Document> MergeTopDocuments(const std::vector<std::vector<Document>>& shard_documents);
+};
+
+template <typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const {
+    return FindTopDocuments(TfIdfScoring(), raw_query, document_predicate);
+}
+
+template <typename Scoring, typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const Scoring& scoring, const std::string_view raw_query, DocumentPredicate document_predicate) const {
+    const QueryContext query = PrepareQuery(raw_query);
+    const auto locks = LockShards();
+    const QueryStatistics statistics = GetQueryStatistics(query);
+
+    std::vector<std::vector<Document>> shard_documents(shards_.size());
+    std::transform(std::execution::par, shards_.begin(), shards_.end(), shard_documents.begin(),
+        [&](const std::unique_ptr<Shard>& shard)
+        {
+            return shard->server.FindTopDocuments(scoring, std::execution::seq, query, document_predicate, statistics);
+        });
+    return MergeTopDocuments(shard_documents);
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <vector>
+
+// Vector that keeps the first N elements inline and spills to the heap only when it grows beyond N.
+// clear() keeps the heap capacity, so a reused SmallVector stops allocating after warm-up.
+template <typename T, size_t N>
+class SmallVector {
+public:
+    using value_type = T;
+    using iterator = T*;
+    using const_iterator = const T*;
+
+    void push_back(const T& value) {
+        if (!on_heap_ && size_ < N) {
+            inline_[size_++] = value;
+            return;
+        }
+        if (!on_heap_) {
+            heap_.assign(inline_.begin(), inline_.begin() + size_);
+            on_heap_ = true;
+        }
+        heap_.push_back(value);
+        ++size_;
+    }
+
+    void clear() {
+        size_ = 0;
+        heap_.clear();
+        on_heap_ = false;
+    }
+
+    // Erases [first, last) keeping the order of the remaining elements
+    iterator erase(iterator first, iterator last) {
+        iterator new_end = std::move(last, end(), first);
+        const size_t new_size = static_cast<size_t>(new_end - begin());
+        if (on_heap_) {
+            heap_.resize(new_size);
+        }
+        size_ = new_size;
+        return first;
+    }
+
+    T* data() {
+        return on_heap_ ? heap_.data() : inline_.data();
+    }
+
+    const T* data() const {
+        return on_heap_ ? heap_.data() : inline_.data();
+    }
+
+    iterator begin() {
+        return data();
+    }
+
+    iterator end() {
+        return data() + size_;
+    }
+
+    const_iterator begin() const {
+        return data();
+    }
+
+    const_iterator end() const {
+        return data() + size_;
+    }
+
+    T& operator[](size_t index) {
+        return data()[index];
+    }
+
+    const T& operator[](size_t index) const {
+        return data()[index];
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+private:
+    std::array<T, N> inline_ = {};
+    std::vector<T> heap_;
+    size_t size_ = 0;
+    bool on_heap_ = false;
+};
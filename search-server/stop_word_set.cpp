@@ -0,0 +1,30 @@
+#include "stop_word_set.h"
+
+StopWordSet::StopWordSet(const std::set<std::string, std::less<>>& words)
+    : words_(words.begin(), words.end())
+    , slots_(ComputeStopWordTableSize(words.size()))
+    , mask_(slots_.size() - 1)
+{
+    for (size_t word_index = 0; word_index < words_.size(); ++word_index) {
+        const uint64_t hash = HashString(words_[word_index]);
+        size_t index = hash & mask_;
+        while (slots_[index].word_index != EMPTY_SLOT) {
+            index = (index + 1) & mask_;
+        }
+        slots_[index].hash = hash;
+        slots_[index].word_index = static_cast<uint32_t>(word_index);
+    }
+}
+
+StructureMemoryUsage StopWordSet::GetMemoryUsage() const {
+    StructureMemoryUsage usage;
+    usage.name = "stop_words_";
+    usage.node_count = words_.size();
+    usage.AddAllocations(words_.capacity() > 0 ? 1 : 0, words_.capacity() * sizeof(std::string));
+    usage.AddAllocations(slots_.capacity() > 0 ? 1 : 0, slots_.capacity() * sizeof(Slot));
+    for (const std::string& word : words_) {
+        const size_t heap_size = GetStringHeapSize(word);
+        usage.AddAllocations(heap_size > 0 ? 1 : 0, heap_size);
+    }
+    return usage;
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "hash_utils.h"
+#include "memory_usage.h"
+
+// Open-addressing table size for the given number of words: a power of two with load factor <= 0.5
+constexpr size_t ComputeStopWordTableSize(size_t word_count) {
+    size_t size = 2;
+    while (size < word_count * 2) {
+        size *= 2;
+    }
+    return size;
+}
+
+// Stop word set for lists known at compile time. The hash table is built by the compiler,
+// so lookups in it are a hash of the word plus a short probe with no allocation.
+template <size_t WordCount>
+class StaticStopWordSet {
+public:
+    static constexpr size_t TABLE_SIZE = ComputeStopWordTableSize(WordCount);
+    static constexpr uint32_t EMPTY_SLOT = UINT32_MAX;
+
+    struct Slot {
+        uint64_t hash = 0;
+        uint32_t word_index = EMPTY_SLOT;
+    };
+
+    constexpr explicit StaticStopWordSet(const std::array<std::string_view, WordCount>& words) {
+        for (const std::string_view word : words) {
+            if (word.empty() || Contains(word)) {
+                continue;
+            }
+            const uint64_t hash = HashString(word);
+            size_t index = hash & (TABLE_SIZE - 1);
+            while (slots_[index].word_index != EMPTY_SLOT) {
+                index = (index + 1) & (TABLE_SIZE - 1);
+            }
+            words_[word_count_] = word;
+            slots_[index].hash = hash;
+            slots_[index].word_index = static_cast<uint32_t>(word_count_);
+            ++word_count_;
+        }
+    }
+
+    constexpr bool Contains(std::string_view word) const {
+        const uint64_t hash = HashString(word);
+        for (size_t index = hash & (TABLE_SIZE - 1); slots_[index].word_index != EMPTY_SLOT; index = (index + 1) & (TABLE_SIZE - 1)) {
+            if (slots_[index].hash == hash && words_[slots_[index].word_index] == word) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    constexpr size_t size() const {
+        return word_count_;
+    }
+
+    constexpr const std::array<std::string_view, WordCount>& GetWords() const {
+        return words_;
+    }
+
+    constexpr const std::array<Slot, TABLE_SIZE>& GetSlots() const {
+        return slots_;
+    }
+
+private:
+    std::array<std::string_view, WordCount> words_ = {};
+    std::array<Slot, TABLE_SIZE> slots_ = {};
+    size_t word_count_ = 0;
+};
+
+// Builds a StaticStopWordSet from string literals, e.g.
+// constexpr auto stop_words = MakeStaticStopWordSet("in", "the", "with");
+template <typename... Words>
+constexpr auto MakeStaticStopWordSet(Words... words) {
+    return StaticStopWordSet<sizeof...(Words)>(std::array<std::string_view, sizeof...(Words)>{ std::string_view(words)... });
+}
+
+// Stop word set used by SearchServer: a flat open-addressing hash table built once at construction.
+// Each slot keeps the full hash, so a miss almost never touches the word itself.
+class StopWordSet {
+public:
+    StopWordSet() = default;
+    explicit StopWordSet(const std::set<std::string, std::less<>>& words);
+
+    template <size_t WordCount>
+    explicit StopWordSet(const StaticStopWordSet<WordCount>& words);
+
+    bool Contains(std::string_view word) const {
+        if (words_.empty()) {
+            return false;
+        }
+        const uint64_t hash = HashString(word);
+        for (size_t index = hash & mask_; slots_[index].word_index != EMPTY_SLOT; index = (index + 1) & mask_) {
+            if (slots_[index].hash == hash && words_[slots_[index].word_index] == word) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t size() const {
+        return words_.size();
+    }
+
+    std::vector<std::string>::const_iterator begin() const {
+        return words_.begin();
+    }
+
+    std::vector<std::string>::const_iterator end() const {
+        return words_.end();
+    }
+
+    StructureMemoryUsage GetMemoryUsage() const;
+
+private:
+    static constexpr uint32_t EMPTY_SLOT = UINT32_MAX;
+
+    struct Slot {
+        uint64_t hash = 0;
+        uint32_t word_index = EMPTY_SLOT;
+    };
+
+    std::vector<std::string> words_;
+    std::vector<Slot> slots_;
+    size_t mask_ = 0;
+};
+
+template <size_t WordCount>
+StopWordSet::StopWordSet(const StaticStopWordSet<WordCount>& words)
+    : slots_(StaticStopWordSet<WordCount>::TABLE_SIZE)
+    , mask_(StaticStopWordSet<WordCount>::TABLE_SIZE - 1)
+{
+    // The table is already hashed at compile time, only the slots are copied
+    words_.reserve(words.size());
+    for (size_t i = 0; i < words.size(); ++i) {
+        words_.emplace_back(words.GetWords()[i]);
+    }
+    for (size_t i = 0; i < slots_.size(); ++i) {
+        slots_[i].hash = words.GetSlots()[i].hash;
+        slots_[i].word_index = words.GetSlots()[i].word_index;
+    }
+}
@@ -4,18 +4,7 @@ using namespace std::string_literals;
 
 std::vector<std::string_view> SplitIntoWordsSV(std::string_view str) {
     std::vector<std::string_view> result;
-    const size_t last = str.npos;
-    while (true) {
-        size_t space = str.find(' ');
-        result.push_back(str.substr(0, space));
-        if (space == last) {
-            break;
-        }
-        else {
-            str.remove_prefix(space + 1);
-        }
-    }
- 
+    ForEachWordSV(str, [&result](std::string_view word) { result.push_back(word); });
     return result;
 }
 
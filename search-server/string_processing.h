@@ -2,10 +2,27 @@
 #include <vector>
 #include <string>
 #include <set>
+#include <string_view>
 
 std::vector<std::string> SplitIntoWords(const std::string& text);
 std::vector<std::string_view> SplitIntoWordsSV(std::string_view text);
 
+// Calls callback for every space separated word of str without building a vector of words
+template <typename Callback>
+void ForEachWordSV(std::string_view str, Callback callback) {
+    const size_t last = str.npos;
+    while (true) {
+        size_t space = str.find(' ');
+        callback(str.substr(0, space));
+        if (space == last) {
+            break;
+        }
+        else {
+            str.remove_prefix(space + 1);
+        }
+    }
+}
+
 template <typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
     std::set<std::string, std::less<>> non_empty_strings;
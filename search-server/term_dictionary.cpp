@@ -0,0 +1,49 @@
+#include "term_dictionary.h"
+
+#include <algorithm>
+
+FrontCodedDictionary::FrontCodedDictionary(const std::vector<std::string_view>& sorted_words)
+    : word_count_(sorted_words.size()) {
+    std::string_view previous;
+    for (size_t i = 0; i < sorted_words.size(); ++i) {
+        const std::string_view word = sorted_words[i];
+        size_t shared = 0;
+        if (i % BLOCK_SIZE == 0) {
+            block_offsets_.push_back(static_cast<uint32_t>(data_.size()));
+        }
+        else {
+            const size_t max_shared = std::min(previous.size(), word.size());
+            while (shared < max_shared && previous[shared] == word[shared]) {
+                ++shared;
+            }
+        }
+        AppendVarint(data_, static_cast<uint32_t>(shared));
+        AppendVarint(data_, static_cast<uint32_t>(word.size() - shared));
+        data_.insert(data_.end(), word.begin() + shared, word.end());
+        previous = word;
+    }
+    data_.shrink_to_fit();
+}
+
+std::string_view FrontCodedDictionary::GetBlockHead(size_t block) const {
+    const uint8_t* input = data_.data() + block_offsets_[block];
+    ReadVarint(input);
+    const uint32_t size = ReadVarint(input);
+    return std::string_view(reinterpret_cast<const char*>(input), size);
+}
+
+size_t FrontCodedDictionary::FindFirstBlock(std::string_view prefix) const {
+    // The first block whose head is not less than prefix; words before it may still match
+    size_t first = 0;
+    size_t last = block_offsets_.size();
+    while (first < last) {
+        const size_t middle = first + (last - first) / 2;
+        if (GetBlockHead(middle) < prefix) {
+            first = middle + 1;
+        }
+        else {
+            last = middle;
+        }
+    }
+    return first == 0 ? 0 : first - 1;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "varint.h"
+
+// Immutable sorted dictionary of words compressed with front coding: words are grouped into
+// blocks of BLOCK_SIZE, the first word of a block is stored whole and every next one as
+// the length of the prefix shared with the previous word plus the rest of it.
+// A lookup binary searches the block heads and decodes at most a block before the first match.
+class FrontCodedDictionary {
+public:
+    static const size_t BLOCK_SIZE = 16;
+
+    FrontCodedDictionary() = default;
+    // Words must be sorted and unique
+    explicit FrontCodedDictionary(const std::vector<std::string_view>& sorted_words);
+
+    size_t size() const {
+        return word_count_;
+    }
+
+    const std::vector<uint8_t>& GetData() const {
+        return data_;
+    }
+
+    const std::vector<uint32_t>& GetBlockOffsets() const {
+        return block_offsets_;
+    }
+
+    // Calls callback(word) for the words starting with prefix in lexicographic order,
+    // stops when callback returns false. The view passed to callback lives until the next call.
+    template <typename Callback>
+    void ForEachWithPrefix(std::string_view prefix, Callback callback) const;
+
+private:
+    std::vector<uint8_t> data_;
+    std::vector<uint32_t> block_offsets_;
+    size_t word_count_ = 0;
+
+    std::string_view GetBlockHead(size_t block) const;
+    // Index of the block that can hold the first word not less than prefix
+    size_t FindFirstBlock(std::string_view prefix) const;
+};
+
+template <typename Callback>
+void FrontCodedDictionary::ForEachWithPrefix(std::string_view prefix, Callback callback) const {
+    if (word_count_ == 0) {
+        return;
+    }
+    std::string word;
+    for (size_t block = FindFirstBlock(prefix); block < block_offsets_.size(); ++block) {
+        const uint8_t* input = data_.data() + block_offsets_[block];
+        const uint8_t* const end = block + 1 < block_offsets_.size() ? data_.data() + block_offsets_[block + 1] : data_.data() + data_.size();
+        word.clear();
+        while (input < end) {
+            const uint32_t shared = ReadVarint(input);
+            const uint32_t suffix_size = ReadVarint(input);
+            word.resize(shared);
+            word.append(reinterpret_cast<const char*>(input), suffix_size);
+            input += suffix_size;
+
+            if (word.compare(0, prefix.size(), prefix) < 0) {
+                continue;
+            }
+            if (std::string_view(word).substr(0, prefix.size()) != prefix) {
+                return;
+            }
+            if (!callback(std::string_view(word))) {
+                return;
+            }
+        }
+    }
+}
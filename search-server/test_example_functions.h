@@ -3,7 +3,21 @@
 #include <vector>
 #include <execution>
 #include "search_server.h"
+#include "sharded_search_server.h"
+#include "hot_swap_search_server.h"
 #include "RemoveDuplicates.h"
+#include "near_duplicates.h"
+#include "request_queue.h"
+#include "workload.h"
+#include "process_queries.h"
+#include "async_queries.h"
+#include "query_client.h"
+#include "query_server.h"
+#include "replication.h"
+#include <thread>
+#include <atomic>
+#include <future>
+#include <sstream>
 #include "read_input_functions.h"
 
 using namespace std;
@@ -398,10 +412,1391 @@ void TestRemoveDuplicates() {
         AddDocument(search_server, 9, "nasty rat with curly hair"s, DocumentStatus::ACTUAL, { 1, 2 });
 
         std::cout << "Before duplicates removed: "s << search_server.GetDocumentCount() << std::endl;
-        RemoveDuplicates(search_server);
+        const vector<int> removed_ids = RemoveDuplicates(search_server);
+        ASSERT(removed_ids == vector<int>({ 3, 4, 5, 7 }));
+        ASSERT_EQUAL(search_server.GetDocumentCount(), 5);
+        ASSERT(search_server.FindTopDocuments("curly"s).size() == 2u);
        std::cout << "After duplicates removed: "s << search_server.GetDocumentCount() << std::endl;
     }
 
+void TestQueryContext() {
+    SearchServer server("in the"s);
+    server.AddDocument(1, "cat in the city"s, DocumentStatus::ACTUAL, { 1, 2, 3 });
+    server.AddDocument(2, "dog in the village"s, DocumentStatus::ACTUAL, { 1, 2, 3 });
+    server.AddDocument(3, "cat and dog"s, DocumentStatus::BANNED, { 1, 2, 3 });
+
+    const string raw_query = "dog cat the cat -village"s;
+    QueryContext query;
+    server.PrepareQuery(raw_query, query);
+    ASSERT_EQUAL(query.plus_words.size(), 2u);
+    ASSERT_EQUAL(query.minus_words.size(), 1u);
+
+    //The prepared query gives the same results as the raw one and can be reused
+    for (int i = 0; i < 2; ++i) {
+        const auto found_docs = server.FindTopDocuments(query);
+        const auto found_docs_raw = server.FindTopDocuments(raw_query);
+        ASSERT_EQUAL(found_docs.size(), found_docs_raw.size());
+        ASSERT_EQUAL(found_docs.size(), 1u);
+        ASSERT_EQUAL(found_docs[0].id, 1);
+        ASSERT_EQUAL(server.FindTopDocuments(std::execution::par, query, DocumentStatus::BANNED).size(), 1u);
+    }
+
+    const auto [words, status] = server.MatchDocument(query, 3);
+    const auto [words_par, status_par] = server.MatchDocument(std::execution::par, query, 3);
+    ASSERT_EQUAL(words.size(), 2u);
+    ASSERT_EQUAL(words, words_par);
+    ASSERT_EQUAL(status, DocumentStatus::BANNED);
+    ASSERT(get<0>(server.MatchDocument(std::execution::par, query, 2)).empty());
+
+    //Queries longer than the inline buffer spill to the heap transparently
+    string long_query;
+    for (int i = 0; i < 100; ++i) {
+        long_query += "w"s + to_string(i) + " "s;
+    }
+    long_query += "cat"s;
+    server.PrepareQuery(long_query, query);
+    ASSERT_EQUAL(query.plus_words.size(), 101u);
+    ASSERT_EQUAL(server.FindTopDocuments(query).size(), 1u);
+}
+
+void TestStopWordSet() {
+    const StopWordSet stop_words(MakeUniqueNonEmptyStrings(SplitIntoWordsSV("in the  with in"s)));
+    ASSERT_EQUAL(stop_words.size(), 3u);
+    ASSERT(stop_words.Contains("in"s));
+    ASSERT(stop_words.Contains("with"s));
+    ASSERT(!stop_words.Contains("cat"s));
+    ASSERT(!stop_words.Contains(""s));
+
+    //The compile time set is hashed by the compiler and can be queried in constant expressions
+    constexpr auto static_stop_words = MakeStaticStopWordSet("in", "the", "with", "the", "");
+    static_assert(static_stop_words.size() == 3);
+    static_assert(static_stop_words.Contains("the"));
+    static_assert(!static_stop_words.Contains("cat"));
+
+    SearchServer server(static_stop_words);
+    ASSERT_EQUAL(server.GetStopWordsCount(), 3);
+    server.AddDocument(1, "cat in the city"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT(server.FindTopDocuments("the"s).empty());
+    ASSERT_EQUAL(server.FindTopDocuments("cat"s).size(), 1u);
+    ASSERT_EQUAL(get<0>(server.MatchDocument("cat in city"s, 1)).size(), 2u);
+
+    //A large stop list is looked up by hash, not by comparison with every word
+    vector<string> many_words;
+    for (int i = 0; i < 600; ++i) {
+        many_words.push_back("stop"s + to_string(i));
+    }
+    SearchServer big_server(many_words);
+    ASSERT_EQUAL(big_server.GetStopWordsCount(), 600);
+    big_server.AddDocument(1, "stop1 stop599 word"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT_EQUAL(big_server.GetWordFrequencies(1).size(), 1u);
+}
+
+void TestMatchDocuments() {
+    SearchServer server("and with"s);
+    server.AddDocument(1, "white cat and fashion collar"s, DocumentStatus::ACTUAL, { 8, -3 });
+    server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::BANNED, { 5, -12, 2, 1 });
+    server.AddDocument(4, ""s, DocumentStatus::ACTUAL, {});
+    string long_document = "cat"s;
+    for (int i = 0; i < 100; ++i) {
+        long_document += " word"s + to_string(i);
+    }
+    server.AddDocument(5, long_document, DocumentStatus::IRRELEVANT, { 1 });
+
+    const vector<int> ids = { 1, 2, 3, 4, 5 };
+    for (const string& query : { "fluffy groomed cat"s, "cat -tail word7"s, "word99 word0 snake"s, "-cat"s }) {
+        const auto matches = server.MatchDocuments(query, ids);
+        ASSERT_EQUAL(matches.size(), ids.size());
+        //Batch matching gives the same words and statuses as matching documents one by one
+        for (size_t i = 0; i < ids.size(); ++i) {
+            const auto [words, status] = server.MatchDocument(query, ids[i]);
+            ASSERT_EQUAL(get<0>(matches[i]), words);
+            ASSERT_EQUAL(get<1>(matches[i]), status);
+        }
+    }
+
+    const string query = "cat -tail word7"s;
+    const auto matches = server.MatchDocuments(query, { 5, 2 });
+    ASSERT_EQUAL(get<0>(matches[0]), vector<string_view>({ "cat"sv, "word7"sv }));
+    ASSERT(get<0>(matches[1]).empty());
+
+    bool thrown = false;
+    try {
+        server.MatchDocuments("cat"s, { 1, 100 });
+    }
+    catch (const out_of_range&) {
+        thrown = true;
+    }
+    ASSERT(thrown);
+}
+
+void TestNearDuplicates() {
+    SearchServer server("and with"s);
+    string base_text;
+    for (int i = 0; i < 30; ++i) {
+        base_text += "word"s + to_string(i) + " "s;
+    }
+    server.AddDocument(1, base_text + "alpha"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, base_text + "beta"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(3, "cat dog rat and bird"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(4, "white cat with fashion collar"s, DocumentStatus::ACTUAL, { 1 });
+
+    NearDuplicateDetector detector(NearDuplicateOptions{ 16, 4, 0.7 });
+    detector.Update(server);
+    ASSERT_EQUAL(detector.GetDocumentCount(), 4);
+    ASSERT(detector.EstimateSimilarity(1, 2) > 0.7);
+    ASSERT(detector.EstimateSimilarity(1, 3) < 0.3);
+    {
+        const auto clusters = detector.FindClusters();
+        ASSERT_EQUAL(clusters.size(), 1u);
+        ASSERT(clusters[0] == vector<int>({ 1, 2 }));
+    }
+
+    //Incremental updates follow added and removed documents
+    server.AddDocument(5, base_text + "gamma"s, DocumentStatus::ACTUAL, { 1 });
+    server.RemoveDocument(1);
+    detector.Update(server);
+    ASSERT_EQUAL(detector.GetDocumentCount(), 4);
+    {
+        const auto clusters = detector.FindClusters();
+        ASSERT_EQUAL(clusters.size(), 1u);
+        ASSERT(clusters[0] == vector<int>({ 2, 5 }));
+    }
+}
+
+void TestRequestStatistics() {
+    using namespace std::chrono_literals;
+    const auto start = RequestStatistics::Clock::now();
+    RequestStatistics statistics(4, start);
+
+    statistics.Record(0, DocumentStatus::ACTUAL, start + 1s);
+    statistics.Record(3, DocumentStatus::ACTUAL, start + 2s);
+    statistics.Record(5, std::nullopt, start + 30min);
+    {
+        const auto hour = statistics.GetSnapshot(StatisticsWindow::HOUR, start + 50min);
+        ASSERT_EQUAL(hour.request_count, 3u);
+        ASSERT_EQUAL(hour.empty_result_count, 1u);
+    }
+    statistics.Record(7, DocumentStatus::BANNED, start + 5h);
+
+    //The last minute only sees the latest request, the last day sees all of them
+    {
+        const auto minute = statistics.GetSnapshot(StatisticsWindow::MINUTE, start + 5h + 10s);
+        ASSERT_EQUAL(minute.request_count, 1u);
+        ASSERT_EQUAL(minute.result_count_distribution[RESULT_COUNT_SLOTS - 1], 1u);
+        ASSERT_EQUAL(minute.status_filter_counts[static_cast<int>(DocumentStatus::BANNED)], 1u);
+
+        const auto day = statistics.GetSnapshot(StatisticsWindow::DAY, start + 5h + 10s);
+        ASSERT_EQUAL(day.request_count, 4u);
+        ASSERT_EQUAL(day.status_filter_counts[STATUS_FILTER_SLOTS - 1], 1u);
+        ASSERT(abs(day.empty_result_rate - 0.25) < 1e-9);
+
+        const auto next_day = statistics.GetSnapshot(StatisticsWindow::DAY, start + 30h);
+        ASSERT_EQUAL(next_day.request_count, 0u);
+    }
+
+    //Many threads record concurrently without losing requests
+    SearchServer server(""s);
+    server.AddDocument(1, "cat in the city"s, DocumentStatus::ACTUAL, { 1 });
+    ConcurrentRequestQueue queue(server);
+    vector<thread> threads;
+    for (int i = 0; i < 8; ++i) {
+        threads.emplace_back([&queue]() {
+            for (int j = 0; j < 1000; ++j) {
+                queue.AddFindRequest(j % 2 ? "cat"sv : "dog"sv);
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    const auto snapshot = queue.GetStatistics(StatisticsWindow::HOUR);
+    ASSERT_EQUAL(snapshot.request_count, 8000u);
+    ASSERT_EQUAL(queue.GetNoResultRequests(), 4000);
+    ASSERT_EQUAL(snapshot.result_count_distribution[1], 4000u);
+
+    //Threads sharing one shard recycle buckets concurrently without losing requests
+    RequestStatistics shared_statistics(1, start);
+    threads.clear();
+    for (int i = 0; i < 8; ++i) {
+        threads.emplace_back([&shared_statistics, start]() {
+            for (int j = 0; j < 1000; ++j) {
+                shared_statistics.Record(1, DocumentStatus::ACTUAL, start + std::chrono::milliseconds(j * 5));
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    ASSERT_EQUAL(shared_statistics.GetSnapshot(StatisticsWindow::MINUTE, start + 10s).request_count, 8000u);
+    ASSERT_EQUAL(shared_statistics.GetSnapshot(StatisticsWindow::HOUR, start + 10s).request_count, 8000u);
+}
+
+void TestQueryTrace() {
+    ResetQueryTrace();
+    {
+        QueryStageSpan span(QueryStage::POSTINGS);
+    }
+    thread([]() {
+        QueryStageSpan span(QueryStage::POSTINGS);
+        QueryStageSpan other_span(QueryStage::PARSE);
+    }).join();
+
+    //Spans of all threads are aggregated on demand
+    const QueryTrace trace = CollectQueryTrace();
+    ASSERT_EQUAL(trace[static_cast<int>(QueryStage::POSTINGS)].span_count, 2u);
+    ASSERT_EQUAL(trace[static_cast<int>(QueryStage::PARSE)].span_count, 1u);
+    ASSERT(trace[static_cast<int>(QueryStage::POSTINGS)].max_ns <= trace[static_cast<int>(QueryStage::POSTINGS)].total_ns);
+
+    ResetQueryTrace();
+    ASSERT_EQUAL(CollectQueryTrace()[static_cast<int>(QueryStage::POSTINGS)].span_count, 0u);
+
+    //Stage names are used by the text report
+    ostringstream report;
+    report << trace;
+    ASSERT(report.str().find("postings: 2 spans"s) != string::npos);
+}
+
+void TestMetrics() {
+    SearchServerMetrics& metrics = GetSearchServerMetrics();
+    metrics.Reset();
+
+    SearchServer server("and with"s);
+    server.AddDocument(1, "white cat and fashion collar"s, DocumentStatus::ACTUAL, { 8, -3 });
+    server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    AddDocument(server, 2, "duplicate id"s, DocumentStatus::ACTUAL, { 1 });
+
+    server.FindTopDocuments("cat -tail"s);
+    server.FindTopDocuments(std::execution::par, "fluffy cat"s);
+    server.MatchDocument("cat"s, 1);
+    server.RemoveDocument(1);
+
+    //Delegating overloads are counted once, exceptions are counted as errors
+    const auto& add = metrics.Get(MetricsEntryPoint::ADD_DOCUMENT);
+    ASSERT_EQUAL(add.calls.load(), 3u);
+    ASSERT_EQUAL(add.errors.load(), 1u);
+    ASSERT_EQUAL(add.latency_ns.GetCount(), 3u);
+
+    const auto& find_seq = metrics.Get(MetricsEntryPoint::FIND_TOP_DOCUMENTS_SEQ);
+    ASSERT_EQUAL(find_seq.calls.load(), 1u);
+    ASSERT_EQUAL(find_seq.postings_touched.load(), 3u);
+    ASSERT_EQUAL(find_seq.documents_scored.load(), 2u);
+
+    const auto& find_par = metrics.Get(MetricsEntryPoint::FIND_TOP_DOCUMENTS_PAR);
+    ASSERT_EQUAL(find_par.calls.load(), 1u);
+    ASSERT_EQUAL(find_par.postings_touched.load(), 3u);
+    ASSERT_EQUAL(metrics.Get(MetricsEntryPoint::MATCH_DOCUMENT).calls.load(), 1u);
+    ASSERT_EQUAL(metrics.Get(MetricsEntryPoint::REMOVE_DOCUMENT).calls.load(), 1u);
+
+    //Quantiles are within 1/16 of the recorded values
+    HdrHistogram histogram;
+    for (uint64_t value = 1; value <= 1000; ++value) {
+        histogram.Record(value * 1000);
+    }
+    ASSERT_EQUAL(histogram.GetCount(), 1000u);
+    ASSERT(histogram.GetValueAtQuantile(0.5) >= 500000u && histogram.GetValueAtQuantile(0.5) <= 500000u * 17 / 16);
+    ASSERT(histogram.GetValueAtQuantile(1.0) >= 1000000u);
+
+    ostringstream snapshot;
+    metrics.WriteSnapshot(snapshot);
+    ASSERT(snapshot.str().find("search_server_calls_total{entry=\"add_document\"} 3"s) != string::npos);
+    ASSERT(snapshot.str().find("search_server_latency_seconds_count{entry=\"find_top_documents_par\"} 1"s) != string::npos);
+}
+
+void TestWorkload() {
+    //Frequencies fall with the rank
+    const ZipfDistribution zipf(100, 1.0);
+    ASSERT_EQUAL(zipf.GetSize(), 100u);
+    ASSERT(std::abs(zipf.GetProbability(0) / zipf.GetProbability(1) - 2.0) < 1e-9);
+    std::mt19937 generator(1);
+    std::vector<int> counts(100);
+    for (int i = 0; i < 100000; ++i) {
+        ++counts[zipf(generator)];
+    }
+    ASSERT(counts[0] > counts[1] && counts[1] > counts[9] && counts[9] > counts[99]);
+    ASSERT(std::abs(counts[0] / 100000.0 - zipf.GetProbability(0)) < 0.01);
+
+    WorkloadOptions options;
+    options.vocabulary = 200;
+    options.documents = 50;
+    options.max_document_words = 40;
+    options.queries = 30;
+    const Workload workload = GenerateWorkload(options);
+    ASSERT_EQUAL(workload.dictionary.size(), 200u);
+    ASSERT_EQUAL(workload.documents.size(), 50u);
+    ASSERT_EQUAL(workload.queries.size(), 30u);
+    for (const string& query : workload.queries) {
+        const auto words = SplitIntoWordsSV(query);
+        ASSERT(!words.empty() && words.size() <= 8);
+    }
+
+    //Same seed, same workload
+    ASSERT(GenerateWorkload(options).documents == workload.documents);
+}
+
+void TestMemoryUsage() {
+    ASSERT_EQUAL(GetMallocChunkSize(1), 32u);
+    ASSERT_EQUAL(GetMallocChunkSize(24), 32u);
+    ASSERT_EQUAL(GetMallocChunkSize(25), 48u);
+
+    SearchServer server("and with"s);
+    const auto find_structure = [](const MemoryUsage& usage, std::string_view name) {
+        for (const auto& structure : usage.structures) {
+            if (structure.name == name) {
+                return structure;
+            }
+        }
+        return StructureMemoryUsage();
+    };
+    ASSERT_EQUAL(find_structure(server.GetMemoryUsage(), "word_to_document_freqs_SV_"sv).node_count, 0u);
+
+    server.AddDocument(1, "white cat and fashion collar"s, DocumentStatus::ACTUAL, { 8, -3 });
+    server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    MemoryUsage usage = server.GetMemoryUsage();
+    ASSERT_EQUAL(usage.document_count, 2u);
+    //6 words plus 4 + 3 postings
+    ASSERT_EQUAL(find_structure(usage, "word_to_document_freqs_SV_"sv).node_count, 13u);
+    //The forward index is the term ids kept in documents_, frequencies are decoded from the postings
+    ASSERT(find_structure(usage, "id_to_document_freqs_SV_"sv).name.empty());
+    ASSERT_EQUAL(server.GetWordFrequencies(2).at("fluffy"sv), 0.5);
+    ASSERT_EQUAL(find_structure(usage, "documents_"sv).node_count, 2u);
+    ASSERT_EQUAL(find_structure(usage, "doc_content_"sv).node_count, 2u);
+    ASSERT_EQUAL(find_structure(usage, "stop_words_"sv).node_count, 2u);
+    for (const auto& structure : usage.structures) {
+        ASSERT(structure.GetTotalBytes() > 0 || structure.name == "positions"sv || structure.name == "term_dictionary_"sv || structure.name == "fuzzy_index_"sv);
+    }
+    ASSERT(usage.GetBytesPerDocument() * 2 == usage.GetTotalBytes());
+
+    const size_t documents_bytes = find_structure(usage, "documents_"sv).GetTotalBytes();
+    server.RemoveDocument(1);
+    usage = server.GetMemoryUsage();
+    ASSERT_EQUAL(find_structure(usage, "word_to_document_freqs_SV_"sv).node_count, 6u + 3u);
+    ASSERT(find_structure(usage, "documents_"sv).GetTotalBytes() < documents_bytes);
+    server.RemoveDocuments({ 2 });
+    usage = server.GetMemoryUsage();
+    ASSERT_EQUAL(find_structure(usage, "documents_"sv).GetTotalBytes(), 0u);
+    ASSERT(server.GetWordFrequencies(2).empty());
+
+    ostringstream output;
+    output << usage;
+    ASSERT(output.str().find("doc_content_: "s) != string::npos);
+}
+
+void TestPostingList() {
+    PostingList postings;
+    map<int, uint32_t> expected;
+    const auto collect = [](const PostingList& list, int lower_id, int upper_id) {
+        map<int, uint32_t> result;
+        int previous = -1;
+        list.ForEachInRange(lower_id, upper_id, [&result, &previous](int document_id, uint32_t occurrences) {
+            ASSERT(document_id > previous);
+            previous = document_id;
+            result[document_id] = occurrences;
+            return true;
+        });
+        return result;
+    };
+
+    //In order adds fill whole blocks, values of every byte length survive
+    for (int id = 0; id < 1000; ++id) {
+        const int document_id = id * 3 + (id % 7 == 0 ? 70000 * id : 0);
+        const uint32_t occurrences = id % 50 == 0 ? 100000000u + id : 1u + id % 4;
+        postings.Add(document_id, occurrences);
+        expected[document_id] = occurrences;
+    }
+    ASSERT_EQUAL(postings.size(), expected.size());
+    ASSERT(collect(postings, INT_MIN, INT_MAX) == expected);
+
+    //Out of order adds, erasures and adds of erased ids, checked against a map
+    std::mt19937 generator(17);
+    for (int step = 0; step < 5000; ++step) {
+        const int document_id = uniform_int_distribution<int>(0, 3000)(generator);
+        if (expected.count(document_id)) {
+            ASSERT(postings.Erase(document_id));
+            expected.erase(document_id);
+        }
+        else {
+            ASSERT(!postings.Erase(document_id));
+            postings.Add(document_id, static_cast<uint32_t>(step % 9 + 1));
+            expected[document_id] = step % 9 + 1;
+        }
+    }
+    ASSERT_EQUAL(postings.size(), expected.size());
+    ASSERT(collect(postings, INT_MIN, INT_MAX) == expected);
+    const map<int, uint32_t> range(expected.lower_bound(1000), expected.upper_bound(2000));
+    ASSERT(collect(postings, 1000, 2000) == range);
+
+    size_t visited = 0;
+    ASSERT(!postings.ForEach([&visited](int, uint32_t) { return ++visited < 10; }));
+    ASSERT_EQUAL(visited, 10u);
+
+    //A long list takes a few bytes per posting
+    PostingList dense;
+    for (int id = 0; id < 100000; ++id) {
+        dense.Add(id * 2, 1);
+    }
+    ASSERT(dense.GetHeapUsage().GetTotalBytes() < 4 * dense.size());
+
+    //Relevance does not change with compressed postings
+    SearchServer server("and with"s);
+    server.AddDocument(1, "white cat and fashion collar cat"s, DocumentStatus::ACTUAL, { 8, -3 });
+    server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    const auto documents = server.FindTopDocuments("fluffy cat"s);
+    ASSERT_EQUAL(documents.size(), 2u);
+    ASSERT_EQUAL(documents[0].id, 2);
+    ASSERT(abs(documents[0].relevance - 0.5 * log(2.0)) < EPS);
+    ASSERT_EQUAL(server.GetWordFrequencies(1).at("cat"sv), 2.0 / 5);
+}
+
+void TestIndexTraits() {
+    const vector<string> texts = { "white cat and fashion collar"s, "fluffy cat fluffy tail"s, "groomed dog expressive eyes"s,
+                                   "groomed starling evgeny"s, "fluffy dog and cat"s };
+    SearchServer server("and with"s);
+    BasicSearchServer<CompactIndexTraits> compact_server("and with"s);
+    BasicSearchServer<QuantizedIndexTraits> quantized_server("and with"s);
+    for (int id = 0; id < static_cast<int>(texts.size()); ++id) {
+        server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, { id });
+        compact_server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, { id });
+        quantized_server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, { id });
+    }
+
+    //Same ranking, relevance within the precision of the score type
+    const auto expected = server.FindTopDocuments("fluffy groomed cat -collar"s);
+    const auto compact = compact_server.FindTopDocuments("fluffy groomed cat -collar"s);
+    const auto quantized = quantized_server.FindTopDocuments(std::execution::par, "fluffy groomed cat -collar"s);
+    ASSERT_EQUAL(compact.size(), expected.size());
+    ASSERT_EQUAL(quantized.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        ASSERT_EQUAL(compact[i].id, expected[i].id);
+        ASSERT(abs(compact[i].relevance - expected[i].relevance) < CompactIndexTraits::EPS);
+        ASSERT_EQUAL(quantized[i].id, expected[i].id);
+        ASSERT(abs(quantized[i].relevance - expected[i].relevance) < EPS);
+    }
+    ASSERT_EQUAL(compact_server.FindPage("cat"s, 2).documents.size(), 2u);
+
+    //The forward index keeps the type of the traits
+    ASSERT_EQUAL(compact_server.GetWordFrequencies(1).at("fluffy"sv), 0.5f);
+    ASSERT_EQUAL(quantized_server.GetWordFrequencies(1).at("fluffy"sv), 2u);
+    ASSERT(sizeof(BasicSearchServer<CompactIndexTraits>::DocumentType) < sizeof(Document));
+
+    compact_server.RemoveDocument(1);
+    ASSERT(compact_server.GetWordFrequencies(1).empty());
+    ASSERT_EQUAL(compact_server.FindTopDocuments("fluffy"s).size(), 1u);
+
+    //Narrow ids rank like the wide ones up to the largest int16_t id
+    BasicSearchServer<NarrowIndexTraits> narrow_server("and with"s);
+    const int16_t last_id = INT16_MAX;
+    for (int id = 0; id < static_cast<int>(texts.size()); ++id) {
+        narrow_server.AddDocument(static_cast<int16_t>(last_id - id), texts[id], DocumentStatus::ACTUAL, { id });
+    }
+    const auto narrow = narrow_server.FindTopDocuments("fluffy groomed cat -collar"s);
+    ASSERT_EQUAL(narrow.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        ASSERT_EQUAL(narrow[i].id, last_id - expected[i].id);
+        ASSERT(abs(narrow[i].relevance - expected[i].relevance) < NarrowIndexTraits::EPS);
+    }
+    ASSERT_EQUAL(get<0>(narrow_server.MatchDocument("fluffy cat"s, static_cast<int16_t>(last_id - 1))).size(), 2u);
+    ASSERT_EQUAL(*narrow_server.begin(), last_id - static_cast<int16_t>(texts.size() - 1));
+    //Ids past int16_t are rejected, not wrapped onto another document
+    try {
+        narrow_server.AddDocument(70000, "wrapped id"s, DocumentStatus::ACTUAL, { 1 });
+        ASSERT_HINT(false, "An id past the id type must fail"s);
+    }
+    catch (const out_of_range&) {
+    }
+    ASSERT_EQUAL(narrow_server.GetDocumentCount(), static_cast<int>(texts.size()));
+    ASSERT(narrow_server.FindTopDocuments("wrapped"s).empty());
+    narrow_server.RemoveDocument(last_id + 65536);
+    ASSERT_EQUAL(narrow_server.GetDocumentCount(), static_cast<int>(texts.size()));
+    ASSERT(narrow_server.GetWordFrequencies(last_id + 65536).empty());
+    narrow_server.RemoveDocument(last_id);
+    ASSERT_EQUAL(narrow_server.FindTopDocuments("collar"s).size(), 0u);
+}
+
+void TestIndexMemory() {
+    const vector<string> texts = { "white cat and fashion collar"s, "fluffy cat fluffy tail"s, "groomed dog expressive eyes"s,
+                                   "groomed starling evgeny"s, "fluffy dog and cat"s };
+    SearchServer server("and with"s);
+    ASSERT(server.GetMemoryResource() == std::pmr::new_delete_resource());
+    for (int id = 0; id < static_cast<int>(texts.size()); ++id) {
+        server.AddDocument(id, texts[id], DocumentStatus::ACTUAL, { id });
+    }
+    const auto expected = server.FindTopDocuments("fluffy groomed cat -collar"s);
+
+    for (const IndexAllocation allocation : { IndexAllocation::POOLED, IndexAllocation::MONOTONIC }) {
+        IndexMemoryOptions options;
+        options.allocation = allocation;
+        options.initial_arena_size = 1024;
+        SearchServer arena_server("and with"s, options);
+        ASSERT(arena_server.GetMemoryResource() != std::pmr::new_delete_resource());
+        for (int id = 0; id < 200; ++id) {
+            arena_server.AddDocument(id, texts[id % texts.size()], DocumentStatus::ACTUAL, { id % 5 });
+        }
+        vector<int> removed_ids;
+        for (int id = static_cast<int>(texts.size()); id < 200; ++id) {
+            removed_ids.push_back(id);
+        }
+        arena_server.RemoveDocuments(removed_ids);
+
+        //Moving the server keeps its resource
+        const SearchServer moved_server(std::move(arena_server));
+        const auto documents = moved_server.FindTopDocuments(std::execution::par, "fluffy groomed cat -collar"s);
+        ASSERT_EQUAL(documents.size(), expected.size());
+        for (size_t i = 0; i < expected.size(); ++i) {
+            ASSERT_EQUAL(documents[i].id, expected[i].id);
+            ASSERT(abs(documents[i].relevance - expected[i].relevance) < EPS);
+        }
+        ASSERT_EQUAL(get<0>(moved_server.MatchDocument("fluffy cat"s, 1)).size(), 2u);
+    }
+
+    //Scratch containers spill out of the inline buffer
+    ScratchArena arena;
+    std::pmr::vector<int> values(arena.Get());
+    for (int i = 0; i < static_cast<int>(ScratchArena::INLINE_SIZE); ++i) {
+        values.push_back(i);
+    }
+    ASSERT_EQUAL(values.back(), static_cast<int>(ScratchArena::INLINE_SIZE) - 1);
+}
+
+void TestSearchPages() {
+    SearchServer server("and with"s);
+    for (int id = 0; id < 40; ++id) {
+        server.AddDocument(id, (id % 3 == 0 ? "fluffy cat "s : "cat "s) + string(id % 5 + 1, 'a'), DocumentStatus::ACTUAL, { id % 7 });
+    }
+    server.AddDocument(100, "cat banned"s, DocumentStatus::BANNED, { 1 });
+
+    //Pages walk through every matched document once, in ranking order
+    const auto collect_pages = [&server](size_t page_size) {
+        vector<Document> all;
+        SearchCursor cursor;
+        while (true) {
+            const SearchPage page = server.FindPage("fluffy cat"s, page_size, SearchCursor::FromString(cursor.ToString()));
+            ASSERT(page.documents.size() <= page_size);
+            all.insert(all.end(), page.documents.begin(), page.documents.end());
+            if (!page.next_cursor) {
+                break;
+            }
+            cursor = *page.next_cursor;
+        }
+        return all;
+    };
+    const vector<Document> pages = collect_pages(7);
+    ASSERT_EQUAL(pages.size(), 40u);
+    for (size_t i = 1; i < pages.size(); ++i) {
+        ASSERT(IsRankedBefore(pages[i - 1].relevance, pages[i - 1].rating, pages[i - 1].id, pages[i].relevance, pages[i].rating, pages[i].id, EPS));
+    }
+
+    //The first page matches FindTopDocuments
+    const auto top = server.FindTopDocuments("fluffy cat"s);
+    for (size_t i = 0; i < top.size(); ++i) {
+        ASSERT_EQUAL(top[i].id, pages[i].id);
+    }
+    ASSERT(!server.FindPage("fluffy cat"s, 40).next_cursor);
+    ASSERT_EQUAL(server.FindPage("cat"s, DocumentStatus::BANNED, 10).documents.size(), 1u);
+
+    //Cached pages are the same, and the index change is seen at once
+    server.EnableResultCache(4, std::chrono::milliseconds(60000));
+    const vector<Document> cached_pages = collect_pages(7);
+    ASSERT_EQUAL(cached_pages.size(), pages.size());
+    for (size_t i = 0; i < pages.size(); ++i) {
+        ASSERT_EQUAL(cached_pages[i].id, pages[i].id);
+    }
+    server.RemoveDocument(0);
+    ASSERT_EQUAL(collect_pages(7).size(), 39u);
+    server.DisableResultCache();
+
+    try {
+        SearchCursor::FromString("not a cursor"s);
+        ASSERT(false);
+    }
+    catch (const invalid_argument&) {
+    }
+    try {
+        server.FindPage("cat"s, 0);
+        ASSERT(false);
+    }
+    catch (const invalid_argument&) {
+    }
+}
+
+void TestPhraseQueries() {
+    std::vector<uint8_t> buffer;
+    for (const uint32_t value : { 0u, 127u, 128u, 300000u }) {
+        AppendVarint(buffer, value);
+    }
+    const uint8_t* input = buffer.data();
+    ASSERT_EQUAL(ReadVarint(input), 0u);
+    ASSERT_EQUAL(ReadVarint(input), 127u);
+    ASSERT_EQUAL(ReadVarint(input), 128u);
+    ASSERT_EQUAL(ReadVarint(input), 300000u);
+    ASSERT(ContainsPhrase({ { 1, 7 }, { 3, 8 }, { 9 } }));
+    ASSERT(!ContainsPhrase({ { 1, 7 }, { 3, 9 } }));
+
+    SearchServer server("and with"s);
+    server.AddDocument(1, "white cat and fashion collar"s, DocumentStatus::ACTUAL, { 8, -3 });
+    server.AddDocument(2, "white dog with white cat"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    server.AddDocument(3, "cat white collar"s, DocumentStatus::ACTUAL, { 5 });
+
+    //Without the positional index phrases are rejected
+    try {
+        server.FindTopDocuments("\"white cat\""s);
+        ASSERT(false);
+    }
+    catch (const invalid_argument&) {
+    }
+
+    server.EnablePositionalIndex();
+    server.AddDocument(4, "fluffy white cat"s, DocumentStatus::ACTUAL, { 1 });
+    const auto ids = [](const vector<Document>& documents) {
+        set<int> result;
+        for (const auto& document : documents) {
+            result.insert(document.id);
+        }
+        return result;
+    };
+    ASSERT(ids(server.FindTopDocuments("\"white cat\""s)) == set<int>({ 1, 2, 4 }));
+    ASSERT(ids(server.FindTopDocuments(std::execution::par, "\"white cat\""s)) == set<int>({ 1, 2, 4 }));
+    //Stop words do not take positions
+    ASSERT(ids(server.FindTopDocuments("\"cat and fashion collar\""s)) == set<int>({ 1 }));
+    ASSERT(ids(server.FindTopDocuments("\"white cat\" -fluffy \"white dog\""s)) == set<int>({ 2 }));
+    ASSERT(ids(server.FindTopDocuments("\"cat white\" collar"s)) == set<int>({ 3 }));
+
+    //Cached pages tell a phrase from the same words unquoted or reordered
+    server.EnableResultCache(4, std::chrono::milliseconds(60000));
+    ASSERT(ids(server.FindPage("white collar"s, 10).documents) == set<int>({ 1, 2, 3, 4 }));
+    ASSERT(ids(server.FindPage("\"white collar\""s, 10).documents) == set<int>({ 3 }));
+    ASSERT(server.FindPage("\"collar white\""s, 10).documents.empty());
+    server.DisableResultCache();
+
+    const auto [words, status] = server.MatchDocument("\"white dog\" collar"s, 1);
+    ASSERT(words.empty());
+    const auto [par_words, par_status] = server.MatchDocument(std::execution::par, "\"white dog\""s, 2);
+    ASSERT_EQUAL(par_words.size(), 2u);
+    const string batch_query = "\"white collar\""s;
+    const auto matches = server.MatchDocuments(batch_query, { 1, 3 });
+    ASSERT(std::get<0>(matches[0]).empty());
+    ASSERT_EQUAL(std::get<0>(matches[1]).size(), 2u);
+
+    for (const string& query : { "\"white cat"s, "-\"white cat\""s, "\"white -cat\""s }) {
+        try {
+            server.FindTopDocuments(query);
+            ASSERT(false);
+        }
+        catch (const invalid_argument&) {
+        }
+    }
+    server.RemoveDocument(2);
+    ASSERT(ids(server.FindTopDocuments("\"white cat\""s)) == set<int>({ 1, 4 }));
+}
+
+void TestPrefixQueries() {
+    vector<string> words;
+    for (int i = 0; i < 100; ++i) {
+        words.push_back("cat"s + to_string(1000 + i));
+    }
+    words.push_back("dog"s);
+    words.push_back("catalog"s);
+    sort(words.begin(), words.end());
+    const FrontCodedDictionary dictionary(vector<string_view>(words.begin(), words.end()));
+    ASSERT_EQUAL(dictionary.size(), words.size());
+    vector<string> found;
+    dictionary.ForEachWithPrefix("cat10"sv, [&found](string_view word) { found.push_back(string(word)); return true; });
+    ASSERT_EQUAL(found.size(), 100u);
+    ASSERT_EQUAL(found.front(), "cat1000"s);
+    found.clear();
+    dictionary.ForEachWithPrefix("cata"sv, [&found](string_view word) { found.push_back(string(word)); return true; });
+    ASSERT(found == vector<string>({ "catalog"s }));
+    found.clear();
+    dictionary.ForEachWithPrefix("cow"sv, [&found](string_view word) { found.push_back(string(word)); return true; });
+    ASSERT(found.empty());
+
+    SearchServer server("and with"s);
+    server.AddDocument(1, "white cat and fashion collar"s, DocumentStatus::ACTUAL, { 8, -3 });
+    server.AddDocument(2, "fluffy catfish with collar"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::ACTUAL, { 5 });
+    ASSERT(server.ExpandPrefix("cat"s) == vector<string_view>({ "cat"sv, "catfish"sv }));
+    ASSERT_EQUAL(server.ExpandPrefix("c"s, 2).size(), 2u);
+
+    const auto results = server.FindTopDocuments("cat*"s);
+    ASSERT_EQUAL(results.size(), 2u);
+    //Both documents hold one expanded word, the virtual word is in 2 of 3 documents
+    ASSERT_EQUAL(results[0].id, 2);
+    ASSERT(std::abs(results[0].relevance - log(1.5) / 3) < 1e-6);
+    ASSERT(std::abs(results[1].relevance - log(1.5) / 4) < 1e-6);
+    ASSERT_EQUAL(server.FindTopDocuments(std::execution::par, "cat* -fluffy"s).size(), 1u);
+
+    //New words are seen by the next expansion
+    server.AddDocument(4, "catnip"s, DocumentStatus::ACTUAL, { 1 });
+    ASSERT_EQUAL(server.FindTopDocuments("cat*"s).size(), 3u);
+    server.RemoveDocument(4);
+    ASSERT_EQUAL(server.ExpandPrefix("cat"s).size(), 2u);
+
+    //Cached pages are keyed by the prefixes as well
+    server.EnableResultCache(4, std::chrono::milliseconds(60000));
+    ASSERT_EQUAL(server.FindPage("cat*"s, 10).documents.size(), 2u);
+    const auto dog_page = server.FindPage("dog*"s, 10).documents;
+    ASSERT_EQUAL(dog_page.size(), 1u);
+    ASSERT_EQUAL(dog_page[0].id, 3);
+    server.DisableResultCache();
+
+    //Matched plain words are views into the query
+    const string query = "cat* dog"s;
+    const auto [matched, status] = server.MatchDocument(query, 2);
+    ASSERT(matched == vector<string_view>({ "catfish"sv }));
+    const string par_query = "col* cat"s;
+    const auto [par_matched, par_status] = server.MatchDocument(std::execution::par, par_query, 1);
+    ASSERT(par_matched == vector<string_view>({ "cat"sv, "collar"sv }));
+    const string batch_query = "col* eyes"s;
+    const auto matches = server.MatchDocuments(batch_query, { 2, 3 });
+    ASSERT(std::get<0>(matches[0]) == vector<string_view>({ "collar"sv }));
+    ASSERT(std::get<0>(matches[1]) == vector<string_view>({ "eyes"sv }));
+}
+
+void TestFuzzyQueries() {
+    ASSERT_EQUAL(ComputeEditDistance("kitten"sv, "sitting"sv, 5), 3);
+    ASSERT_EQUAL(ComputeEditDistance("kitten"sv, "sitting"sv, 2), 3);
+    ASSERT_EQUAL(ComputeEditDistance("cat"sv, "act"sv, 2), 2);
+    ASSERT_EQUAL(ComputeEditDistance("collar"sv, "colar"sv, 1), 1);
+    //Paths leaving the band cost more than max_distance
+    ASSERT_EQUAL(ComputeEditDistance("abcdefgh"sv, "bcdefgha"sv, 2), 2);
+    ASSERT_EQUAL(ComputeEditDistance("abcdefgh"sv, "cdefghab"sv, 2), 3);
+    ASSERT_EQUAL(ComputeEditDistance("fluffy"sv, "fluffy"sv, 1), 0);
+    ASSERT_EQUAL(ComputeEditDistance(""sv, "ab"sv, 2), 2);
+
+    SearchServer server("and with"s);
+    server.AddDocument(1, "white cat and fashion collar"s, DocumentStatus::ACTUAL, { 8, -3 });
+    server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::ACTUAL, { 5 });
+
+    //Typos find nothing until fuzzy mode is on
+    ASSERT(server.FindTopDocuments("colar"s).empty());
+    server.EnableFuzzyMatching();
+    server.AddDocument(4, "fluffy collie"s, DocumentStatus::ACTUAL, { 1 });
+    const auto results = server.FindTopDocuments("colar"s);
+    ASSERT_EQUAL(results.size(), 1u);
+    ASSERT_EQUAL(results[0].id, 1);
+    //Found at distance 1, so the term frequency counts half
+    ASSERT(std::abs(results[0].relevance - 0.5 * 0.25 * log(4.0)) < 1e-6);
+    ASSERT_EQUAL(server.FindTopDocuments(std::execution::par, "flufy -white"s).size(), 2u);
+    ASSERT(server.ExpandFuzzy("cat"s).empty());
+    ASSERT(server.FindTopDocuments("xyzzy"s).empty());
+
+    const string query = "colie eys"s;
+    const auto [words, status] = server.MatchDocument(query, 4);
+    ASSERT(words == vector<string_view>({ "collie"sv }));
+    const auto matches = server.MatchDocuments(query, { 3, 4 });
+    ASSERT(std::get<0>(matches[0]) == vector<string_view>({ "eyes"sv }));
+
+    //Distance 2 and expansion of indexed words
+    FuzzyOptions options;
+    options.max_distance = 2;
+    options.expand_indexed_words = true;
+    server.EnableFuzzyMatching(options);
+    ASSERT_EQUAL(server.ExpandFuzzy("collar"s).size(), 1u);
+    ASSERT_EQUAL(server.FindTopDocuments("collar"s).size(), 2u);
+    server.DisableFuzzyMatching();
+    ASSERT(server.FindTopDocuments("colar"s).empty());
+
+    //Switching fuzzy mode drops the cached pages
+    server.EnableResultCache(4, std::chrono::milliseconds(60000));
+    ASSERT(server.FindPage("colar"s, 10).documents.empty());
+    server.EnableFuzzyMatching();
+    ASSERT_EQUAL(server.FindPage("colar"s, 10).documents.size(), 1u);
+    server.DisableFuzzyMatching();
+    ASSERT(server.FindPage("colar"s, 10).documents.empty());
+    server.DisableResultCache();
+}
+
+void TestScoring() {
+    SearchServer server("and with"s);
+    server.AddDocument(1, "white cat and fashion collar"s, DocumentStatus::ACTUAL, { 8, -3 });
+    server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::ACTUAL, { 5 });
+    server.AddDocument(4, "cat"s, DocumentStatus::ACTUAL, { 1 });
+
+    const CollectionStatistics statistics = server.GetCollectionStatistics();
+    ASSERT_EQUAL(statistics.document_count, 4u);
+    ASSERT(std::abs(statistics.average_document_length - 13.0 / 4) < 1e-6);
+    ASSERT_EQUAL(server.GetDocumentFreq("cat"s), 3u);
+    ASSERT_EQUAL(server.GetDocumentFreq("and"s), 0u);
+
+    //TF-IDF stays the default ranking
+    const auto default_results = server.FindTopDocuments("fluffy cat"s);
+    const auto tf_idf_results = server.FindTopDocuments(TfIdfScoring(), std::execution::seq, "fluffy cat"s);
+    ASSERT_EQUAL(default_results.size(), tf_idf_results.size());
+    for (size_t i = 0; i < default_results.size(); ++i) {
+        ASSERT_EQUAL(default_results[i].id, tf_idf_results[i].id);
+        ASSERT(std::abs(default_results[i].relevance - tf_idf_results[i].relevance) < 1e-9);
+    }
+
+    //BM25 saturates the term frequency and normalizes by the document length
+    const double idf = log(1.0 + (4 - 3 + 0.5) / (3 + 0.5));
+    const auto bm25 = [idf](double count, double length) {
+        return idf * count * 2.2 / (count + 1.2 * (0.25 + 0.75 * length / 3.25));
+    };
+    const auto results = server.FindTopDocuments(Bm25Scoring(), std::execution::seq, "cat"s);
+    ASSERT_EQUAL(results.size(), 3u);
+    ASSERT_EQUAL(results[0].id, 4);
+    ASSERT(std::abs(results[0].relevance - bm25(1, 1)) < 1e-6);
+    ASSERT(std::abs(results[1].relevance - bm25(1, 4)) < 1e-6);
+
+    const auto par_results = server.FindTopDocuments(Bm25Scoring(), std::execution::par, "fluffy cat -white"s);
+    const auto seq_results = server.FindTopDocuments(Bm25Scoring(), std::execution::seq, "fluffy cat -white"s,
+        [](int document_id, DocumentStatus status, int rating) { return status == DocumentStatus::ACTUAL; });
+    ASSERT_EQUAL(par_results.size(), 2u);
+    ASSERT_EQUAL(seq_results.size(), 2u);
+    for (size_t i = 0; i < par_results.size(); ++i) {
+        ASSERT_EQUAL(par_results[i].id, seq_results[i].id);
+        ASSERT(std::abs(par_results[i].relevance - seq_results[i].relevance) < 1e-9);
+    }
+
+    //Without length normalization a single occurrence scores the same in any document
+    const auto flat_results = server.FindTopDocuments(Bm25Scoring{ 1.2, 0.0 }, std::execution::seq, "cat -fluffy"s);
+    ASSERT_EQUAL(flat_results.size(), 2u);
+    ASSERT(std::abs(flat_results[0].relevance - flat_results[1].relevance) < 1e-9);
+
+    //Removal updates the statistics
+    server.RemoveDocument(4);
+    ASSERT(std::abs(server.GetCollectionStatistics().average_document_length - 4.0) < 1e-6);
+}
+
+void TestShardedSearchServer() {
+    const vector<string> documents = {
+        "white cat and fashion collar"s, "fluffy cat fluffy tail"s, "groomed dog expressive eyes"s,
+        "cat"s, "white dog with black collar"s, "fluffy groomed cat"s, "black cat black tail"s, "dog"s };
+    SearchServer server("and with"s);
+    ShardedSearchServer sharded("and with"s, 3);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const DocumentStatus status = i == 5 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        server.AddDocument(static_cast<int>(i), documents[i], status, { static_cast<int>(i) });
+        sharded.AddDocument(static_cast<int>(i), documents[i], status, { static_cast<int>(i) });
+    }
+    ASSERT_EQUAL(sharded.GetDocumentCount(), 8);
+    ASSERT_EQUAL(sharded.GetShardCount(), 3u);
+    ASSERT(std::abs(sharded.GetCollectionStatistics().average_document_length - server.GetCollectionStatistics().average_document_length) < 1e-9);
+
+    //Relevance does not depend on the split
+    const auto assert_same = [](const vector<Document>& lhs, const vector<Document>& rhs) {
+        ASSERT_EQUAL(lhs.size(), rhs.size());
+        for (size_t i = 0; i < lhs.size(); ++i) {
+            ASSERT_EQUAL(lhs[i].id, rhs[i].id);
+            ASSERT(std::abs(lhs[i].relevance - rhs[i].relevance) < 1e-9);
+        }
+    };
+    for (const string& query : { "cat"s, "fluffy cat -white"s, "black collar dog"s, "fluf* tail"s, "eyes"s }) {
+        assert_same(sharded.FindTopDocuments(query), server.FindTopDocuments(query));
+        const auto banned = [](int document_id, DocumentStatus status, int rating) { return status == DocumentStatus::BANNED; };
+        assert_same(sharded.FindTopDocuments(query, banned), server.FindTopDocuments(query, banned));
+        assert_same(sharded.FindTopDocuments(Bm25Scoring(), query, [](int, DocumentStatus, int) { return true; }),
+                    server.FindTopDocuments(Bm25Scoring(), std::execution::seq, query, [](int, DocumentStatus, int) { return true; }));
+    }
+
+    //Writes go to the owning shard
+    try {
+        sharded.AddDocument(3, "duplicate"s, DocumentStatus::ACTUAL, { 1 });
+        ASSERT_HINT(false, "Duplicate id must be rejected"s);
+    }
+    catch (const std::invalid_argument&) {
+    }
+    const string query = "black cat"s;
+    const auto [words, status] = sharded.MatchDocument(query, 6);
+    ASSERT(words == vector<string_view>({ "black"sv, "cat"sv }));
+    sharded.RemoveDocument(3);
+    server.RemoveDocument(3);
+    ASSERT_EQUAL(sharded.GetDocumentCount(), 7);
+    assert_same(sharded.FindTopDocuments("cat"s), server.FindTopDocuments("cat"s));
+
+    //Writes that race with a query never leave a term with a zero global frequency
+    thread writer([&sharded]() {
+        for (int id = 100; id < 400; ++id) {
+            sharded.AddDocument(id, "parrot "s + to_string(id), DocumentStatus::ACTUAL, { 1 });
+        }
+    });
+    for (int i = 0; i < 300; ++i) {
+        for (const Document& document : sharded.FindTopDocuments("parrot"s)) {
+            ASSERT(std::isfinite(document.relevance));
+        }
+    }
+    writer.join();
+    ASSERT_EQUAL(GetGlobalDocumentFreq({ 0, 3 }, 0, 2), 2u);
+}
+
+void TestWorkStealingExecutor() {
+    WorkStealingExecutor executor(3);
+    ASSERT_EQUAL(executor.GetThreadCount(), 3u);
+
+    //Every index runs once, nested loops do not deadlock
+    vector<atomic<int>> counts(1000);
+    executor.ParallelFor(0, 10, 1, [&](size_t i) {
+        executor.ParallelFor(0, 100, 7, [&](size_t j) { ++counts[i * 100 + j]; });
+    });
+    for (const auto& count : counts) {
+        ASSERT_EQUAL(count.load(), 1);
+    }
+    try {
+        executor.ParallelFor(0, 100, 1, [](size_t i) {
+            if (i == 42) {
+                throw std::out_of_range("42"s);
+            }
+        });
+        ASSERT_HINT(false, "An exception of a chunk must reach the caller"s);
+    }
+    catch (const std::out_of_range&) {
+    }
+
+    //Every mode ranks like the sequential code
+    const vector<string> words = { "cat"s, "dog"s, "tail"s, "collar"s, "eyes"s, "white"s, "black"s, "fluffy"s };
+    vector<string> queries;
+    for (int i = 0; i < 20; ++i) {
+        queries.push_back(words[i % 8] + " "s + words[(i * 3 + 1) % 8] + " -"s + words[(i * 5 + 2) % 8]);
+    }
+    for (const ParallelismMode mode : { ParallelismMode::INTER_QUERY, ParallelismMode::INTRA_QUERY, ParallelismMode::ADAPTIVE }) {
+        SearchServer server("and"s);
+        server.SetParallelism(4, mode, 100);
+        ASSERT(server.GetParallelismMode() == mode);
+        for (int id = 0; id < 500; ++id) {
+            server.AddDocument(id * 3, words[id % 8] + " "s + words[(id / 8) % 8] + " and "s + words[(id / 64) % 8], DocumentStatus::ACTUAL, { id % 10 });
+        }
+        const auto batch = ProcessQueries(server, queries);
+        for (size_t i = 0; i < queries.size(); ++i) {
+            const auto expected = server.FindTopDocuments(std::execution::seq, queries[i]);
+            const auto actual = server.FindTopDocuments(std::execution::par, queries[i]);
+            ASSERT_EQUAL(actual.size(), expected.size());
+            ASSERT_EQUAL(batch[i].size(), expected.size());
+            for (size_t j = 0; j < expected.size(); ++j) {
+                ASSERT_EQUAL(actual[j].id, expected[j].id);
+                ASSERT_EQUAL(batch[i][j].id, expected[j].id);
+                ASSERT(std::abs(actual[j].relevance - expected[j].relevance) < 1e-9);
+            }
+        }
+        server.RemoveDocument(std::execution::par, 3);
+        ASSERT_EQUAL(server.GetDocumentCount(), 499);
+        ASSERT(server.GetWordFrequencies(3).empty());
+    }
+
+    //Batch removals clean the postings of enough words to be split between the threads
+    SearchServer server("and with"s);
+    server.SetParallelism(4);
+    vector<int> removed_ids;
+    for (int id = 0; id < 1000; ++id) {
+        server.AddDocument(id, "word"s + to_string(id) + " common"s, DocumentStatus::ACTUAL, { 1 });
+        if (id % 2 == 0) {
+            removed_ids.push_back(id);
+        }
+    }
+    server.RemoveDocuments(removed_ids);
+    ASSERT_EQUAL(server.GetDocumentCount(), 500);
+    ASSERT(server.FindTopDocuments("word10"s).empty());
+    ASSERT_EQUAL(server.FindTopDocuments("word11"s).size(), 1u);
+    ASSERT_EQUAL(server.GetDocumentFreq("common"sv), 500u);
+}
+
+void TestAsyncQueries() {
+    using namespace std::chrono_literals;
+    SearchServer server("and with"s);
+    server.AddDocument(1, "white cat and fashion collar"s, DocumentStatus::ACTUAL, { 8, -3 });
+    server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    server.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::BANNED, { 5 });
+    server.SetParallelism(1);
+
+    //An expired deadline stops scoring, the result is flagged
+    const QueryDeadline expired(QueryDeadline::Clock::now() - 1ms);
+    const QueryResult partial = server.FindTopDocumentsUntil(expired, std::execution::seq, "fluffy cat"s);
+    ASSERT(partial.outcome == QueryOutcome::PARTIAL);
+    ASSERT(partial.documents.empty());
+    const QueryResult complete = server.FindTopDocumentsUntil(QueryDeadline(), std::execution::par, "fluffy cat"s);
+    ASSERT(complete.outcome == QueryOutcome::COMPLETE);
+    ASSERT_EQUAL(complete.documents.size(), 2u);
+    ASSERT_EQUAL(complete.documents[0].id, 2);
+
+    //The only worker is busy, so the first query stays in flight and the second one is turned away
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    server.GetExecutor().Submit([released]() { released.wait(); });
+    {
+        AsyncQueryRunner runner(server, 1);
+        auto queued = runner.FindTopDocuments("dog"s, 10s, DocumentStatus::BANNED);
+        auto rejected = runner.FindTopDocuments("cat"s, 10s);
+        ASSERT_EQUAL(runner.GetInFlightCount(), 1u);
+        ASSERT(rejected.get().outcome == QueryOutcome::REJECTED);
+        release.set_value();
+        const QueryResult result = queued.get();
+        ASSERT(result.outcome == QueryOutcome::COMPLETE);
+        ASSERT_EQUAL(result.documents.size(), 1u);
+        ASSERT_EQUAL(result.documents[0].id, 3);
+
+        //The caller keeps the deadline of its query and cancels it before the query is scored
+        std::promise<void> release_again;
+        std::shared_future<void> released_again = release_again.get_future().share();
+        server.GetExecutor().Submit([released_again]() { released_again.wait(); });
+        const auto cancellable = make_shared<QueryDeadline>(QueryDeadline::Clock::now() + 10s);
+        auto cancelled = runner.FindTopDocuments("fluffy cat"s, cancellable);
+        cancellable->Cancel();
+        release_again.set_value();
+        const QueryResult cancelled_result = cancelled.get();
+        ASSERT(cancelled_result.outcome == QueryOutcome::PARTIAL);
+        ASSERT(cancelled_result.documents.empty());
+
+        auto invalid = runner.FindTopDocuments("cat --dog"s, 10s);
+        try {
+            invalid.get();
+            ASSERT_HINT(false, "An invalid query must reach the future as an exception"s);
+        }
+        catch (const std::invalid_argument&) {
+        }
+    }
+}
+
+void TestQueryServer() {
+    SearchServer server("and with"s);
+    server.AddDocument(1, "white cat and fashion collar"s, DocumentStatus::ACTUAL, { 8, -3 });
+    server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    QueryServer query_server(server);
+    query_server.Start();
+    ASSERT(query_server.GetPort() != 0);
+
+    QueryClient client("127.0.0.1"s, query_server.GetPort());
+    const auto expected = server.FindTopDocuments("fluffy cat"s);
+    const auto documents = client.FindTopDocuments("fluffy cat"s);
+    ASSERT_EQUAL(documents.size(), expected.size());
+    for (size_t i = 0; i < documents.size(); ++i) {
+        ASSERT_EQUAL(documents[i].id, expected[i].id);
+        ASSERT_EQUAL(documents[i].rating, expected[i].rating);
+        ASSERT(documents[i].relevance == expected[i].relevance);
+    }
+
+    //Writes go through the same connection
+    client.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::BANNED, { 5 });
+    ASSERT_EQUAL(server.GetDocumentCount(), 3);
+    const auto [words, status] = client.MatchDocument("groomed cat"s, 3);
+    ASSERT_EQUAL(words.size(), 1u);
+    ASSERT_EQUAL(words[0], "groomed"s);
+    ASSERT(status == DocumentStatus::BANNED);
+    client.RemoveDocument(3);
+    ASSERT_EQUAL(server.GetDocumentCount(), 2);
+
+    //Server errors are reported to the caller, the connection stays usable
+    try {
+        client.FindTopDocuments("cat --dog"s);
+        ASSERT_HINT(false, "Invalid query must fail"s);
+    }
+    catch (const runtime_error&) {
+    }
+    ASSERT_EQUAL(client.FindTopDocuments("collar"s).size(), 1u);
+    try {
+        client.AddDocument(4, "groomed dog"s, static_cast<DocumentStatus>(9), { 5 });
+        ASSERT_HINT(false, "Unknown status must fail"s);
+    }
+    catch (const runtime_error&) {
+    }
+    ASSERT_EQUAL(server.GetDocumentCount(), 2);
+
+    //A count the message cannot hold is rejected before anything is allocated for it
+    string payload;
+    WireWriter payload_writer(payload);
+    payload_writer.WriteU32(0xFFFFFFFFu);
+    payload_writer.WriteI32(5);
+    WireReader payload_reader(payload);
+    try {
+        payload_reader.ReadCount(sizeof(int32_t));
+        ASSERT_HINT(false, "Oversized count must fail"s);
+    }
+    catch (const invalid_argument&) {
+    }
+    string valid_payload;
+    WireWriter valid_writer(valid_payload);
+    valid_writer.WriteU32(1);
+    valid_writer.WriteI32(5);
+    ASSERT_EQUAL(WireReader(valid_payload).ReadCount(sizeof(int32_t)), 1u);
+
+    //Pipelined requests are all answered, each with its own id
+    vector<uint32_t> request_ids;
+    for (int i = 0; i < 20; ++i) {
+        request_ids.push_back(i % 2 ? client.SendFindTopDocuments("cat"s) : client.SendMatchDocument("fluffy tail"s, 2));
+    }
+    vector<uint32_t> answered_ids;
+    for (int i = 0; i < 20; ++i) {
+        const QueryResponse response = client.ReceiveResponse();
+        ASSERT(response.status == ResponseStatus::OK);
+        ASSERT(response.documents.size() == 2u || response.words.size() == 2u);
+        answered_ids.push_back(response.request_id);
+    }
+    sort(answered_ids.begin(), answered_ids.end());
+    ASSERT(answered_ids == request_ids);
+
+    //Several clients at once
+    vector<thread> threads;
+    atomic<int> found = 0;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&query_server, &found]() {
+            QueryClient thread_client("127.0.0.1"s, query_server.GetPort());
+            for (int i = 0; i < 10; ++i) {
+                found += static_cast<int>(thread_client.FindTopDocuments("white"s).size());
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    ASSERT_EQUAL(found.load(), 40);
+    query_server.Stop();
+
+    //Split queries hold the index lock while they wait for their chunks, pipelined writes must not deadlock them
+    for (const ParallelismMode mode : { ParallelismMode::ADAPTIVE, ParallelismMode::INTRA_QUERY }) {
+        SearchServer large_server("and"s);
+        large_server.SetParallelism(4, mode, 100);
+        for (int id = 0; id < 10000; ++id) {
+            large_server.AddDocument(id, id % 2 ? "cat dog"s : "dog tail"s, DocumentStatus::ACTUAL, { id % 10 });
+        }
+        QueryServer large_query_server(large_server);
+        large_query_server.Start();
+        QueryClient large_client("127.0.0.1"s, large_query_server.GetPort());
+        int next_id = 10000;
+        for (int round = 0; round < 10; ++round) {
+            for (int i = 0; i < 16; ++i) {
+                large_client.SendFindTopDocuments("cat dog"s);
+                if (i % 4 == 0) {
+                    large_client.SendAddDocument(next_id++, "cat collar"s, DocumentStatus::ACTUAL, { 1 });
+                }
+            }
+            for (int i = 0; i < 20; ++i) {
+                ASSERT(large_client.ReceiveResponse().status == ResponseStatus::OK);
+            }
+        }
+        ASSERT_EQUAL(large_server.GetDocumentCount(), next_id);
+
+        //A client that shuts down its side after a pipeline gets every response, then the server closes
+        for (int i = 0; i < 16; ++i) {
+            large_client.SendFindTopDocuments("cat dog"s);
+        }
+        large_client.FinishSending();
+        for (int i = 0; i < 16; ++i) {
+            ASSERT(large_client.ReceiveResponse().status == ResponseStatus::OK);
+        }
+        try {
+            large_client.ReceiveResponse();
+            ASSERT_HINT(false, "The server must close the connection"s);
+        }
+        catch (const runtime_error&) {
+        }
+        large_query_server.Stop();
+    }
+}
+
+void TestReplication() {
+    using namespace std::chrono_literals;
+    const auto same_results = [](SearchServer& lhs, SearchServer& rhs, const string& query) {
+        const auto lhs_documents = lhs.FindTopDocuments(query);
+        const auto rhs_documents = rhs.FindTopDocuments(query);
+        if (lhs_documents.size() != rhs_documents.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < lhs_documents.size(); ++i) {
+            if (lhs_documents[i].id != rhs_documents[i].id || lhs_documents[i].rating != rhs_documents[i].rating) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    SearchServer leader_server("and with"s);
+    ReplicationOptions options;
+    options.max_log_size = 3;
+    ReplicationLeader leader(leader_server, options);
+    leader.Start();
+    ASSERT_EQUAL(leader.AddDocument(1, "white cat and fashion collar"s, DocumentStatus::ACTUAL, { 8, -3 }), 1u);
+    ASSERT_EQUAL(leader.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, { 7, 2, 7 }), 2u);
+
+    //A follower inside the log receives it from the start
+    SearchServer first_server("and with"s);
+    ReplicationFollower first(first_server, "127.0.0.1"s, leader.GetPort());
+    first.Start();
+    ASSERT(first.WaitForSequence(2, 5s));
+    ASSERT_EQUAL(first_server.GetDocumentCount(), 2);
+    ASSERT(same_results(leader_server, first_server, "fluffy cat"s));
+
+    //Rejected and empty mutations are not logged
+    try {
+        leader.AddDocument(1, "duplicate id"s, DocumentStatus::ACTUAL, {});
+        ASSERT_HINT(false, "Duplicate id must fail"s);
+    }
+    catch (const invalid_argument&) {
+    }
+    ASSERT_EQUAL(leader.RemoveDocument(42), 2u);
+
+    //Mutations stream to the follower in order
+    leader.AddDocument(3, "groomed dog expressive eyes"s, DocumentStatus::BANNED, { 5 });
+    leader.RemoveDocument(1);
+    const uint64_t sequence = leader.AddDocument(4, "well groomed starling evgeny"s, DocumentStatus::ACTUAL, { 9 });
+    ASSERT(first.WaitForSequence(sequence, 5s));
+    ASSERT_EQUAL(first_server.GetDocumentCount(), 3);
+    ASSERT(same_results(leader_server, first_server, "groomed cat"s));
+    ASSERT(first_server.FindTopDocuments("collar"s).empty());
+
+    //A follower behind the kept log catches up from a snapshot, then follows the log tail
+    SearchServer second_server("and with"s);
+    second_server.AddDocument(100, "stale document"s, DocumentStatus::ACTUAL, { 1 });
+    ReplicationFollower second(second_server, "127.0.0.1"s, leader.GetPort());
+    second.Start();
+    ASSERT(second.WaitForSequence(sequence, 5s));
+    ASSERT_EQUAL(second_server.GetDocumentCount(), 3);
+    ASSERT(second_server.FindTopDocuments("stale"s).empty());
+    ASSERT(same_results(leader_server, second_server, "groomed cat"s));
+
+    //Writes through the network front end of the leader reach the followers,
+    //the front end of a follower is read-only
+    //Enough executor threads for a query to run next to a waiting write on any host
+    leader_server.SetParallelism(4);
+    QueryServer leader_front(leader);
+    leader_front.Start();
+    QueryServer follower_front(second);
+    follower_front.Start();
+    QueryClient leader_client("127.0.0.1"s, leader_front.GetPort());
+    leader_client.AddDocument(5, "fluffy starling"s, DocumentStatus::ACTUAL, { 4 });
+    ASSERT(first.WaitForSequence(leader.GetSequence(), 5s));
+    ASSERT(second.WaitForSequence(leader.GetSequence(), 5s));
+    QueryClient follower_client("127.0.0.1"s, follower_front.GetPort());
+    ASSERT_EQUAL(follower_client.FindTopDocuments("starling"s).size(), 2u);
+    try {
+        follower_client.RemoveDocument(5);
+        ASSERT_HINT(false, "Follower must reject writes"s);
+    }
+    catch (const runtime_error&) {
+    }
+
+    //A query arriving while a write waits for the index runs after the write
+    {
+        shared_lock long_query(leader.GetIndexMutex());
+        leader_client.SendAddDocument(6, "hatched chick"s, DocumentStatus::ACTUAL, { 3 });
+        leader_client.Flush();
+        this_thread::sleep_for(100ms);
+        QueryClient reader_client("127.0.0.1"s, leader_front.GetPort());
+        reader_client.SendFindTopDocuments("chick"s);
+        reader_client.Flush();
+        this_thread::sleep_for(100ms);
+        long_query.unlock();
+        ASSERT_EQUAL(reader_client.ReceiveResponse().documents.size(), 1u);
+        ASSERT(leader_client.ReceiveResponse().status == ResponseStatus::OK);
+    }
+    follower_front.Stop();
+    leader_front.Stop();
+
+    //A stopped follower resumes from the log tail
+    first.Stop();
+    leader.RemoveDocument(5);
+    first.Start();
+    ASSERT(first.WaitForSequence(leader.GetSequence(), 5s));
+    ASSERT(first_server.FindTopDocuments("starling"s).size() == 1u);
+    first.Stop();
+    second.Stop();
+    leader.Stop();
+
+    //A leader restarted on the same port has a history of its own: a follower whose sequence
+    //it has already passed starts over from a snapshot instead of applying the tail on top
+    SearchServer restarted_server("and with"s);
+    ReplicationOptions restarted_options;
+    restarted_options.port = leader.GetPort();
+    ReplicationLeader restarted(restarted_server, restarted_options);
+    ASSERT(restarted.GetEpoch() != leader.GetEpoch());
+    restarted.Start();
+    for (int id = 10; id < 30; ++id) {
+        restarted.AddDocument(id, "parrot number "s + to_string(id), DocumentStatus::ACTUAL, { id });
+    }
+    ASSERT(restarted.GetSequence() > first.GetAppliedSequence());
+    first.Start();
+    ASSERT(first.WaitForSequence(restarted.GetSequence(), 5s));
+    ASSERT_EQUAL(first_server.GetDocumentCount(), 20);
+    ASSERT(first_server.FindTopDocuments("starling"s).empty());
+    ASSERT(same_results(restarted_server, first_server, "parrot"s));
+    first.Stop();
+    restarted.Stop();
+}
+
+void TestHotSwapSearchServer() {
+    int configured = 0;
+    //Once set, a rebuild waits for it before building, so the test controls how long a rebuild runs
+    std::shared_future<void> rebuild_gate;
+    HotSwapSearchServer server("and with"s, [&configured, &rebuild_gate](SearchServer& index) {
+        if (rebuild_gate.valid()) {
+            rebuild_gate.wait();
+        }
+        index.EnablePositionalIndex();
+        ++configured;
+    });
+    server.AddDocument(1, "white cat and fashion collar"s, DocumentStatus::ACTUAL, { 8, -3 });
+    server.AddDocument(2, "fluffy cat fluffy tail"s, DocumentStatus::ACTUAL, { 7, 2, 7 });
+    server.AddDocument(3, "fluffy tail cat"s, DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(4, "groomed dog expressive eyes"s, DocumentStatus::BANNED, { 5 });
+    ASSERT_EQUAL(configured, 1);
+    ASSERT_EQUAL(server.GetGeneration(), 0u);
+
+    //A reader keeps the index it started with, the rebuild swaps in a new one
+    {
+        const HotSwapSearchServer::Reader old_reader = server.Read();
+        ASSERT_EQUAL(old_reader->GetStoredDocument(2).text, "fluffy cat fluffy tail"s);
+        ASSERT_EQUAL(old_reader->GetStoredDocument(2).rating, 5);
+        RebuildOptions options;
+        options.remove_duplicates = true;
+        options.stop_words = "and with cat"s;
+        auto rebuild = server.Rebuild(options);
+        const vector<int> removed = rebuild.get();
+        ASSERT_EQUAL(removed.size(), 1u);
+        ASSERT_EQUAL(removed[0], 3);
+        ASSERT_EQUAL(old_reader->GetDocumentCount(), 4);
+        ASSERT_EQUAL(old_reader->FindTopDocuments("cat"s).size(), 3u);
+    }
+    ASSERT_EQUAL(server.GetGeneration(), 1u);
+    ASSERT_EQUAL(configured, 2);
+    ASSERT_EQUAL(server.GetDocumentCount(), 3);
+    ASSERT(server.FindTopDocuments("cat"s).empty());
+    ASSERT(server.Read()->HasPositionalIndex());
+    ASSERT_EQUAL(server.Read()->GetStopWordsCount(), 3);
+    const auto documents = server.FindTopDocuments("fluffy collar"s);
+    ASSERT_EQUAL(documents.size(), 2u);
+    ASSERT_EQUAL(documents[0].id, 2);
+    ASSERT_EQUAL(documents[0].rating, 5);
+    ASSERT_EQUAL(server.FindTopDocuments("dog"s, DocumentStatus::BANNED).size(), 1u);
+
+    //Writes during a rebuild are not lost
+    for (int id = 10; id < 200; ++id) {
+        server.AddDocument(id, "document number "s + to_string(id), DocumentStatus::ACTUAL, { id });
+    }
+    std::promise<void> open_gate;
+    rebuild_gate = open_gate.get_future().share();
+    auto rebuild = server.Rebuild();
+    try {
+        server.Rebuild();
+        ASSERT_HINT(false, "Only one rebuild at a time"s);
+    }
+    catch (const logic_error&) {
+    }
+    thread writer([&server]() {
+        server.RemoveDocument(1);
+        server.AddDocument(500, "white starling"s, DocumentStatus::ACTUAL, { 1 });
+    });
+    writer.join();
+    open_gate.set_value();
+    ASSERT(rebuild.get().empty());
+    ASSERT_EQUAL(server.GetGeneration(), 2u);
+    ASSERT_EQUAL(server.GetDocumentCount(), 3 + 190);
+    ASSERT(server.FindTopDocuments("collar"s).empty());
+    ASSERT_EQUAL(server.FindTopDocuments("starling"s).size(), 1u);
+    ASSERT_EQUAL(server.FindTopDocuments("number"s).size(), 5u);
+    ASSERT_EQUAL(server.Read()->GetStoredDocument(42).rating, 42);
+
+    //Invalid stop words fail right away and keep the active index
+    try {
+        server.Rebuild(RebuildOptions{ "bad\x12word"s, false });
+        ASSERT_HINT(false, "Invalid stop words must fail"s);
+    }
+    catch (const invalid_argument&) {
+    }
+    ASSERT_EQUAL(server.GetGeneration(), 2u);
+    server.Rebuild().get();
+    ASSERT_EQUAL(server.GetGeneration(), 3u);
+    ASSERT_EQUAL(server.GetDocumentCount(), 3 + 190);
+}
+
 //  TestSearchServer      
 void TestSearchServer() {
     RUN_TEST(TestDocumentAdd);
@@ -414,4 +1809,27 @@ void TestSearchServer() {
     RUN_TEST(TestStatusSearch);
     RUN_TEST(TestRelevancecCalc);
     TestRemoveDuplicates();
+    RUN_TEST(TestQueryContext);
+    RUN_TEST(TestStopWordSet);
+    RUN_TEST(TestMatchDocuments);
+    RUN_TEST(TestNearDuplicates);
+    RUN_TEST(TestRequestStatistics);
+    RUN_TEST(TestQueryTrace);
+    RUN_TEST(TestMetrics);
+    RUN_TEST(TestWorkload);
+    RUN_TEST(TestMemoryUsage);
+    RUN_TEST(TestPostingList);
+    RUN_TEST(TestIndexTraits);
+    RUN_TEST(TestIndexMemory);
+    RUN_TEST(TestSearchPages);
+    RUN_TEST(TestPhraseQueries);
+    RUN_TEST(TestPrefixQueries);
+    RUN_TEST(TestFuzzyQueries);
+    RUN_TEST(TestScoring);
+    RUN_TEST(TestShardedSearchServer);
+    RUN_TEST(TestWorkStealingExecutor);
+    RUN_TEST(TestAsyncQueries);
+    RUN_TEST(TestQueryServer);
+    RUN_TEST(TestReplication);
+    RUN_TEST(TestHotSwapSearchServer);
 }
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// 7 bits per byte, the high bit marks a continuation
+inline void AppendVarint(std::vector<uint8_t>& output, uint32_t value) {
+    while (value >= 0x80) {
+        output.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    output.push_back(static_cast<uint8_t>(value));
+}
+
+inline uint32_t ReadVarint(const uint8_t*& input) {
+    uint32_t value = 0;
+    for (int shift = 0; ; shift += 7) {
+        const uint8_t byte = *input++;
+        value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+}
@@ -0,0 +1,127 @@
+#include "wire_protocol.h"
+
+#include <cstring>
+#include <stdexcept>
+
+using namespace std::string_literals;
+
+namespace {
+
+void AppendLittleEndian(std::string& buffer, uint64_t value, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        buffer.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+uint64_t ParseLittleEndian(std::string_view bytes) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes.size(); ++i) {
+        value |= static_cast<uint64_t>(static_cast<uint8_t>(bytes[i])) << (8 * i);
+    }
+    return value;
+}
+
+}
+
+void WireWriter::WriteU8(uint8_t value) {
+    buffer_.push_back(static_cast<char>(value));
+}
+
+void WireWriter::WriteU32(uint32_t value) {
+    AppendLittleEndian(buffer_, value, 4);
+}
+
+void WireWriter::WriteU64(uint64_t value) {
+    AppendLittleEndian(buffer_, value, 8);
+}
+
+void WireWriter::WriteI32(int32_t value) {
+    AppendLittleEndian(buffer_, static_cast<uint32_t>(value), 4);
+}
+
+void WireWriter::WriteF64(double value) {
+    uint64_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(bits));
+    AppendLittleEndian(buffer_, bits, 8);
+}
+
+void WireWriter::WriteString(std::string_view value) {
+    WriteU32(static_cast<uint32_t>(value.size()));
+    buffer_.append(value);
+}
+
+uint8_t WireReader::ReadU8() {
+    return static_cast<uint8_t>(ReadBytes(1)[0]);
+}
+
+uint32_t WireReader::ReadU32() {
+    return static_cast<uint32_t>(ParseLittleEndian(ReadBytes(4)));
+}
+
+uint64_t WireReader::ReadU64() {
+    return ParseLittleEndian(ReadBytes(8));
+}
+
+uint32_t WireReader::ReadCount(size_t element_size) {
+    const uint32_t count = ReadU32();
+    if (element_size > 0 && count > data_.size() / element_size) {
+        throw std::invalid_argument("Count "s + std::to_string(count) + " exceeds the message"s);
+    }
+    return count;
+}
+
+int32_t WireReader::ReadI32() {
+    return static_cast<int32_t>(ReadU32());
+}
+
+double WireReader::ReadF64() {
+    const uint64_t bits = ParseLittleEndian(ReadBytes(8));
+    double value = 0;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+std::string_view WireReader::ReadString() {
+    return ReadBytes(ReadU32());
+}
+
+DocumentStatus WireReader::ReadDocumentStatus() {
+    const uint8_t status = ReadU8();
+    if (status > static_cast<uint8_t>(DocumentStatus::REMOVED)) {
+        throw std::invalid_argument("Unknown document status "s + std::to_string(status));
+    }
+    return static_cast<DocumentStatus>(status);
+}
+
+std::string_view WireReader::ReadBytes(size_t size) {
+    if (data_.size() < size) {
+        throw std::invalid_argument("Truncated message"s);
+    }
+    const std::string_view bytes = data_.substr(0, size);
+    data_.remove_prefix(size);
+    return bytes;
+}
+
+size_t BeginFrame(std::string& buffer) {
+    const size_t frame_begin = buffer.size();
+    buffer.append(FRAME_HEADER_SIZE, '\0');
+    return frame_begin;
+}
+
+void EndFrame(std::string& buffer, size_t frame_begin) {
+    const uint64_t payload_size = buffer.size() - frame_begin - FRAME_HEADER_SIZE;
+    for (size_t i = 0; i < FRAME_HEADER_SIZE; ++i) {
+        buffer[frame_begin + i] = static_cast<char>((payload_size >> (8 * i)) & 0xFF);
+    }
+}
+
+size_t GetFrameSize(std::string_view data) {
+    if (data.size() < FRAME_HEADER_SIZE) {
+        return 0;
+    }
+    const size_t payload_size = ParseLittleEndian(data.substr(0, FRAME_HEADER_SIZE));
+    if (payload_size > MAX_FRAME_SIZE) {
+        throw std::invalid_argument("Frame of "s + std::to_string(payload_size) + " bytes is too large"s);
+    }
+    return data.size() < FRAME_HEADER_SIZE + payload_size ? 0 : FRAME_HEADER_SIZE + payload_size;
+}
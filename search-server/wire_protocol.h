@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "document.h"
+
+// Binary protocol of QueryServer. Every message is a frame: a 4-byte payload size followed by
+// the payload. All integers are little-endian, strings are a 4-byte size followed by the bytes.
+//
+// Request payload:  u32 request_id, u8 RequestType, then
+//   FIND_TOP_DOCUMENTS  u8 status, string query
+//   MATCH_DOCUMENT      i32 document_id, string query
+//   ADD_DOCUMENT        i32 document_id, u8 status, u32 rating count, i32 ratings..., string text
+//   REMOVE_DOCUMENT     i32 document_id
+// Response payload: u32 request_id, u8 ResponseStatus, then
+//   ERROR               string message
+//   FIND_TOP_DOCUMENTS  u32 count, (i32 id, f64 relevance, i32 rating)...
+//   MATCH_DOCUMENT      u8 status, u32 count, string words...
+//   ADD_DOCUMENT, REMOVE_DOCUMENT  nothing
+// A connection may send requests without waiting for responses; responses may come in any
+// order and carry the id of their request.
+enum class RequestType : uint8_t {
+    FIND_TOP_DOCUMENTS = 1,
+    MATCH_DOCUMENT = 2,
+    ADD_DOCUMENT = 3,
+    REMOVE_DOCUMENT = 4,
+};
+
+enum class ResponseStatus : uint8_t {
+    OK = 0,
+    ERROR = 1,
+};
+
+const size_t FRAME_HEADER_SIZE = 4;
+// Larger frames are a protocol error, the connection is closed
+const size_t MAX_FRAME_SIZE = 16 << 20;
+
+class WireWriter {
+public:
+    explicit WireWriter(std::string& buffer)
+        : buffer_(buffer) {
+    }
+
+    void WriteU8(uint8_t value);
+    void WriteU32(uint32_t value);
+    void WriteU64(uint64_t value);
+    void WriteI32(int32_t value);
+    void WriteF64(double value);
+    void WriteString(std::string_view value);
+
+private:
+    std::string& buffer_;
+};
+
+// Reads values in the order they were written. Reading past the end throws std::invalid_argument.
+class WireReader {
+public:
+    explicit WireReader(std::string_view data)
+        : data_(data) {
+    }
+
+    uint8_t ReadU8();
+    uint32_t ReadU32();
+    uint64_t ReadU64();
+    // A u32 count of the elements that follow, each at least element_size bytes long. A count
+    // that the rest of the data cannot hold throws before the caller allocates for it.
+    uint32_t ReadCount(size_t element_size);
+    int32_t ReadI32();
+    double ReadF64();
+    // A view into the data given to the constructor
+    std::string_view ReadString();
+    // A u8 DocumentStatus, other values throw std::invalid_argument
+    DocumentStatus ReadDocumentStatus();
+
+    bool IsEmpty() const {
+        return data_.empty();
+    }
+
+private:
+    std::string_view data_;
+
+    std::string_view ReadBytes(size_t size);
+};
+
+// Reserves the header of a frame at the end of buffer, returns its position for EndFrame
+size_t BeginFrame(std::string& buffer);
+// Writes the size of everything appended since BeginFrame into the header
+void EndFrame(std::string& buffer, size_t frame_begin);
+// Size of the frame at the start of data with its header, 0 if it has not arrived completely.
+// Throws std::invalid_argument for a frame larger than MAX_FRAME_SIZE.
+size_t GetFrameSize(std::string_view data);
@@ -0,0 +1,84 @@
+#include "workload.h"
+
+#include "generators.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <unordered_set>
+
+using namespace std;
+
+ZipfDistribution::ZipfDistribution(size_t n, double exponent) {
+    if (n == 0) {
+        throw invalid_argument("Zipf distribution needs at least one rank"s);
+    }
+    cumulative_.reserve(n);
+    double sum = 0;
+    for (size_t rank = 0; rank < n; ++rank) {
+        sum += 1.0 / pow(static_cast<double>(rank + 1), exponent);
+        cumulative_.push_back(sum);
+    }
+    for (double& value : cumulative_) {
+        value /= sum;
+    }
+}
+
+size_t ZipfDistribution::operator()(mt19937& generator) const {
+    const double value = uniform_real_distribution<>(0, 1)(generator);
+    const auto it = upper_bound(cumulative_.begin(), cumulative_.end(), value);
+    return min<size_t>(it - cumulative_.begin(), cumulative_.size() - 1);
+}
+
+double ZipfDistribution::GetProbability(size_t rank) const {
+    return rank == 0 ? cumulative_[0] : cumulative_[rank] - cumulative_[rank - 1];
+}
+
+int GenerateQueryLength(mt19937& generator) {
+    thread_local discrete_distribution<int> lengths({ 0, 25, 30, 20, 12, 7, 3, 2, 1 });
+    return lengths(generator);
+}
+
+string GenerateZipfText(mt19937& generator, const vector<string>& dictionary, const ZipfDistribution& words, int word_count, double minus_prob) {
+    string text;
+    for (int i = 0; i < word_count; ++i) {
+        if (!text.empty()) {
+            text.push_back(' ');
+        }
+        if (minus_prob > 0 && uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
+            text.push_back('-');
+        }
+        text += dictionary[words(generator)];
+    }
+    return text;
+}
+
+Workload GenerateWorkload(const WorkloadOptions& options) {
+    mt19937 generator(options.seed);
+    Workload workload;
+
+    // Random words have no natural frequency order, so the rank of a word is its position
+    unordered_set<string> seen;
+    for (long long attempt = 0; static_cast<int>(workload.dictionary.size()) < options.vocabulary; ++attempt) {
+        if (attempt > 100LL * options.vocabulary) {
+            throw invalid_argument("Vocabulary is too large for the maximal word length"s);
+        }
+        string word = GenerateWord(generator, options.max_word_length);
+        if (seen.insert(word).second) {
+            workload.dictionary.push_back(move(word));
+        }
+    }
+
+    const ZipfDistribution words(workload.dictionary.size(), options.word_exponent);
+    const ZipfDistribution document_lengths(options.max_document_words, options.document_length_exponent);
+    workload.documents.reserve(options.documents);
+    for (int i = 0; i < options.documents; ++i) {
+        const int length = static_cast<int>(document_lengths(generator)) + 1;
+        workload.documents.push_back(GenerateZipfText(generator, workload.dictionary, words, length));
+    }
+    workload.queries.reserve(options.queries);
+    for (int i = 0; i < options.queries; ++i) {
+        workload.queries.push_back(GenerateZipfText(generator, workload.dictionary, words, GenerateQueryLength(generator), options.minus_prob));
+    }
+    return workload;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <random>
+#include <string>
+#include <vector>
+
+// Draws ranks 0..n-1 with probability proportional to 1 / (rank + 1)^exponent.
+// The cumulative table is built once, every draw is a binary search over it.
+class ZipfDistribution {
+public:
+    ZipfDistribution(size_t n, double exponent);
+
+    size_t operator()(std::mt19937& generator) const;
+
+    size_t GetSize() const {
+        return cumulative_.size();
+    }
+
+    double GetProbability(size_t rank) const;
+
+private:
+    std::vector<double> cumulative_;
+};
+
+struct WorkloadOptions {
+    int vocabulary = 10000;
+    int max_word_length = 10;
+    // Word frequencies in real text follow Zipf's law with an exponent close to 1
+    double word_exponent = 1.0;
+    int documents = 10000;
+    int max_document_words = 500;
+    // Most documents are short, a few are very long
+    double document_length_exponent = 0.5;
+    int queries = 1000;
+    double minus_prob = 0.05;
+    int seed = 42;
+};
+
+struct Workload {
+    // Ordered by frequency: dictionary[0] is the most common word
+    std::vector<std::string> dictionary;
+    std::vector<std::string> documents;
+    std::vector<std::string> queries;
+};
+
+// Query lengths of web search logs: mostly two or three words, rarely more than six
+int GenerateQueryLength(std::mt19937& generator);
+std::string GenerateZipfText(std::mt19937& generator, const std::vector<std::string>& dictionary, const ZipfDistribution& words, int word_count, double minus_prob = 0);
+Workload GenerateWorkload(const WorkloadOptions& options);